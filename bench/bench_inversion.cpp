@@ -0,0 +1,433 @@
+/*
+Benchmarks for InvertCplx / DetCplx, dim 1 - 32, single matrices and batches, in every
+layout the headers accept (row-pointer table, row/col-major view, AoS batch, SoA batch,
+thread pool, float, per-row heap allocations against a CplxMatrixArena slab). Each case is repeated until it runs for at least --min-time seconds,
+and the median of three such runs is reported as ns per matrix and GFLOP/s.
+GFLOP/s uses the nominal LU operation counts (8 n^3 real flops for an inverse, 8/3 n^3 for a
+determinant), so the figures are comparable across sizes rather than exact.
+
+--autotune times the fixed-size kernels (InvertCplx<N>, DetCplx<N>) and the native Gauss-Jordan
+(InvertCplxNative) against the LAPACK path (InvertCplxNxN, DetCplxNxN) for every N and records
+the size from which LAPACK stays faster, i.e. the INVERSION_CPLX_NATIVE_MAX to build with (minus one).
+
+Usage : bench_inversion [--min-time s] [--max-dim n] [--filter text] [--json file] [--autotune]
+*/
+#include "inversion.h"
+#include "inversion_simd.h"
+#include "inversion_parallel.h"
+#include "inversion_arena.h"
+#include "inversion_eig.h"
+#include "inversion_structured.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::complex<double> Cplx;
+typedef std::complex<float> CplxF;
+
+struct BenchOptions {
+  double minTime;
+  int maxDim;
+  std::string filter;
+  std::string json;
+  bool autotune;
+
+  BenchOptions() : minTime(0.05), maxDim(32), autotune(false) {}
+};
+
+struct BenchResult {
+  std::string name;
+  int dim;
+  size_t batch;
+  double ns;
+  double gflops;
+};
+
+struct TuneResult {
+  int dim;
+  double fixedInvNs, nativeInvNs, lapackInvNs;
+  double fixedDetNs, lapackDetNs;
+};
+
+// Determinants are accumulated here so that they are not optimized out.
+static volatile double g_sink;
+
+// Keeps the compiler from dropping or hoisting the timed stores.
+inline void ClobberMemory() {
+#if defined(__GNUC__)
+  asm volatile("" : : : "memory");
+#endif
+}
+
+inline double InvertFlops(int n) { return 8.0 * n * n * n; }
+inline double DetFlops(int n) { return 8.0 * n * n * n / 3.0; }
+
+// Random matrices with a loaded diagonal, so that every size is well conditioned.
+inline void FillMatrices(Cplx* A, int dim, size_t count, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> d;
+  for (size_t k = 0; k < count; k++)
+    for (int i = 0; i < dim; i++)
+      for (int j = 0; j < dim; j++)
+        A[k * dim * dim + i * dim + j] = Cplx(d(rng), d(rng)) + (i == j ? Cplx(dim, 0.0) : Cplx(0.0));
+}
+
+// Median over three runs of ns per item; each run doubles its iteration count until it lasts minTime.
+template <typename F>
+double Measure(F& fn, size_t itemsPerCall, double minTime) {
+  typedef std::chrono::steady_clock Clock;
+  double runs[3];
+  size_t iters = 1;
+  for (int r = 0; r < 3; r++) {
+    for (;;) {
+      const Clock::time_point t0 = Clock::now();
+      for (size_t i = 0; i < iters; i++) {
+        fn();
+        ClobberMemory();
+      }
+      const double s = std::chrono::duration<double>(Clock::now() - t0).count();
+      if (s >= minTime) {
+        runs[r] = s * 1e9 / ((double)iters * itemsPerCall);
+        break;
+      }
+      const double grow = s > 0.0 ? 1.4 * minTime / s : 10.0;
+      iters = (size_t)(iters * std::min(std::max(grow, 2.0), 100.0));
+    }
+  }
+  std::sort(runs, runs + 3);
+  return runs[1];
+}
+
+class BenchRunner {
+public:
+  explicit BenchRunner(const BenchOptions& opt_) : opt(opt_) {}
+
+  template <typename F>
+  void Run(const std::string& name, int dim, size_t batch, double flops, F fn) {
+    if (!opt.filter.empty() && name.find(opt.filter) == std::string::npos)
+      return;
+    BenchResult r;
+    r.name = name;
+    r.dim = dim;
+    r.batch = batch;
+    r.ns = Measure(fn, batch, opt.minTime);
+    r.gflops = flops / r.ns;
+    results.push_back(r);
+    printf("%-32s %4d %6zu %14.1f %10.3f\n", name.c_str(), dim, batch, r.ns, r.gflops);
+    fflush(stdout);
+  }
+
+  const std::vector<BenchResult>& Results() const { return results; }
+
+private:
+  BenchOptions opt;
+  std::vector<BenchResult> results;
+};
+
+struct RowTable {
+  std::vector<Cplx*> rows;
+  RowTable(Cplx* A, int dim) : rows(dim) {
+    for (int i = 0; i < dim; i++)
+      rows[i] = A + i * dim;
+  }
+  Cplx** Get() { return &rows[0]; }
+};
+
+// Batch size giving a working set of about 4 MB, so batches are not timed from L1.
+inline size_t BatchCount(int dim) {
+  const size_t bytes = (size_t)dim * dim * sizeof(Cplx) * 2;
+  return std::max<size_t>(16, (4u << 20) / bytes);
+}
+
+// InvertCplxFast<N> / DetCplxFast<N> next to the std::complex kernels they replace.
+template <int N>
+inline void BenchFast(BenchRunner& bench, Cplx* a, Cplx* b) {
+  CplxConstMatrixView va(a, N);
+  CplxMatrixView vb(b, N);
+  Cplx sink(0.0);
+  bench.Run("InvertCplx<N>/view_row", N, 1, InvertFlops(N), [&] { InvertCplx<N>(va, vb); });
+  bench.Run("InvertCplxFast<N>/view_row", N, 1, InvertFlops(N), [&] { InvertCplxFast<N>(va, vb); });
+  bench.Run("DetCplx<N>/view_row", N, 1, DetFlops(N), [&] { sink += DetCplx<N>(va); });
+  bench.Run("DetCplxFast<N>/view_row", N, 1, DetFlops(N), [&] { sink += DetCplxFast<N>(va); });
+  g_sink = sink.real();
+}
+
+inline void BenchSingle(BenchRunner& bench, int dim) {
+  const size_t nn = (size_t)dim * dim;
+  std::vector<Cplx> a(nn), b(nn);
+  FillMatrices(&a[0], dim, 1, 1234u + dim);
+  RowTable ra(&a[0], dim), rb(&b[0], dim);
+  CplxInvWorkspace ws(dim);
+  ws.ReserveRhs(dim, 1);
+
+  Cplx sink(0.0);
+  bench.Run("InvertCplx/rowptr", dim, 1, InvertFlops(dim), [&] { InvertCplx(ra.Get(), rb.Get(), dim, ws); });
+  bench.Run("InvertCplx/view_row", dim, 1, InvertFlops(dim),
+    [&] { InvertCplx(CplxConstMatrixView(&a[0], dim), CplxMatrixView(&b[0], dim), ws); });
+  bench.Run("InvertCplx/view_col", dim, 1, InvertFlops(dim),
+    [&] { InvertCplx(CplxConstMatrixView(&a[0], dim, CPLX_COL_MAJOR), CplxMatrixView(&b[0], dim, CPLX_COL_MAJOR), ws); });
+  bench.Run("InvertCplxNxN/rowptr", dim, 1, InvertFlops(dim), [&] { InvertCplxNxN(ra.Get(), rb.Get(), dim, ws); });
+
+  bench.Run("DetCplx/rowptr", dim, 1, DetFlops(dim), [&] { sink += DetCplx(ra.Get(), dim, ws); });
+  bench.Run("DetCplx/view_row", dim, 1, DetFlops(dim), [&] { sink += DetCplx(CplxConstMatrixView(&a[0], dim), ws); });
+  bench.Run("DetCplxNxN/rowptr", dim, 1, DetFlops(dim), [&] { sink += DetCplxNxN(ra.Get(), dim, ws); });
+  bench.Run("InvertAndDetCplx/rowptr", dim, 1, InvertFlops(dim), [&] { sink += InvertAndDetCplx(ra.Get(), rb.Get(), dim, ws); });
+  g_sink = sink.real();
+
+  switch (dim) {
+  case 1: BenchFast<1>(bench, &a[0], &b[0]);
+    break;
+  case 2: BenchFast<2>(bench, &a[0], &b[0]);
+    break;
+  case 3: BenchFast<3>(bench, &a[0], &b[0]);
+    break;
+  case 4: BenchFast<4>(bench, &a[0], &b[0]);
+    break;
+  case 5: BenchFast<5>(bench, &a[0], &b[0]);
+    break;
+  case 6: BenchFast<6>(bench, &a[0], &b[0]);
+    break;
+  }
+}
+
+inline void BenchBatch(BenchRunner& bench, CplxBatchExecutor& pool, int dim) {
+  const size_t nn = (size_t)dim * dim;
+  const size_t count = BatchCount(dim);
+  std::vector<Cplx> a(nn * count), b(nn * count), det(count);
+  FillMatrices(&a[0], dim, count, 99u + dim);
+  CplxInvWorkspace ws(dim);
+
+  bench.Run("InvertCplxBatch/aos", dim, count, InvertFlops(dim),
+    [&] { InvertCplxBatch(&a[0], &b[0], dim, count, nn, ws); });
+
+  // the same batch through the row-pointer API, one heap block per row against one arena slab
+  std::vector<std::vector<Cplx> > heapRows(2 * count * dim, std::vector<Cplx>(dim));
+  std::vector<Cplx*> heapTables(2 * count * dim);
+  CplxMatrixArena arena(dim, count);
+  for (size_t k = 0; k < 2 * count * dim; k++)
+    heapTables[k] = &heapRows[k][0];
+  for (size_t k = 0; k < count; k++)
+    for (int i = 0; i < dim; i++) {
+      std::copy(&a[k * nn + i * dim], &a[k * nn + i * dim] + dim, heapTables[k * dim + i]);
+      std::copy(&a[k * nn + i * dim], &a[k * nn + i * dim] + dim, arena.Rows(0, k)[i]);
+    }
+  bench.Run("InvertCplx/heap_rows", dim, count, InvertFlops(dim), [&] {
+    for (size_t k = 0; k < count; k++)
+      InvertCplx(&heapTables[k * dim], &heapTables[(count + k) * dim], dim, ws);
+  });
+  bench.Run("InvertCplx/arena_rows", dim, count, InvertFlops(dim), [&] {
+    for (size_t k = 0; k < count; k++)
+      InvertCplx(arena.Rows(0, k), arena.Rows(1, k), dim, arena.Workspace());
+  });
+
+  std::vector<Cplx> c(a);
+  bench.Run("InvertCplxBatch/aos_inplace", dim, count, InvertFlops(dim),
+    [&] { InvertCplxBatchInPlace(&c[0], dim, count, nn, ws); });
+
+  std::vector<double> are(nn * count), aim(nn * count), bre(nn * count), bim(nn * count);
+  CplxBatchToSoA(&a[0], dim, count, nn, &are[0], &aim[0], count);
+  bench.Run("InvertCplxBatchSoA/soa", dim, count, InvertFlops(dim),
+    [&] { InvertCplxBatchSoA(&are[0], &aim[0], &bre[0], &bim[0], dim, count, count); });
+  std::vector<double> dre(count), imDet(count);
+  bench.Run("DetCplxBatchSoA/soa", dim, count, DetFlops(dim),
+    [&] { DetCplxBatchSoA(&are[0], &aim[0], &dre[0], &imDet[0], dim, count, count); });
+  bench.Run("InvertAndDetCplxBatchSoA/soa", dim, count, InvertFlops(dim),
+    [&] { InvertAndDetCplxBatchSoA(&are[0], &aim[0], &bre[0], &bim[0], &dre[0], &imDet[0], dim, count, count); });
+
+  bench.Run("DetCplxBatch/aos", dim, count, DetFlops(dim),
+    [&] { DetCplxBatch(&a[0], &det[0], dim, count, nn, ws); });
+
+  bench.Run("LogDetCplxBatch/aos", dim, count, DetFlops(dim),
+    [&] { LogDetCplxBatch(&a[0], &det[0], dim, count, nn, ws); });
+
+  // the same dense matrices read as diag(2x2, 2x2, ...), against the full inversions above
+  if (dim % 2 == 0) {
+    const std::vector<int> blocks(dim / 2, 2);
+    bench.Run("InvertCplxBlockDiagBatch/2x2", dim, count, InvertFlops(dim),
+      [&] { InvertCplxBlockDiagBatch(&a[0], &b[0], dim, &blocks[0], dim / 2, count, nn, ws); });
+  }
+
+  // GFLOP/s of the eigensolvers is relative to the nominal inversion count
+  std::vector<double> w(dim * count);
+  bench.Run("EigHermCplxBatch/aos", dim, count, InvertFlops(dim),
+    [&] { EigHermCplxBatch(&a[0], &w[0], &b[0], dim, count, nn, 0, ws); });
+  bench.Run("EigHermCplxBatchSoA/soa", dim, count, InvertFlops(dim),
+    [&] { EigHermCplxBatchSoA(&are[0], &aim[0], &w[0], &bre[0], &bim[0], dim, count, count); });
+
+  bench.Run("CplxBatchExecutor/invert_aos", dim, count, InvertFlops(dim),
+    [&] { pool.InvertBatch(&a[0], &b[0], dim, count, nn); });
+  bench.Run("CplxBatchExecutor/det_aos", dim, count, DetFlops(dim),
+    [&] { pool.DetBatch(&a[0], &det[0], dim, count, nn); });
+
+  std::vector<CplxF> af(nn * count), bf(nn * count);
+  for (size_t e = 0; e < af.size(); e++)
+    af[e] = CplxF(a[e]);
+  CplxInvWorkspaceF wsf(dim);
+  bench.Run("InvertCplxBatch/aos_f32", dim, count, InvertFlops(dim),
+    [&] { InvertCplxBatch(&af[0], &bf[0], dim, count, nn, wsf); });
+}
+
+// Fixed-size kernel against the LAPACK path for N = 1 .. MaxN.
+template <int N>
+struct AutoTune {
+  static void Run(const BenchOptions& opt, int maxDim, std::vector<TuneResult>& out) {
+    AutoTune<N - 1>::Run(opt, maxDim, out);
+    if (N > maxDim)
+      return;
+    std::vector<Cplx> a(N * N), b(N * N);
+    FillMatrices(&a[0], N, 1, 4321u + N);
+    RowTable ra(&a[0], N), rb(&b[0], N);
+    CplxInvWorkspace ws(N);
+    Cplx sink(0.0);
+
+    TuneResult r;
+    r.dim = N;
+    CplxConstMatrixView va(&a[0], N);
+    CplxMatrixView vb(&b[0], N);
+    auto fixedInv = [&] { InvertCplx<N>(va, vb); };
+    auto nativeInv = [&] { InvertCplxNative(ra.Get(), rb.Get(), N, ws); };
+    auto lapackInv = [&] { InvertCplxNxN(ra.Get(), rb.Get(), N, ws); };
+    auto fixedDet = [&] { sink += DetCplx<N>(va); };
+    auto lapackDet = [&] { sink += DetCplxNxN(ra.Get(), N, ws); };
+    r.fixedInvNs = Measure(fixedInv, 1, opt.minTime);
+    r.nativeInvNs = Measure(nativeInv, 1, opt.minTime);
+    r.lapackInvNs = Measure(lapackInv, 1, opt.minTime);
+    r.fixedDetNs = Measure(fixedDet, 1, opt.minTime);
+    r.lapackDetNs = Measure(lapackDet, 1, opt.minTime);
+    out.push_back(r);
+    g_sink = sink.real();
+    printf("%4d %14.1f %14.1f %14.1f %14.1f %14.1f\n", N, r.fixedInvNs, r.nativeInvNs, r.lapackInvNs,
+      r.fixedDetNs, r.lapackDetNs);
+    fflush(stdout);
+  }
+};
+
+template <>
+struct AutoTune<0> {
+  static void Run(const BenchOptions&, int, std::vector<TuneResult>&) {}
+};
+
+enum TuneKind { TUNE_FIXED_INVERT, TUNE_NATIVE_INVERT, TUNE_FIXED_DET };
+
+// Smallest N from which LAPACK is faster for every larger size measured, 0 if it never is at the largest size.
+inline int Crossover(const std::vector<TuneResult>& t, TuneKind kind) {
+  int crossover = 0;
+  for (size_t i = t.size(); i-- > 0;) {
+    const double own = kind == TUNE_FIXED_INVERT ? t[i].fixedInvNs :
+      (kind == TUNE_NATIVE_INVERT ? t[i].nativeInvNs : t[i].fixedDetNs);
+    const double lapack = kind == TUNE_FIXED_DET ? t[i].lapackDetNs : t[i].lapackInvNs;
+    if (!(lapack < own))
+      break;
+    crossover = t[i].dim;
+  }
+  return crossover;
+}
+
+inline const char* SimdLevelName(CplxSimdLevel level) {
+  switch (level) {
+  case CPLX_SIMD_AVX512: return "avx512";
+  case CPLX_SIMD_AVX2: return "avx2";
+  case CPLX_SIMD_SSE2: return "sse2";
+  default: return "scalar";
+  }
+}
+
+inline bool WriteJson(const std::string& path, const BenchOptions& opt, int threads,
+  const std::vector<BenchResult>& results, const std::vector<TuneResult>& tune) {
+  FILE* f = fopen(path.c_str(), "w");
+  if (!f)
+    return false;
+
+  char date[64];
+  const std::time_t now = std::time(0);
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+  fprintf(f, "{\n  \"context\": {\n");
+  fprintf(f, "    \"date\": \"%s\",\n", date);
+  fprintf(f, "    \"threads\": %d,\n", threads);
+  fprintf(f, "    \"simd\": \"%s\",\n", SimdLevelName(CplxSimdLevelSelected()));
+  fprintf(f, "    \"min_time\": %g\n  },\n", opt.minTime);
+
+  fprintf(f, "  \"benchmarks\": [");
+  for (size_t i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    fprintf(f, "%s\n    {\"name\": \"%s\", \"dim\": %d, \"batch\": %zu, \"ns_per_matrix\": %.3f, \"gflops\": %.4f}",
+      i ? "," : "", r.name.c_str(), r.dim, r.batch, r.ns, r.gflops);
+  }
+  fprintf(f, "\n  ]");
+
+  if (!tune.empty()) {
+    fprintf(f, ",\n  \"autotune\": {\n");
+    fprintf(f, "    \"invert_crossover\": %d,\n", Crossover(tune, TUNE_FIXED_INVERT));
+    fprintf(f, "    \"native_crossover\": %d,\n", Crossover(tune, TUNE_NATIVE_INVERT));
+    fprintf(f, "    \"det_crossover\": %d,\n", Crossover(tune, TUNE_FIXED_DET));
+    fprintf(f, "    \"sizes\": [");
+    for (size_t i = 0; i < tune.size(); i++) {
+      const TuneResult& t = tune[i];
+      fprintf(f, "%s\n      {\"dim\": %d, \"fixed_invert_ns\": %.3f, \"native_invert_ns\": %.3f, "
+        "\"lapack_invert_ns\": %.3f, \"fixed_det_ns\": %.3f, \"lapack_det_ns\": %.3f}",
+        i ? "," : "", t.dim, t.fixedInvNs, t.nativeInvNs, t.lapackInvNs, t.fixedDetNs, t.lapackDetNs);
+    }
+    fprintf(f, "\n    ]\n  }");
+  }
+  fprintf(f, "\n}\n");
+  fclose(f);
+  return true;
+}
+
+inline void Usage(const char* prog) {
+  fprintf(stderr, "usage : %s [--min-time s] [--max-dim n] [--filter text] [--json file] [--autotune]\n", prog);
+}
+
+int main(int argc, char** argv) {
+  BenchOptions opt;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--min-time" && hasValue)
+      opt.minTime = atof(argv[++i]);
+    else if (arg == "--max-dim" && hasValue)
+      opt.maxDim = atoi(argv[++i]);
+    else if (arg == "--filter" && hasValue)
+      opt.filter = argv[++i];
+    else if (arg == "--json" && hasValue)
+      opt.json = argv[++i];
+    else if (arg == "--autotune")
+      opt.autotune = true;
+    else {
+      Usage(argv[0]);
+      return 1;
+    }
+  }
+  opt.maxDim = std::min(std::max(opt.maxDim, 1), 32);
+
+  CplxBatchExecutor pool;
+  BenchRunner bench(opt);
+  std::vector<TuneResult> tune;
+
+  printf("%-32s %4s %6s %14s %10s\n", "benchmark", "dim", "batch", "ns/matrix", "GFLOP/s");
+  for (int dim = 1; dim <= opt.maxDim; dim++) {
+    BenchSingle(bench, dim);
+    BenchBatch(bench, pool, dim);
+  }
+
+  if (opt.autotune) {
+    printf("\n%4s %14s %14s %14s %14s %14s\n", "dim", "fixed inv ns", "native inv ns", "lapack inv ns",
+      "fixed det ns", "lapack det ns");
+    AutoTune<32>::Run(opt, opt.maxDim, tune);
+    printf("invert crossover : %d\nnative crossover : %d\ndet crossover : %d\n", Crossover(tune, TUNE_FIXED_INVERT),
+      Crossover(tune, TUNE_NATIVE_INVERT), Crossover(tune, TUNE_FIXED_DET));
+  }
+
+  if (!opt.json.empty() && !WriteJson(opt.json, opt, pool.Threads(), bench.Results(), tune)) {
+    fprintf(stderr, "cannot write %s\n", opt.json.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -37,612 +37,1459 @@ You can define those macros as suggested to use std::complex instead, which are
 https://stackoverflow.com/questions/24853450/errors-using-lapack-c-header-in-c-with-visual-studio-2010
 */
 #include <complex>
+#include <cmath>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #define lapack_complex_float std::complex<float>
 #define lapack_complex_double std::complex<double>
 #include "lapacke.h"
 
+/*
+-DINVERSION_CPLX_STATS records per-size call counts, ticks and failures of the dispatchers
+(see inversion_stats.h); without it the probes below compile to nothing.
+*/
+#ifdef INVERSION_CPLX_STATS
+#include "inversion_stats.h"
+#define INVERSION_CPLX_PROBE(name, op, dim, path, count) CplxStatsProbe name(op, dim, path, count)
+#define INVERSION_CPLX_PROBE_FAIL(name, n) name.Fail(n)
+#define INVERSION_CPLX_PROBE_ILL(name) name.IllConditioned()
+#else
+#define INVERSION_CPLX_PROBE(name, op, dim, path, count) ((void)0)
+#define INVERSION_CPLX_PROBE_FAIL(name, n) ((void)0)
+#define INVERSION_CPLX_PROBE_ILL(name) ((void)0)
+#endif
+
+/*
+Row accessor for a contiguous row-major matrix with leading dimension ld.
+A[i][j] resolves to data[i * ld + j], so the fixed-size kernels below run on flat buffers
+without building a row-pointer table.
+*/
+template <typename T>
+struct CplxRowMajorPtr {
+  T* data;
+  size_t ld;
 
+  CplxRowMajorPtr(T* data_, size_t ld_) : data(data_), ld(ld_) {}
+  T* operator[](size_t i) const { return data + i * ld; }
+};
 
-inline std::complex<double> DetCplxNxN(std::complex<double>** mat, int dim) {
-  int i;
-  std::complex<double> det;
-  double t;
-  int n;
-  int* idx;
-  std::complex<double>* tmat;
-  n = dim;
-
-  idx = new int[n];
-  tmat = new std::complex<double>[dim * dim];
-  //TODO
-  //memcpy : mat -> tmat;
-  for (i = 0; i < n; i++) {
-    memcpy(tmat + i * n * sizeof(std::complex<double>), mat[i], sizeof(std::complex<double>) * n);
-  }
-
-  //TODO
-  //row ? col ?
-  LAPACKE_zgetrf(LAPACK_ROW_MAJOR, n, n, tmat, n, idx);
-
-  det = { 1.0,0.0 };
-  for (i = 0; i < n; i++) {
-    if (i + 1 != idx[i])
-      det *= -tmat[i * n + i];
+enum CplxLayout {
+  CPLX_ROW_MAJOR,
+  CPLX_COL_MAJOR
+};
+
+template <typename T>
+struct CplxStridedRow {
+  T* data;
+  size_t stride;
+
+  CplxStridedRow(T* data_, size_t stride_) : data(data_), stride(stride_) {}
+  T& operator[](size_t j) const { return data[j * stride]; }
+};
+
+/*
+Non-owning view of a matrix inside a larger buffer : element (i,j) is data[i * ld + j] for
+CPLX_ROW_MAJOR and data[i + j * ld] for CPLX_COL_MAJOR. Block() gives a view of a sub-matrix,
+so slices of a bins x N x N covariance tensor can be passed in place.
+*/
+template <typename T>
+struct CplxMatrixViewT {
+  T* data;
+  int rows;
+  int cols;
+  size_t ld;
+  CplxLayout layout;
+  size_t rs, cs;
+
+  CplxMatrixViewT(T* data_, int rows_, int cols_, size_t ld_, CplxLayout layout_ = CPLX_ROW_MAJOR)
+    : data(data_), rows(rows_), cols(cols_), ld(ld_), layout(layout_),
+    rs(layout_ == CPLX_ROW_MAJOR ? ld_ : 1), cs(layout_ == CPLX_ROW_MAJOR ? 1 : ld_) {}
+
+  // dense square matrix
+  CplxMatrixViewT(T* data_, int dim, CplxLayout layout_ = CPLX_ROW_MAJOR)
+    : data(data_), rows(dim), cols(dim), ld((size_t)dim), layout(layout_),
+    rs(layout_ == CPLX_ROW_MAJOR ? dim : 1), cs(layout_ == CPLX_ROW_MAJOR ? 1 : dim) {}
+
+  template <typename U>
+  CplxMatrixViewT(const CplxMatrixViewT<U>& v,
+    typename std::enable_if<std::is_convertible<U*, T*>::value>::type* = 0)
+    : data(v.data), rows(v.rows), cols(v.cols), ld(v.ld), layout(v.layout), rs(v.rs), cs(v.cs) {}
+
+  CplxStridedRow<T> operator[](size_t i) const { return CplxStridedRow<T>(data + i * rs, cs); }
+  T& operator()(size_t i, size_t j) const { return data[i * rs + j * cs]; }
+
+  CplxMatrixViewT Block(int r0, int c0, int rows_, int cols_) const {
+    return CplxMatrixViewT(&(*this)(r0, c0), rows_, cols_, ld, layout);
+  }
+};
+
+typedef CplxMatrixViewT<std::complex<double> > CplxMatrixView;
+typedef CplxMatrixViewT<const std::complex<double> > CplxConstMatrixView;
+typedef CplxMatrixViewT<std::complex<float> > CplxMatrixViewF;
+typedef CplxMatrixViewT<const std::complex<float> > CplxConstMatrixViewF;
+
+/*
+Element type seen through a matrix accessor (std::complex<double> for the row-pointer tables).
+The fixed-size kernels declare their temporaries with it, so the same expansion also runs on
+other complex-like element types.
+*/
+template <typename MT>
+struct CplxElementOf {
+  typedef typename std::remove_cv<typename std::remove_reference<decltype(std::declval<MT>()[0][0])>::type>::type Type;
+};
+
+// Real scalar type of a view element, e.g. double for const std::complex<double>.
+template <typename ET>
+struct CplxRealOf {
+  typedef typename std::remove_const<ET>::type::value_type Type;
+};
+
+/*
+getrf / getri / getrs for std::complex<double> (z) and std::complex<float> (c), all column-major
+with leading dimension n (or lda), so the LAPACK path below is written once for both precisions.
+*/
+template <typename T>
+struct CplxLapack;
+
+template <>
+struct CplxLapack<double> {
+  typedef std::complex<double> C;
+  static lapack_int Getrf(int n, C* a, lapack_int* ipiv, size_t lda = 0) {
+    return LAPACKE_zgetrf(LAPACK_COL_MAJOR, n, n, a, lda ? (lapack_int)lda : n, ipiv);
+  }
+  static lapack_int Getri(int n, C* a, const lapack_int* ipiv, C* work, lapack_int lwork, size_t lda = 0) {
+    return LAPACKE_zgetri_work(LAPACK_COL_MAJOR, n, a, lda ? (lapack_int)lda : n, ipiv, work, lwork);
+  }
+  static lapack_int Getrs(int n, int nrhs, const C* lu, const lapack_int* ipiv, C* b) {
+    return LAPACKE_zgetrs(LAPACK_COL_MAJOR, 'N', n, nrhs, lu, n, ipiv, b, n);
+  }
+};
+
+template <>
+struct CplxLapack<float> {
+  typedef std::complex<float> C;
+  static lapack_int Getrf(int n, C* a, lapack_int* ipiv, size_t lda = 0) {
+    return LAPACKE_cgetrf(LAPACK_COL_MAJOR, n, n, a, lda ? (lapack_int)lda : n, ipiv);
+  }
+  static lapack_int Getri(int n, C* a, const lapack_int* ipiv, C* work, lapack_int lwork, size_t lda = 0) {
+    return LAPACKE_cgetri_work(LAPACK_COL_MAJOR, n, a, lda ? (lapack_int)lda : n, ipiv, work, lwork);
+  }
+  static lapack_int Getrs(int n, int nrhs, const C* lu, const lapack_int* ipiv, C* b) {
+    return LAPACKE_cgetrs(LAPACK_COL_MAJOR, 'N', n, nrhs, lu, n, ipiv, b, n);
+  }
+};
+
+/*
+Scratch storage for the LAPACK path (dim > 6) : pivots, a dim x dim copy of the matrix and the
+zgetri work array at its optimal size, plus a dim x nrhs right-hand-side buffer for the solvers
+(ReserveRhs). Reserve() allocates only when the requested size grows,
+so after reserving the largest dim up front, the workspace overloads below never touch the heap.
+The LAPACK calls use column-major storage, which LAPACKE hands through without a transposed copy.
+T is the real scalar type : CplxInvWorkspace for std::complex<double>, CplxInvWorkspaceF for float.
+
+The (dim, nrhs, mem) constructor lays the buffers out in caller memory of Bytes(dim, nrhs) bytes
+instead (64-byte aligned if mem is, e.g. a CplxArena slab); reserving beyond that moves the grown
+buffer to the heap. Copies of such a workspace share the caller memory.
+*/
+template <typename T>
+class CplxInvWorkspaceT {
+public:
+  CplxInvWorkspaceT() : capacity(0), matDim(0), rhsSize(0), lwork(0), ipivp(0), matp(0), workp(0), rhsp(0) {}
+  explicit CplxInvWorkspaceT(int dim)
+    : capacity(0), matDim(0), rhsSize(0), lwork(0), ipivp(0), matp(0), workp(0), rhsp(0) { Reserve(dim); }
+
+  CplxInvWorkspaceT(int dim, int nrhs, void* mem)
+    : capacity(dim), matDim(dim), rhsSize((size_t)dim * nrhs), lwork(WorkQuery(dim))
+  {
+    char* p = (char*)mem;
+    matp = (std::complex<T>*)p;
+    p += Pad((size_t)dim * dim * sizeof(std::complex<T>));
+    workp = (std::complex<T>*)p;
+    p += Pad((size_t)lwork * sizeof(std::complex<T>));
+    rhsp = (std::complex<T>*)p;
+    p += Pad(rhsSize * sizeof(std::complex<T>));
+    ipivp = (lapack_int*)p;
+  }
+
+  // Caller memory needed by the (dim, nrhs, mem) constructor.
+  static size_t Bytes(int dim, int nrhs) {
+    return Pad((size_t)dim * dim * sizeof(std::complex<T>)) + Pad((size_t)WorkQuery(dim) * sizeof(std::complex<T>))
+      + Pad((size_t)dim * nrhs * sizeof(std::complex<T>)) + Pad((size_t)dim * sizeof(lapack_int));
+  }
+
+  void Reserve(int dim) {
+    if (dim <= capacity)
+      return;
+    ReserveMatrix(dim);
+    lwork = WorkQuery(dim);
+    work.resize(lwork);
+    workp = 0;
+    capacity = dim;
+  }
+
+  // Pivots and the dim x dim matrix only, without the getri work query (native path).
+  void ReserveMatrix(int dim) {
+    if (dim <= matDim)
+      return;
+    ipiv.resize(dim);
+    mat.resize((size_t)dim * dim);
+    ipivp = 0;
+    matp = 0;
+    matDim = dim;
+  }
+
+  void ReserveRhs(int dim, int nrhs) {
+    if ((size_t)dim * nrhs <= rhsSize)
+      return;
+    rhsSize = (size_t)dim * nrhs;
+    rhs.resize(rhsSize);
+    rhsp = 0;
+  }
+
+  int Capacity() const { return capacity; }
+  lapack_int* Pivot() { return ipivp ? ipivp : &ipiv[0]; }
+  std::complex<T>* Matrix() { return matp ? matp : &mat[0]; }
+  std::complex<T>* Work() { return workp ? workp : &work[0]; }
+  std::complex<T>* Rhs() { return rhsp ? rhsp : &rhs[0]; }
+  lapack_int WorkSize() const { return lwork; }
+
+private:
+  static size_t Pad(size_t bytes) { return (bytes + 63) & ~(size_t)63; }
+
+  // Optimal getri work size; the query reads neither the matrix nor the pivots.
+  static lapack_int WorkQuery(int dim) {
+    std::complex<T> query;
+    lapack_int piv = 0;
+    CplxLapack<T>::Getri(dim, &query, &piv, &query, -1);
+    const lapack_int n = (lapack_int)query.real();
+    return n < dim ? dim : n;
+  }
+
+  int capacity;
+  int matDim;
+  size_t rhsSize;
+  lapack_int lwork;
+  // caller memory of the (dim, nrhs, mem) constructor, 0 once a buffer lives in the vectors below
+  lapack_int* ipivp;
+  std::complex<T>* matp;
+  std::complex<T>* workp;
+  std::complex<T>* rhsp;
+  std::vector<lapack_int> ipiv;
+  std::vector<std::complex<T> > mat;
+  std::vector<std::complex<T> > work;
+  std::vector<std::complex<T> > rhs;
+};
+
+typedef CplxInvWorkspaceT<double> CplxInvWorkspace;
+typedef CplxInvWorkspaceT<float> CplxInvWorkspaceF;
+
+// Determinant from a getrf factorization held in the workspace (leading dimension lda, default n).
+template <typename T>
+inline std::complex<T> DetCplxFromLU(const std::complex<T>* lu, const lapack_int* ipiv, int n, size_t lda = 0) {
+  const size_t ld = lda ? lda : (size_t)n;
+  std::complex<T> det(1, 0);
+  for (int i = 0; i < n; i++) {
+    if (i + 1 != ipiv[i])
+      det *= -lu[i * ld + i];
     else
-      det *= tmat[i * n + i];
+      det *= lu[i * ld + i];
   }
-  delete[] idx;
-  delete[] tmat;
   return det;
 }
 
-inline void InvertCplxNxN(std::complex<double>**A, std::complex<double>**B, int n) {
-  int* idx;
-  std::complex<double>* tmat;
-  tmat = new std::complex<double>[n * n];
+/*
+Running product of complex factors kept as z * 2^e with |z| in [0.5, 1), so that log|prod| and
+arg(prod) are available for any N without overflow or underflow, for a single log and atan2 at the end.
+*/
+struct CplxLogProduct {
+  std::complex<double> z;
+  int e;
+
+  CplxLogProduct() : z(1.0), e(0) {}
+
+  void Mul(const std::complex<double>& u) {
+    z *= u;
+    int k;
+    std::frexp(std::max(std::abs(z.real()), std::abs(z.imag())), &k);
+    z = std::complex<double>(std::ldexp(z.real(), -k), std::ldexp(z.imag(), -k));
+    e += k;
+  }
+
+  // real part log|prod| (-inf if a factor was zero), imaginary part arg(prod) in (-pi, pi]
+  std::complex<double> Log() const {
+    const double ln2 = 0.69314718055994530942;
+    return std::complex<double>(std::log(std::abs(z)) + e * ln2, std::arg(z));
+  }
+};
+
+// log(det) from a column-major getrf factorization.
+inline std::complex<double> LogDetCplxFromLU(const std::complex<double>* lu, const lapack_int* ipiv, int n) {
+  CplxLogProduct p;
+  for (int i = 0; i < n; i++) {
+    if (i + 1 != ipiv[i])
+      p.Mul(-lu[i * n + i]);
+    else
+      p.Mul(lu[i * n + i]);
+  }
+  return p.Log();
+}
+
+// mat is copied row by row, i.e. the workspace holds mat^T in column-major order; det(mat^T) = det(mat).
+template <typename T>
+inline std::complex<T> DetCplxNxN(std::complex<T>** mat, int dim, CplxInvWorkspaceT<T>& ws) {
+  const int n = dim;
+  ws.Reserve(n);
+  std::complex<T>* tmat = ws.Matrix();
+
+  for (int i = 0; i < n; i++) {
+    memcpy(tmat + i * n, mat[i], sizeof(std::complex<T>) * n);
+  }
+
+  CplxLapack<T>::Getrf(n, tmat, ws.Pivot());
+  return DetCplxFromLU(tmat, ws.Pivot(), n);
+}
+
+/*
+inv(A^T) = inv(A)^T, so copying the column-major inverse back row by row yields inv(A).
+Returns getrf / getri's info : 0, or k > 0 if U(k,k) is exactly zero (B then holds no inverse).
+With B == A and rows equally spaced in memory, LAPACK works on A directly, without the copy.
+*/
+template <typename T>
+inline int InvertCplxNxN(std::complex<T>**A, std::complex<T>**B, int n, CplxInvWorkspaceT<T>& ws,
+  std::complex<T>* det = 0) {
+  ws.Reserve(n);
+
+  if (A == B) {
+    const ptrdiff_t ld = n > 1 ? A[1] - A[0] : n;
+    bool strided = ld >= n;
+    for (int i = 2; i < n && strided; i++)
+      strided = A[i] - A[i - 1] == ld;
+    if (strided) {
+      lapack_int info = CplxLapack<T>::Getrf(n, A[0], ws.Pivot(), (size_t)ld);
+      if (det)
+        *det = DetCplxFromLU(A[0], ws.Pivot(), n, (size_t)ld);
+      if (!info)
+        info = CplxLapack<T>::Getri(n, A[0], ws.Pivot(), ws.Work(), ws.WorkSize(), (size_t)ld);
+      return info;
+    }
+  }
+
+  std::complex<T>* tmat = ws.Matrix();
 
-  idx = new int[n];
   for (int i = 0; i < n; i++) {
-    memcpy(tmat + i * n * sizeof(std::complex<double>), A[i], sizeof(std::complex<double>) * n);
+    memcpy(tmat + i * n, A[i], sizeof(std::complex<T>) * n);
   }
 
-  LAPACKE_zgetrf(LAPACK_COL_MAJOR, n, n, tmat, n, idx);
-  LAPACKE_zgetri(LAPACK_COL_MAJOR, n, tmat, n, idx);
-  
+  lapack_int info = CplxLapack<T>::Getrf(n, tmat, ws.Pivot());
+  if (det)
+    *det = DetCplxFromLU(tmat, ws.Pivot(), n);
+  if (!info)
+    info = CplxLapack<T>::Getri(n, tmat, ws.Pivot(), ws.Work(), ws.WorkSize());
+
   for (int i = 0; i < n; i++) {
-    memcpy(B[i],tmat + i * n * sizeof(std::complex<double>), sizeof(std::complex<double>) * n);
+    memcpy(B[i], tmat + i * n, sizeof(std::complex<T>) * n);
+  }
+  return info;
+}
+
+template <typename T>
+inline std::complex<T> DetCplxNxN(std::complex<T>** mat, int dim) {
+  CplxInvWorkspaceT<T> ws(dim);
+  return DetCplxNxN(mat, dim, ws);
+}
+
+template <typename T>
+inline int InvertCplxNxN(std::complex<T>**A, std::complex<T>**B, int n) {
+  CplxInvWorkspaceT<T> ws(n);
+  return InvertCplxNxN(A, B, n, ws);
+}
+
+/*
+Largest dim inverted by InvertCplxNative in the dispatchers; larger matrices go to LAPACK.
+The default suits a reference / generic LAPACK; bench_inversion --autotune measures it per host.
+*/
+#ifndef INVERSION_CPLX_NATIVE_MAX
+#define INVERSION_CPLX_NATIVE_MAX 32
+#endif
+
+// (ri, ii) -= (fr, fi) * (rk, ik) over n elements of distinct rows. Unrolled by 4 so that the
+// straight-line body is vectorized at -O2 as well, where GCC leaves runtime-length loops scalar.
+template <typename T>
+inline void CplxPlaneAxpy(T* __restrict ri, T* __restrict ii, const T* __restrict rk, const T* __restrict ik,
+  T fr, T fi, int n) {
+  int j = 0;
+  for (; j + 4 <= n; j += 4) {
+    const T r0 = rk[j], r1 = rk[j + 1], r2 = rk[j + 2], r3 = rk[j + 3];
+    const T m0 = ik[j], m1 = ik[j + 1], m2 = ik[j + 2], m3 = ik[j + 3];
+    ri[j] -= fr * r0 - fi * m0;
+    ri[j + 1] -= fr * r1 - fi * m1;
+    ri[j + 2] -= fr * r2 - fi * m2;
+    ri[j + 3] -= fr * r3 - fi * m3;
+    ii[j] -= fr * m0 + fi * r0;
+    ii[j + 1] -= fr * m1 + fi * r1;
+    ii[j + 2] -= fr * m2 + fi * r2;
+    ii[j + 3] -= fr * m3 + fi * r3;
   }
+  for (; j < n; j++) {
+    ri[j] -= fr * rk[j] - fi * ik[j];
+    ii[j] -= fr * ik[j] + fi * rk[j];
+  }
+}
+
+/*
+Native inversion for medium sizes : Gauss-Jordan elimination with partial pivoting, in place on
+split real / imaginary planes held in the workspace matrix. The rank-1 updates are then plain
+loops over contiguous doubles that the compiler vectorizes (std::complex products do not, because
+of their inf/NaN recovery), and both planes stay in L1/L2. There is no LAPACK call, lwork query
+or LAPACKE-internal allocation, which is what dominates zgetrf + zgetri for dims of a few tens.
+Returns 0, or k > 0 if column k has no nonzero pivot (B is then left unchanged).
+B may be A itself. det, if given, receives det(A), the signed product of the pivots (0 if singular).
+*/
+template <typename MT1, typename MT2, typename T>
+inline int InvertCplxNative(MT1 A, MT2 B, int n, CplxInvWorkspaceT<T>& ws, std::complex<T>* det = 0) {
+  ws.ReserveMatrix(n);
+  const size_t nn = (size_t)n * n;
+  T* re = reinterpret_cast<T*>(ws.Matrix());
+  T* im = re + nn;
+  lapack_int* p = ws.Pivot();
+  std::complex<T> d(1);
+
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++) {
+      const std::complex<T> a = A[i][j];
+      re[i * n + j] = a.real();
+      im[i * n + j] = a.imag();
+    }
+
+  for (int k = 0; k < n; k++) {
+    int piv = k;
+    T big = std::abs(re[k * n + k]) + std::abs(im[k * n + k]);
+    for (int i = k + 1; i < n; i++) {
+      const T m = std::abs(re[i * n + k]) + std::abs(im[i * n + k]);
+      if (m > big) {
+        big = m;
+        piv = i;
+      }
+    }
+    if (!(big > 0)) {
+      if (det)
+        *det = 0;
+      return k + 1;
+    }
+    p[k] = piv;
+
+    T* rk = re + k * n;
+    T* ik = im + k * n;
+    if (piv != k) {
+      T* rp = re + piv * n;
+      T* ip = im + piv * n;
+      for (int j = 0; j < n; j++) {
+        std::swap(rk[j], rp[j]);
+        std::swap(ik[j], ip[j]);
+      }
+    }
+
+    if (det)
+      d *= piv != k ? -std::complex<T>(rk[k], ik[k]) : std::complex<T>(rk[k], ik[k]);
+    const std::complex<T> ipivot = T(1) / std::complex<T>(rk[k], ik[k]);
+    const T pr = ipivot.real(), pi = ipivot.imag();
+    rk[k] = 1;
+    ik[k] = 0;
+    for (int j = 0; j < n; j++) {
+      const T r = rk[j], m = ik[j];
+      rk[j] = r * pr - m * pi;
+      ik[j] = r * pi + m * pr;
+    }
+
+    for (int i = 0; i < n; i++) {
+      if (i == k)
+        continue;
+      T* ri = re + i * n;
+      T* ii = im + i * n;
+      const T fr = ri[k], fi = ii[k];
+      ri[k] = 0;
+      ii[k] = 0;
+      CplxPlaneAxpy(ri, ii, rk, ik, fr, fi, n);
+    }
+  }
+
+  // row interchanges of A are column interchanges of inv(A)
+  for (int k = n - 1; k >= 0; k--)
+    if (p[k] != k)
+      for (int i = 0; i < n; i++) {
+        std::swap(re[i * n + k], re[i * n + p[k]]);
+        std::swap(im[i * n + k], im[i * n + p[k]]);
+      }
+
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      B[i][j] = std::complex<T>(re[i * n + j], im[i * n + j]);
+  if (det)
+    *det = d;
+  return 0;
+}
 
-  delete[] idx;
+/*
+InvertAndDetCplxKxK : the inverse goes to B and det(A) is returned, from the same cofactors
+(the inverse is the adjugate over the determinant). InvertCplxKxK discards the determinant.
+*/
+template <typename V>
+struct CplxPack;
+
+// B[i][j] /= det for the K x K adjugate in B; CplxPack (below) multiplies by one reciprocal instead.
+template <int K, typename MT, typename ET>
+inline void CplxDivByDet(MT B, const ET& det) {
+  for (int i = 0; i < K; i++)
+    for (int j = 0; j < K; j++)
+      B[i][j] /= det;
+}
+
+template <int K, typename MT, typename V>
+inline void CplxDivByDet(MT B, const CplxPack<V>& det);
+
+template <typename MT1, typename MT2>
+inline typename CplxElementOf<MT1>::Type InvertAndDetCplx1x1(MT1 A, MT2 B) {
+  typedef typename CplxElementOf<MT1>::Type ET;
+  const ET det(A[0][0]);
+  B[0][0] = ET(1.0) / det;
+  return det;
 }
 
-inline void InvertCplx1x1(std::complex<double>** A, std::complex<double>** B) {
-  B[0][0] = 1.0 / A[0][0];
+template <typename MT1, typename MT2>
+inline void InvertCplx1x1(MT1 A, MT2 B) {
+  InvertAndDetCplx1x1(A, B);
 }
 
-inline std::complex<double> DetCplx1x1(std::complex<double>** A) {
-  std::complex<double> det = (1.0 / A[0][0]);
+template <typename MT>
+inline typename CplxElementOf<MT>::Type DetCplx1x1(MT A) {
+  typedef typename CplxElementOf<MT>::Type ET;
+  ET det = A[0][0];
   return det;
 }
 
-inline void InvertCplx2x2(std::complex<double>** A, std::complex<double>** B)
+template <typename MT1, typename MT2>
+inline typename CplxElementOf<MT1>::Type InvertAndDetCplx2x2(MT1 A, MT2 B)
 {
+  typedef typename CplxElementOf<MT1>::Type ET;
 
-  const std::complex<double> det(A[0][0] * A[1][1] - A[0][1] * A[1][0]);
+  const ET a00(A[0][0]), a01(A[0][1]), a10(A[1][0]), a11(A[1][1]);
 
-  const std::complex<double> idet(1.0 / det);
-  const std::complex<double> a11(A[0][0] * idet);
+  const ET det(a00 * a11 - a01 * a10);
+  const ET idet(ET(1.0) / det);
 
-  A[0][0] = A[1][1] * idet;
-  A[1][0] = -A[1][0] * idet;
-  A[0][1] = -A[0][1] * idet;
-  A[1][1] = a11;
+  B[0][0] = a11 * idet;
+  B[0][1] = -a01 * idet;
+  B[1][0] = -a10 * idet;
+  B[1][1] = a00 * idet;
+  return det;
+}
+
+template <typename MT1, typename MT2>
+inline void InvertCplx2x2(MT1 A, MT2 B)
+{
+  InvertAndDetCplx2x2(A, B);
 }
 
-inline std::complex<double> DetCplx2x2(std::complex<double>** A)
+template <typename MT>
+inline typename CplxElementOf<MT>::Type DetCplx2x2(MT A)
 {
-  const std::complex<double> det(A[0][0] * A[1][1] - A[0][1] * A[1][0]);
+  typedef typename CplxElementOf<MT>::Type ET;
+  const ET det(A[0][0] * A[1][1] - A[0][1] * A[1][0]);
   return det;
 }
 
 
-inline void InvertCplx3x3(std::complex<double>** A, std::complex<double>** B)
+template <typename MT1, typename MT2>
+inline typename CplxElementOf<MT1>::Type InvertAndDetCplx3x3(MT1 A, MT2 B)
 {
+  typedef typename CplxElementOf<MT1>::Type ET;
+  ET a[3][3];
+  for (int i = 0; i < 3; i++)
+    for (int j = 0; j < 3; j++)
+      a[i][j] = A[i][j];
 
-  B[0][0] = A[1][1] * A[2][2] - A[1][2] * A[2][1];
-  B[1][0] = A[1][2] * A[2][0] - A[1][0] * A[2][2];
-  B[2][0] = A[1][0] * A[2][1] - A[1][1] * A[2][0];
+  B[0][0] = a[1][1] * a[2][2] - a[1][2] * a[2][1];
+  B[1][0] = a[1][2] * a[2][0] - a[1][0] * a[2][2];
+  B[2][0] = a[1][0] * a[2][1] - a[1][1] * a[2][0];
 
-  const std::complex<double> det(A[0][0] * B[0][0] + A[0][1] * B[1][0] + A[0][2] * B[2][0]);
+  const ET det(a[0][0] * B[0][0] + a[0][1] * B[1][0] + a[0][2] * B[2][0]);
 
-  B[0][1] = A[0][2] * A[2][1] - A[0][1] * A[2][2];
-  B[1][1] = A[0][0] * A[2][2] - A[0][2] * A[2][0];
-  B[2][1] = A[0][1] * A[2][0] - A[0][0] * A[2][1];
-  B[0][2] = A[0][1] * A[1][2] - A[0][2] * A[1][1];
-  B[1][2] = A[0][2] * A[1][0] - A[0][0] * A[1][2];
-  B[2][2] = A[0][0] * A[1][1] - A[0][1] * A[1][0];
+  B[0][1] = a[0][2] * a[2][1] - a[0][1] * a[2][2];
+  B[1][1] = a[0][0] * a[2][2] - a[0][2] * a[2][0];
+  B[2][1] = a[0][1] * a[2][0] - a[0][0] * a[2][1];
+  B[0][2] = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+  B[1][2] = a[0][2] * a[1][0] - a[0][0] * a[1][2];
+  B[2][2] = a[0][0] * a[1][1] - a[0][1] * a[1][0];
 
-  for (int i = 0; i < 3; i++)
-    for (int j = 0; j < 3; j++)
-      B[i][j] /= det;
+  CplxDivByDet<3>(B, det);
+  return det;
 }
 
-inline std::complex<double> DetCplx3x3(std::complex<double>** A)
+template <typename MT1, typename MT2>
+inline void InvertCplx3x3(MT1 A, MT2 B)
 {
+  InvertAndDetCplx3x3(A, B);
+}
 
-  std::complex<double>b0 = A[1][1] * A[2][2] - A[1][2] * A[2][1];
-  std::complex<double>b1 = A[1][2] * A[2][0] - A[1][0] * A[2][2];
-  std::complex<double>b2 = A[1][0] * A[2][1] - A[1][1] * A[2][0];
-  std::complex<double> det(A[0][0] * b0 + A[0][1] * b1 + A[0][2] * b2);
+template <typename MT>
+inline typename CplxElementOf<MT>::Type DetCplx3x3(MT A)
+{
+  typedef typename CplxElementOf<MT>::Type ET;
+
+  ET b0 = A[1][1] * A[2][2] - A[1][2] * A[2][1];
+  ET b1 = A[1][2] * A[2][0] - A[1][0] * A[2][2];
+  ET b2 = A[1][0] * A[2][1] - A[1][1] * A[2][0];
+  ET det(A[0][0] * b0 + A[0][1] * b1 + A[0][2] * b2);
   return det;
 }
 
 
-inline void InvertCplx4x4(std::complex<double>** A, std::complex<double>** B)
+template <typename MT1, typename MT2>
+inline typename CplxElementOf<MT1>::Type InvertAndDetCplx4x4(MT1 A, MT2 B)
 {
-  std::complex<double> tmp1(A[2][2] * A[3][3] - A[2][3] * A[3][2]);
-  std::complex<double> tmp2(A[2][1] * A[3][3] - A[2][3] * A[3][1]);
-  std::complex<double> tmp3(A[2][1] * A[3][2] - A[2][2] * A[3][1]);
+  typedef typename CplxElementOf<MT1>::Type ET;
+  ET a[4][4];
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++)
+      a[i][j] = A[i][j];
 
-  B[0][0] = A[1][1] * tmp1 - A[1][2] * tmp2 + A[1][3] * tmp3;
-  B[0][1] = A[0][2] * tmp2 - A[0][1] * tmp1 - A[0][3] * tmp3;
+  ET tmp1(a[2][2] * a[3][3] - a[2][3] * a[3][2]);
+  ET tmp2(a[2][1] * a[3][3] - a[2][3] * a[3][1]);
+  ET tmp3(a[2][1] * a[3][2] - a[2][2] * a[3][1]);
 
-  std::complex<double> tmp4(A[2][0] * A[3][3] - A[2][3] * A[3][0]);
-  std::complex<double> tmp5(A[2][0] * A[3][2] - A[2][2] * A[3][0]);
+  B[0][0] = a[1][1] * tmp1 - a[1][2] * tmp2 + a[1][3] * tmp3;
+  B[0][1] = a[0][2] * tmp2 - a[0][1] * tmp1 - a[0][3] * tmp3;
 
-  B[1][0] = A[1][2] * tmp4 - A[1][0] * tmp1 - A[1][3] * tmp5;
-  B[1][1] = A[0][0] * tmp1 - A[0][2] * tmp4 + A[0][3] * tmp5;
+  ET tmp4(a[2][0] * a[3][3] - a[2][3] * a[3][0]);
+  ET tmp5(a[2][0] * a[3][2] - a[2][2] * a[3][0]);
 
-  tmp1 = A[2][0] * A[3][1] - A[2][1] * A[3][0];
+  B[1][0] = a[1][2] * tmp4 - a[1][0] * tmp1 - a[1][3] * tmp5;
+  B[1][1] = a[0][0] * tmp1 - a[0][2] * tmp4 + a[0][3] * tmp5;
 
-  B[2][0] = A[1][0] * tmp2 - A[1][1] * tmp4 + A[1][3] * tmp1;
-  B[2][1] = A[0][1] * tmp4 - A[0][0] * tmp2 - A[0][3] * tmp1;
-  B[3][0] = A[1][1] * tmp5 - A[1][0] * tmp3 - A[1][2] * tmp1;
-  B[3][1] = A[0][0] * tmp3 - A[0][1] * tmp5 + A[0][2] * tmp1;
+  tmp1 = a[2][0] * a[3][1] - a[2][1] * a[3][0];
 
-  tmp1 = A[0][2] * A[1][3] - A[0][3] * A[1][2];
-  tmp2 = A[0][1] * A[1][3] - A[0][3] * A[1][1];
-  tmp3 = A[0][1] * A[1][2] - A[0][2] * A[1][1];
+  B[2][0] = a[1][0] * tmp2 - a[1][1] * tmp4 + a[1][3] * tmp1;
+  B[2][1] = a[0][1] * tmp4 - a[0][0] * tmp2 - a[0][3] * tmp1;
+  B[3][0] = a[1][1] * tmp5 - a[1][0] * tmp3 - a[1][2] * tmp1;
+  B[3][1] = a[0][0] * tmp3 - a[0][1] * tmp5 + a[0][2] * tmp1;
 
-  B[0][2] = A[3][1] * tmp1 - A[3][2] * tmp2 + A[3][3] * tmp3;
-  B[0][3] = A[2][2] * tmp2 - A[2][1] * tmp1 - A[2][3] * tmp3;
+  tmp1 = a[0][2] * a[1][3] - a[0][3] * a[1][2];
+  tmp2 = a[0][1] * a[1][3] - a[0][3] * a[1][1];
+  tmp3 = a[0][1] * a[1][2] - a[0][2] * a[1][1];
 
-  tmp4 = A[0][0] * A[1][3] - A[0][3] * A[1][0];
-  tmp5 = A[0][0] * A[1][2] - A[0][2] * A[1][0];
+  B[0][2] = a[3][1] * tmp1 - a[3][2] * tmp2 + a[3][3] * tmp3;
+  B[0][3] = a[2][2] * tmp2 - a[2][1] * tmp1 - a[2][3] * tmp3;
 
-  B[1][2] = A[3][2] * tmp4 - A[3][0] * tmp1 - A[3][3] * tmp5;
-  B[1][3] = A[2][0] * tmp1 - A[2][2] * tmp4 + A[2][3] * tmp5;
+  tmp4 = a[0][0] * a[1][3] - a[0][3] * a[1][0];
+  tmp5 = a[0][0] * a[1][2] - a[0][2] * a[1][0];
 
-  tmp1 = A[0][0] * A[1][1] - A[0][1] * A[1][0];
+  B[1][2] = a[3][2] * tmp4 - a[3][0] * tmp1 - a[3][3] * tmp5;
+  B[1][3] = a[2][0] * tmp1 - a[2][2] * tmp4 + a[2][3] * tmp5;
 
-  B[2][2] = A[3][0] * tmp2 - A[3][1] * tmp4 + A[3][3] * tmp1;
-  B[2][3] = A[2][1] * tmp4 - A[2][0] * tmp2 - A[2][3] * tmp1;
-  B[3][2] = A[3][1] * tmp5 - A[3][0] * tmp3 - A[3][2] * tmp1;
-  B[3][3] = A[2][0] * tmp3 - A[2][1] * tmp5 + A[2][2] * tmp1;
+  tmp1 = a[0][0] * a[1][1] - a[0][1] * a[1][0];
 
-  const std::complex<double> det(A[0][0] * B[0][0] + A[0][1] * B[1][0] + A[0][2] * B[2][0] + A[0][3] * B[3][0]);
+  B[2][2] = a[3][0] * tmp2 - a[3][1] * tmp4 + a[3][3] * tmp1;
+  B[2][3] = a[2][1] * tmp4 - a[2][0] * tmp2 - a[2][3] * tmp1;
+  B[3][2] = a[3][1] * tmp5 - a[3][0] * tmp3 - a[3][2] * tmp1;
+  B[3][3] = a[2][0] * tmp3 - a[2][1] * tmp5 + a[2][2] * tmp1;
 
-  for (int i = 0; i < 4; i++)
-    for (int j = 0; j < 4; j++)
-      B[i][j] /= det;
+  const ET det(a[0][0] * B[0][0] + a[0][1] * B[1][0] + a[0][2] * B[2][0] + a[0][3] * B[3][0]);
+
+  CplxDivByDet<4>(B, det);
+  return det;
+}
+
+template <typename MT1, typename MT2>
+inline void InvertCplx4x4(MT1 A, MT2 B)
+{
+  InvertAndDetCplx4x4(A, B);
 }
 
-inline std::complex<double> DetCplx4x4(std::complex<double>** A)
+template <typename MT>
+inline typename CplxElementOf<MT>::Type DetCplx4x4(MT A)
 {
-  std::complex<double> tmp1(A[2][2] * A[3][3] - A[2][3] * A[3][2]);
-  std::complex<double> tmp2(A[2][1] * A[3][3] - A[2][3] * A[3][1]);
-  std::complex<double> tmp3(A[2][1] * A[3][2] - A[2][2] * A[3][1]);
+  typedef typename CplxElementOf<MT>::Type ET;
+  ET tmp1(A[2][2] * A[3][3] - A[2][3] * A[3][2]);
+  ET tmp2(A[2][1] * A[3][3] - A[2][3] * A[3][1]);
+  ET tmp3(A[2][1] * A[3][2] - A[2][2] * A[3][1]);
 
-  std::complex<double>b0 = A[1][1] * tmp1 - A[1][2] * tmp2 + A[1][3] * tmp3;
+  ET b0 = A[1][1] * tmp1 - A[1][2] * tmp2 + A[1][3] * tmp3;
 
-  std::complex<double> tmp4(A[2][0] * A[3][3] - A[2][3] * A[3][0]);
-  std::complex<double> tmp5(A[2][0] * A[3][2] - A[2][2] * A[3][0]);
+  ET tmp4(A[2][0] * A[3][3] - A[2][3] * A[3][0]);
+  ET tmp5(A[2][0] * A[3][2] - A[2][2] * A[3][0]);
 
-  std::complex<double>b1 = A[1][2] * tmp4 - A[1][0] * tmp1 - A[1][3] * tmp5;
+  ET b1 = A[1][2] * tmp4 - A[1][0] * tmp1 - A[1][3] * tmp5;
 
   tmp1 = A[2][0] * A[3][1] - A[2][1] * A[3][0];
 
-  std::complex<double>b2 = A[1][0] * tmp2 - A[1][1] * tmp4 + A[1][3] * tmp1;
-  std::complex<double>b3 = A[1][1] * tmp5 - A[1][0] * tmp3 - A[1][2] * tmp1;
+  ET b2 = A[1][0] * tmp2 - A[1][1] * tmp4 + A[1][3] * tmp1;
+  ET b3 = A[1][1] * tmp5 - A[1][0] * tmp3 - A[1][2] * tmp1;
 
 
-  std::complex<double> det(A[0][0] * b0 + A[0][1] * b1 + A[0][2] * b2 + A[0][3] * b3);
+  ET det(A[0][0] * b0 + A[0][1] * b1 + A[0][2] * b2 + A[0][3] * b3);
   return  det;
 }
 
-inline void InvertCplx5x5(std::complex<double>** A, std::complex<double>** B)
+template <typename MT1, typename MT2>
+inline typename CplxElementOf<MT1>::Type InvertAndDetCplx5x5(MT1 A, MT2 B)
 {
-
-  std::complex<double> tmp1(A[3][3] * A[4][4] - A[3][4] * A[4][3]);
-  std::complex<double> tmp2(A[3][2] * A[4][4] - A[3][4] * A[4][2]);
-  std::complex<double> tmp3(A[3][2] * A[4][3] - A[3][3] * A[4][2]);
-  std::complex<double> tmp4(A[3][1] * A[4][4] - A[3][4] * A[4][1]);
-  std::complex<double> tmp5(A[3][1] * A[4][3] - A[3][3] * A[4][1]);
-  std::complex<double> tmp6(A[3][1] * A[4][2] - A[3][2] * A[4][1]);
-  std::complex<double> tmp7(A[3][0] * A[4][4] - A[3][4] * A[4][0]);
-  std::complex<double> tmp8(A[3][0] * A[4][3] - A[3][3] * A[4][0]);
-  std::complex<double> tmp9(A[3][0] * A[4][2] - A[3][2] * A[4][0]);
-  std::complex<double> tmp10(A[3][0] * A[4][1] - A[3][1] * A[4][0]);
-
-  std::complex<double> tmp11(A[2][2] * tmp1 - A[2][3] * tmp2 + A[2][4] * tmp3);
-  std::complex<double> tmp12(A[2][1] * tmp1 - A[2][3] * tmp4 + A[2][4] * tmp5);
-  std::complex<double> tmp13(A[2][1] * tmp2 - A[2][2] * tmp4 + A[2][4] * tmp6);
-  std::complex<double> tmp14(A[2][1] * tmp3 - A[2][2] * tmp5 + A[2][3] * tmp6);
-  std::complex<double> tmp15(A[2][0] * tmp1 - A[2][3] * tmp7 + A[2][4] * tmp8);
-  std::complex<double> tmp16(A[2][0] * tmp2 - A[2][2] * tmp7 + A[2][4] * tmp9);
-  std::complex<double> tmp17(A[2][0] * tmp3 - A[2][2] * tmp8 + A[2][3] * tmp9);
-
-  B[0][0] = A[1][1] * tmp11 - A[1][2] * tmp12 + A[1][3] * tmp13 - A[1][4] * tmp14;
-  B[0][1] = -A[0][1] * tmp11 + A[0][2] * tmp12 - A[0][3] * tmp13 + A[0][4] * tmp14;
-  B[1][0] = -A[1][0] * tmp11 + A[1][2] * tmp15 - A[1][3] * tmp16 + A[1][4] * tmp17;
-  B[1][1] = A[0][0] * tmp11 - A[0][2] * tmp15 + A[0][3] * tmp16 - A[0][4] * tmp17;
-
-  std::complex<double> tmp18(A[2][0] * tmp4 - A[2][1] * tmp7 + A[2][4] * tmp10);
-  std::complex<double> tmp19(A[2][0] * tmp5 - A[2][1] * tmp8 + A[2][3] * tmp10);
-  std::complex<double> tmp20(A[2][0] * tmp6 - A[2][1] * tmp9 + A[2][2] * tmp10);
-
-  B[2][0] = A[1][0] * tmp12 - A[1][1] * tmp15 + A[1][3] * tmp18 - A[1][4] * tmp19;
-  B[2][1] = -A[0][0] * tmp12 + A[0][1] * tmp15 - A[0][3] * tmp18 + A[0][4] * tmp19;
-  B[3][0] = -A[1][0] * tmp13 + A[1][1] * tmp16 - A[1][2] * tmp18 + A[1][4] * tmp20;
-  B[3][1] = A[0][0] * tmp13 - A[0][1] * tmp16 + A[0][2] * tmp18 - A[0][4] * tmp20;
-  B[4][0] = A[1][0] * tmp14 - A[1][1] * tmp17 + A[1][2] * tmp19 - A[1][3] * tmp20;
-  B[4][1] = -A[0][0] * tmp14 + A[0][1] * tmp17 - A[0][2] * tmp19 + A[0][3] * tmp20;
-
-  tmp11 = A[1][2] * tmp1 - A[1][3] * tmp2 + A[1][4] * tmp3;
-  tmp12 = A[1][1] * tmp1 - A[1][3] * tmp4 + A[1][4] * tmp5;
-  tmp13 = A[1][1] * tmp2 - A[1][2] * tmp4 + A[1][4] * tmp6;
-  tmp14 = A[1][1] * tmp3 - A[1][2] * tmp5 + A[1][3] * tmp6;
-  tmp15 = A[1][0] * tmp1 - A[1][3] * tmp7 + A[1][4] * tmp8;
-  tmp16 = A[1][0] * tmp2 - A[1][2] * tmp7 + A[1][4] * tmp9;
-  tmp17 = A[1][0] * tmp3 - A[1][2] * tmp8 + A[1][3] * tmp9;
-  tmp18 = A[1][0] * tmp4 - A[1][1] * tmp7 + A[1][4] * tmp10;
-  tmp19 = A[1][0] * tmp5 - A[1][1] * tmp8 + A[1][3] * tmp10;
-
-  B[0][2] = A[0][1] * tmp11 - A[0][2] * tmp12 + A[0][3] * tmp13 - A[0][4] * tmp14;
-  B[1][2] = -A[0][0] * tmp11 + A[0][2] * tmp15 - A[0][3] * tmp16 + A[0][4] * tmp17;
-  B[2][2] = A[0][0] * tmp12 - A[0][1] * tmp15 + A[0][3] * tmp18 - A[0][4] * tmp19;
-
-  tmp1 = A[0][2] * A[1][3] - A[0][3] * A[1][2];
-  tmp2 = A[0][1] * A[1][3] - A[0][3] * A[1][1];
-  tmp3 = A[0][1] * A[1][2] - A[0][2] * A[1][1];
-  tmp4 = A[0][0] * A[1][3] - A[0][3] * A[1][0];
-  tmp5 = A[0][0] * A[1][2] - A[0][2] * A[1][0];
-  tmp6 = A[0][0] * A[1][1] - A[0][1] * A[1][0];
-  tmp7 = A[0][2] * A[1][4] - A[0][4] * A[1][2];
-  tmp8 = A[0][1] * A[1][4] - A[0][4] * A[1][1];
-  tmp9 = A[0][0] * A[1][4] - A[0][4] * A[1][0];
-  tmp10 = A[0][3] * A[1][4] - A[0][4] * A[1][3];
-
-  tmp11 = A[2][2] * tmp10 - A[2][3] * tmp7 + A[2][4] * tmp1;
-  tmp12 = A[2][1] * tmp10 - A[2][3] * tmp8 + A[2][4] * tmp2;
-  tmp13 = A[2][1] * tmp7 - A[2][2] * tmp8 + A[2][4] * tmp3;
-  tmp14 = A[2][1] * tmp1 - A[2][2] * tmp2 + A[2][3] * tmp3;
-  tmp15 = A[2][0] * tmp10 - A[2][3] * tmp9 + A[2][4] * tmp4;
-  tmp16 = A[2][0] * tmp7 - A[2][2] * tmp9 + A[2][4] * tmp5;
-  tmp17 = A[2][0] * tmp1 - A[2][2] * tmp4 + A[2][3] * tmp5;
-
-  B[0][3] = A[4][1] * tmp11 - A[4][2] * tmp12 + A[4][3] * tmp13 - A[4][4] * tmp14;
-  B[0][4] = -A[3][1] * tmp11 + A[3][2] * tmp12 - A[3][3] * tmp13 + A[3][4] * tmp14;
-  B[1][3] = -A[4][0] * tmp11 + A[4][2] * tmp15 - A[4][3] * tmp16 + A[4][4] * tmp17;
-  B[1][4] = A[3][0] * tmp11 - A[3][2] * tmp15 + A[3][3] * tmp16 - A[3][4] * tmp17;
-
-  tmp18 = A[2][0] * tmp8 - A[2][1] * tmp9 + A[2][4] * tmp6;
-  tmp19 = A[2][0] * tmp2 - A[2][1] * tmp4 + A[2][3] * tmp6;
-  tmp20 = A[2][0] * tmp3 - A[2][1] * tmp5 + A[2][2] * tmp6;
-
-  B[2][3] = A[4][0] * tmp12 - A[4][1] * tmp15 + A[4][3] * tmp18 - A[4][4] * tmp19;
-  B[2][4] = -A[3][0] * tmp12 + A[3][1] * tmp15 - A[3][3] * tmp18 + A[3][4] * tmp19;
-  B[3][3] = -A[4][0] * tmp13 + A[4][1] * tmp16 - A[4][2] * tmp18 + A[4][4] * tmp20;
-  B[3][4] = A[3][0] * tmp13 - A[3][1] * tmp16 + A[3][2] * tmp18 - A[3][4] * tmp20;
-  B[4][3] = A[4][0] * tmp14 - A[4][1] * tmp17 + A[4][2] * tmp19 - A[4][3] * tmp20;
-  B[4][4] = -A[3][0] * tmp14 + A[3][1] * tmp17 - A[3][2] * tmp19 + A[3][3] * tmp20;
-
-  tmp11 = A[3][1] * tmp7 - A[3][2] * tmp8 + A[3][4] * tmp3;
-  tmp12 = A[3][0] * tmp7 - A[3][2] * tmp9 + A[3][4] * tmp5;
-  tmp13 = A[3][0] * tmp8 - A[3][1] * tmp9 + A[3][4] * tmp6;
-  tmp14 = A[3][0] * tmp3 - A[3][1] * tmp5 + A[3][2] * tmp6;
-
-  tmp15 = A[3][1] * tmp1 - A[3][2] * tmp2 + A[3][3] * tmp3;
-  tmp16 = A[3][0] * tmp1 - A[3][2] * tmp4 + A[3][3] * tmp5;
-  tmp17 = A[3][0] * tmp2 - A[3][1] * tmp4 + A[3][3] * tmp6;
-
-  B[3][2] = A[4][0] * tmp11 - A[4][1] * tmp12 + A[4][2] * tmp13 - A[4][4] * tmp14;
-  B[4][2] = -A[4][0] * tmp15 + A[4][1] * tmp16 - A[4][2] * tmp17 + A[4][3] * tmp14;
-
-  const std::complex<double> det(A[0][0] * B[0][0] + A[0][1] * B[1][0] + A[0][2] * B[2][0] + A[0][3] * B[3][0] + A[0][4] * B[4][0]);
-
+  typedef typename CplxElementOf<MT1>::Type ET;
+  ET a[5][5];
   for (int i = 0; i < 5; i++)
     for (int j = 0; j < 5; j++)
-      B[i][j] /= det;
+      a[i][j] = A[i][j];
+
+  ET tmp1(a[3][3] * a[4][4] - a[3][4] * a[4][3]);
+  ET tmp2(a[3][2] * a[4][4] - a[3][4] * a[4][2]);
+  ET tmp3(a[3][2] * a[4][3] - a[3][3] * a[4][2]);
+  ET tmp4(a[3][1] * a[4][4] - a[3][4] * a[4][1]);
+  ET tmp5(a[3][1] * a[4][3] - a[3][3] * a[4][1]);
+  ET tmp6(a[3][1] * a[4][2] - a[3][2] * a[4][1]);
+  ET tmp7(a[3][0] * a[4][4] - a[3][4] * a[4][0]);
+  ET tmp8(a[3][0] * a[4][3] - a[3][3] * a[4][0]);
+  ET tmp9(a[3][0] * a[4][2] - a[3][2] * a[4][0]);
+  ET tmp10(a[3][0] * a[4][1] - a[3][1] * a[4][0]);
+
+  ET tmp11(a[2][2] * tmp1 - a[2][3] * tmp2 + a[2][4] * tmp3);
+  ET tmp12(a[2][1] * tmp1 - a[2][3] * tmp4 + a[2][4] * tmp5);
+  ET tmp13(a[2][1] * tmp2 - a[2][2] * tmp4 + a[2][4] * tmp6);
+  ET tmp14(a[2][1] * tmp3 - a[2][2] * tmp5 + a[2][3] * tmp6);
+  ET tmp15(a[2][0] * tmp1 - a[2][3] * tmp7 + a[2][4] * tmp8);
+  ET tmp16(a[2][0] * tmp2 - a[2][2] * tmp7 + a[2][4] * tmp9);
+  ET tmp17(a[2][0] * tmp3 - a[2][2] * tmp8 + a[2][3] * tmp9);
+
+  B[0][0] = a[1][1] * tmp11 - a[1][2] * tmp12 + a[1][3] * tmp13 - a[1][4] * tmp14;
+  B[0][1] = -a[0][1] * tmp11 + a[0][2] * tmp12 - a[0][3] * tmp13 + a[0][4] * tmp14;
+  B[1][0] = -a[1][0] * tmp11 + a[1][2] * tmp15 - a[1][3] * tmp16 + a[1][4] * tmp17;
+  B[1][1] = a[0][0] * tmp11 - a[0][2] * tmp15 + a[0][3] * tmp16 - a[0][4] * tmp17;
+
+  ET tmp18(a[2][0] * tmp4 - a[2][1] * tmp7 + a[2][4] * tmp10);
+  ET tmp19(a[2][0] * tmp5 - a[2][1] * tmp8 + a[2][3] * tmp10);
+  ET tmp20(a[2][0] * tmp6 - a[2][1] * tmp9 + a[2][2] * tmp10);
+
+  B[2][0] = a[1][0] * tmp12 - a[1][1] * tmp15 + a[1][3] * tmp18 - a[1][4] * tmp19;
+  B[2][1] = -a[0][0] * tmp12 + a[0][1] * tmp15 - a[0][3] * tmp18 + a[0][4] * tmp19;
+  B[3][0] = -a[1][0] * tmp13 + a[1][1] * tmp16 - a[1][2] * tmp18 + a[1][4] * tmp20;
+  B[3][1] = a[0][0] * tmp13 - a[0][1] * tmp16 + a[0][2] * tmp18 - a[0][4] * tmp20;
+  B[4][0] = a[1][0] * tmp14 - a[1][1] * tmp17 + a[1][2] * tmp19 - a[1][3] * tmp20;
+  B[4][1] = -a[0][0] * tmp14 + a[0][1] * tmp17 - a[0][2] * tmp19 + a[0][3] * tmp20;
+
+  tmp11 = a[1][2] * tmp1 - a[1][3] * tmp2 + a[1][4] * tmp3;
+  tmp12 = a[1][1] * tmp1 - a[1][3] * tmp4 + a[1][4] * tmp5;
+  tmp13 = a[1][1] * tmp2 - a[1][2] * tmp4 + a[1][4] * tmp6;
+  tmp14 = a[1][1] * tmp3 - a[1][2] * tmp5 + a[1][3] * tmp6;
+  tmp15 = a[1][0] * tmp1 - a[1][3] * tmp7 + a[1][4] * tmp8;
+  tmp16 = a[1][0] * tmp2 - a[1][2] * tmp7 + a[1][4] * tmp9;
+  tmp17 = a[1][0] * tmp3 - a[1][2] * tmp8 + a[1][3] * tmp9;
+  tmp18 = a[1][0] * tmp4 - a[1][1] * tmp7 + a[1][4] * tmp10;
+  tmp19 = a[1][0] * tmp5 - a[1][1] * tmp8 + a[1][3] * tmp10;
+
+  B[0][2] = a[0][1] * tmp11 - a[0][2] * tmp12 + a[0][3] * tmp13 - a[0][4] * tmp14;
+  B[1][2] = -a[0][0] * tmp11 + a[0][2] * tmp15 - a[0][3] * tmp16 + a[0][4] * tmp17;
+  B[2][2] = a[0][0] * tmp12 - a[0][1] * tmp15 + a[0][3] * tmp18 - a[0][4] * tmp19;
+
+  tmp1 = a[0][2] * a[1][3] - a[0][3] * a[1][2];
+  tmp2 = a[0][1] * a[1][3] - a[0][3] * a[1][1];
+  tmp3 = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+  tmp4 = a[0][0] * a[1][3] - a[0][3] * a[1][0];
+  tmp5 = a[0][0] * a[1][2] - a[0][2] * a[1][0];
+  tmp6 = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+  tmp7 = a[0][2] * a[1][4] - a[0][4] * a[1][2];
+  tmp8 = a[0][1] * a[1][4] - a[0][4] * a[1][1];
+  tmp9 = a[0][0] * a[1][4] - a[0][4] * a[1][0];
+  tmp10 = a[0][3] * a[1][4] - a[0][4] * a[1][3];
+
+  tmp11 = a[2][2] * tmp10 - a[2][3] * tmp7 + a[2][4] * tmp1;
+  tmp12 = a[2][1] * tmp10 - a[2][3] * tmp8 + a[2][4] * tmp2;
+  tmp13 = a[2][1] * tmp7 - a[2][2] * tmp8 + a[2][4] * tmp3;
+  tmp14 = a[2][1] * tmp1 - a[2][2] * tmp2 + a[2][3] * tmp3;
+  tmp15 = a[2][0] * tmp10 - a[2][3] * tmp9 + a[2][4] * tmp4;
+  tmp16 = a[2][0] * tmp7 - a[2][2] * tmp9 + a[2][4] * tmp5;
+  tmp17 = a[2][0] * tmp1 - a[2][2] * tmp4 + a[2][3] * tmp5;
+
+  B[0][3] = a[4][1] * tmp11 - a[4][2] * tmp12 + a[4][3] * tmp13 - a[4][4] * tmp14;
+  B[0][4] = -a[3][1] * tmp11 + a[3][2] * tmp12 - a[3][3] * tmp13 + a[3][4] * tmp14;
+  B[1][3] = -a[4][0] * tmp11 + a[4][2] * tmp15 - a[4][3] * tmp16 + a[4][4] * tmp17;
+  B[1][4] = a[3][0] * tmp11 - a[3][2] * tmp15 + a[3][3] * tmp16 - a[3][4] * tmp17;
+
+  tmp18 = a[2][0] * tmp8 - a[2][1] * tmp9 + a[2][4] * tmp6;
+  tmp19 = a[2][0] * tmp2 - a[2][1] * tmp4 + a[2][3] * tmp6;
+  tmp20 = a[2][0] * tmp3 - a[2][1] * tmp5 + a[2][2] * tmp6;
+
+  B[2][3] = a[4][0] * tmp12 - a[4][1] * tmp15 + a[4][3] * tmp18 - a[4][4] * tmp19;
+  B[2][4] = -a[3][0] * tmp12 + a[3][1] * tmp15 - a[3][3] * tmp18 + a[3][4] * tmp19;
+  B[3][3] = -a[4][0] * tmp13 + a[4][1] * tmp16 - a[4][2] * tmp18 + a[4][4] * tmp20;
+  B[3][4] = a[3][0] * tmp13 - a[3][1] * tmp16 + a[3][2] * tmp18 - a[3][4] * tmp20;
+  B[4][3] = a[4][0] * tmp14 - a[4][1] * tmp17 + a[4][2] * tmp19 - a[4][3] * tmp20;
+  B[4][4] = -a[3][0] * tmp14 + a[3][1] * tmp17 - a[3][2] * tmp19 + a[3][3] * tmp20;
+
+  tmp11 = a[3][1] * tmp7 - a[3][2] * tmp8 + a[3][4] * tmp3;
+  tmp12 = a[3][0] * tmp7 - a[3][2] * tmp9 + a[3][4] * tmp5;
+  tmp13 = a[3][0] * tmp8 - a[3][1] * tmp9 + a[3][4] * tmp6;
+  tmp14 = a[3][0] * tmp3 - a[3][1] * tmp5 + a[3][2] * tmp6;
+
+  tmp15 = a[3][1] * tmp1 - a[3][2] * tmp2 + a[3][3] * tmp3;
+  tmp16 = a[3][0] * tmp1 - a[3][2] * tmp4 + a[3][3] * tmp5;
+  tmp17 = a[3][0] * tmp2 - a[3][1] * tmp4 + a[3][3] * tmp6;
+
+  B[3][2] = a[4][0] * tmp11 - a[4][1] * tmp12 + a[4][2] * tmp13 - a[4][4] * tmp14;
+  B[4][2] = -a[4][0] * tmp15 + a[4][1] * tmp16 - a[4][2] * tmp17 + a[4][3] * tmp14;
+
+  const ET det(a[0][0] * B[0][0] + a[0][1] * B[1][0] + a[0][2] * B[2][0] + a[0][3] * B[3][0] + a[0][4] * B[4][0]);
+
+  CplxDivByDet<5>(B, det);
+  return det;
 }
 
-inline std::complex<double> DetCplx5x5(std::complex<double>** A)
+template <typename MT1, typename MT2>
+inline void InvertCplx5x5(MT1 A, MT2 B)
 {
+  InvertAndDetCplx5x5(A, B);
+}
 
-  std::complex<double> tmp1(A[3][3] * A[4][4] - A[3][4] * A[4][3]);
-  std::complex<double> tmp2(A[3][2] * A[4][4] - A[3][4] * A[4][2]);
-  std::complex<double> tmp3(A[3][2] * A[4][3] - A[3][3] * A[4][2]);
-  std::complex<double> tmp4(A[3][1] * A[4][4] - A[3][4] * A[4][1]);
-  std::complex<double> tmp5(A[3][1] * A[4][3] - A[3][3] * A[4][1]);
-  std::complex<double> tmp6(A[3][1] * A[4][2] - A[3][2] * A[4][1]);
-  std::complex<double> tmp7(A[3][0] * A[4][4] - A[3][4] * A[4][0]);
-  std::complex<double> tmp8(A[3][0] * A[4][3] - A[3][3] * A[4][0]);
-  std::complex<double> tmp9(A[3][0] * A[4][2] - A[3][2] * A[4][0]);
-  std::complex<double> tmp10(A[3][0] * A[4][1] - A[3][1] * A[4][0]);
-
-  std::complex<double> tmp11(A[2][2] * tmp1 - A[2][3] * tmp2 + A[2][4] * tmp3);
-  std::complex<double> tmp12(A[2][1] * tmp1 - A[2][3] * tmp4 + A[2][4] * tmp5);
-  std::complex<double> tmp13(A[2][1] * tmp2 - A[2][2] * tmp4 + A[2][4] * tmp6);
-  std::complex<double> tmp14(A[2][1] * tmp3 - A[2][2] * tmp5 + A[2][3] * tmp6);
-  std::complex<double> tmp15(A[2][0] * tmp1 - A[2][3] * tmp7 + A[2][4] * tmp8);
-  std::complex<double> tmp16(A[2][0] * tmp2 - A[2][2] * tmp7 + A[2][4] * tmp9);
-  std::complex<double> tmp17(A[2][0] * tmp3 - A[2][2] * tmp8 + A[2][3] * tmp9);
-
-  std::complex<double>b0 = A[1][1] * tmp11 - A[1][2] * tmp12 + A[1][3] * tmp13 - A[1][4] * tmp14;
-  std::complex<double>b1 = -A[1][0] * tmp11 + A[1][2] * tmp15 - A[1][3] * tmp16 + A[1][4] * tmp17;
-
-  std::complex<double> tmp18(A[2][0] * tmp4 - A[2][1] * tmp7 + A[2][4] * tmp10);
-  std::complex<double> tmp19(A[2][0] * tmp5 - A[2][1] * tmp8 + A[2][3] * tmp10);
-  std::complex<double> tmp20(A[2][0] * tmp6 - A[2][1] * tmp9 + A[2][2] * tmp10);
-
-  std::complex<double>b2 = A[1][0] * tmp12 - A[1][1] * tmp15 + A[1][3] * tmp18 - A[1][4] * tmp19;
-  std::complex<double>b3 = -A[1][0] * tmp13 + A[1][1] * tmp16 - A[1][2] * tmp18 + A[1][4] * tmp20;
-  std::complex<double>b4 = A[1][0] * tmp14 - A[1][1] * tmp17 + A[1][2] * tmp19 - A[1][3] * tmp20;
-
-  std::complex<double> det(A[0][0] * b0 + A[0][1] * b1 + A[0][2] * b2 + A[0][3] * b3 + A[0][4] * b4);
+template <typename MT>
+inline typename CplxElementOf<MT>::Type DetCplx5x5(MT A)
+{
+  typedef typename CplxElementOf<MT>::Type ET;
+
+  ET tmp1(A[3][3] * A[4][4] - A[3][4] * A[4][3]);
+  ET tmp2(A[3][2] * A[4][4] - A[3][4] * A[4][2]);
+  ET tmp3(A[3][2] * A[4][3] - A[3][3] * A[4][2]);
+  ET tmp4(A[3][1] * A[4][4] - A[3][4] * A[4][1]);
+  ET tmp5(A[3][1] * A[4][3] - A[3][3] * A[4][1]);
+  ET tmp6(A[3][1] * A[4][2] - A[3][2] * A[4][1]);
+  ET tmp7(A[3][0] * A[4][4] - A[3][4] * A[4][0]);
+  ET tmp8(A[3][0] * A[4][3] - A[3][3] * A[4][0]);
+  ET tmp9(A[3][0] * A[4][2] - A[3][2] * A[4][0]);
+  ET tmp10(A[3][0] * A[4][1] - A[3][1] * A[4][0]);
+
+  ET tmp11(A[2][2] * tmp1 - A[2][3] * tmp2 + A[2][4] * tmp3);
+  ET tmp12(A[2][1] * tmp1 - A[2][3] * tmp4 + A[2][4] * tmp5);
+  ET tmp13(A[2][1] * tmp2 - A[2][2] * tmp4 + A[2][4] * tmp6);
+  ET tmp14(A[2][1] * tmp3 - A[2][2] * tmp5 + A[2][3] * tmp6);
+  ET tmp15(A[2][0] * tmp1 - A[2][3] * tmp7 + A[2][4] * tmp8);
+  ET tmp16(A[2][0] * tmp2 - A[2][2] * tmp7 + A[2][4] * tmp9);
+  ET tmp17(A[2][0] * tmp3 - A[2][2] * tmp8 + A[2][3] * tmp9);
+
+  ET b0 = A[1][1] * tmp11 - A[1][2] * tmp12 + A[1][3] * tmp13 - A[1][4] * tmp14;
+  ET b1 = -A[1][0] * tmp11 + A[1][2] * tmp15 - A[1][3] * tmp16 + A[1][4] * tmp17;
+
+  ET tmp18(A[2][0] * tmp4 - A[2][1] * tmp7 + A[2][4] * tmp10);
+  ET tmp19(A[2][0] * tmp5 - A[2][1] * tmp8 + A[2][3] * tmp10);
+  ET tmp20(A[2][0] * tmp6 - A[2][1] * tmp9 + A[2][2] * tmp10);
+
+  ET b2 = A[1][0] * tmp12 - A[1][1] * tmp15 + A[1][3] * tmp18 - A[1][4] * tmp19;
+  ET b3 = -A[1][0] * tmp13 + A[1][1] * tmp16 - A[1][2] * tmp18 + A[1][4] * tmp20;
+  ET b4 = A[1][0] * tmp14 - A[1][1] * tmp17 + A[1][2] * tmp19 - A[1][3] * tmp20;
+
+  ET det(A[0][0] * b0 + A[0][1] * b1 + A[0][2] * b2 + A[0][3] * b3 + A[0][4] * b4);
   return det;
 
 
 }
 
-inline void InvertCplx6x6(std::complex<double>** A, std::complex<double>** B)
+template <typename MT1, typename MT2>
+inline typename CplxElementOf<MT1>::Type InvertAndDetCplx6x6(MT1 A, MT2 B)
 {
-  std::complex<double> tmp1(A[4][4] * A[5][5] - A[4][5] * A[5][4]);
-  std::complex<double> tmp2(A[4][3] * A[5][5] - A[4][5] * A[5][3]);
-  std::complex<double> tmp3(A[4][3] * A[5][4] - A[4][4] * A[5][3]);
-  std::complex<double> tmp4(A[4][2] * A[5][5] - A[4][5] * A[5][2]);
-  std::complex<double> tmp5(A[4][2] * A[5][4] - A[4][4] * A[5][2]);
-  std::complex<double> tmp6(A[4][2] * A[5][3] - A[4][3] * A[5][2]);
-  std::complex<double> tmp7(A[4][1] * A[5][5] - A[4][5] * A[5][1]);
-  std::complex<double> tmp8(A[4][1] * A[5][4] - A[4][4] * A[5][1]);
-  std::complex<double> tmp9(A[4][1] * A[5][3] - A[4][3] * A[5][1]);
-  std::complex<double> tmp10(A[4][1] * A[5][2] - A[4][2] * A[5][1]);
-  std::complex<double> tmp11(A[4][0] * A[5][5] - A[4][5] * A[5][0]);
-  std::complex<double> tmp12(A[4][0] * A[5][4] - A[4][4] * A[5][0]);
-  std::complex<double> tmp13(A[4][0] * A[5][3] - A[4][3] * A[5][0]);
-  std::complex<double> tmp14(A[4][0] * A[5][2] - A[4][2] * A[5][0]);
-  std::complex<double> tmp15(A[4][0] * A[5][1] - A[4][1] * A[5][0]);
-
-  std::complex<double> tmp16(A[3][3] * tmp1 - A[3][4] * tmp2 + A[3][5] * tmp3);
-  std::complex<double> tmp17(A[3][2] * tmp1 - A[3][4] * tmp4 + A[3][5] * tmp5);
-  std::complex<double> tmp18(A[3][2] * tmp2 - A[3][3] * tmp4 + A[3][5] * tmp6);
-  std::complex<double> tmp19(A[3][2] * tmp3 - A[3][3] * tmp5 + A[3][4] * tmp6);
-  std::complex<double> tmp20(A[3][1] * tmp1 - A[3][4] * tmp7 + A[3][5] * tmp8);
-  std::complex<double> tmp21(A[3][1] * tmp2 - A[3][3] * tmp7 + A[3][5] * tmp9);
-  std::complex<double> tmp22(A[3][1] * tmp3 - A[3][3] * tmp8 + A[3][4] * tmp9);
-  std::complex<double> tmp23(A[3][1] * tmp4 - A[3][2] * tmp7 + A[3][5] * tmp10);
-  std::complex<double> tmp24(A[3][1] * tmp5 - A[3][2] * tmp8 + A[3][4] * tmp10);
-  std::complex<double> tmp25(A[3][1] * tmp6 - A[3][2] * tmp9 + A[3][3] * tmp10);
-  std::complex<double> tmp26(A[3][0] * tmp1 - A[3][4] * tmp11 + A[3][5] * tmp12);
-  std::complex<double> tmp27(A[3][0] * tmp2 - A[3][3] * tmp11 + A[3][5] * tmp13);
-  std::complex<double> tmp28(A[3][0] * tmp3 - A[3][3] * tmp12 + A[3][4] * tmp13);
-  std::complex<double> tmp29(A[3][0] * tmp4 - A[3][2] * tmp11 + A[3][5] * tmp14);
-  std::complex<double> tmp30(A[3][0] * tmp5 - A[3][2] * tmp12 + A[3][4] * tmp14);
-  std::complex<double> tmp31(A[3][0] * tmp6 - A[3][2] * tmp13 + A[3][3] * tmp14);
-  std::complex<double> tmp32(A[3][0] * tmp7 - A[3][1] * tmp11 + A[3][5] * tmp15);
-  std::complex<double> tmp33(A[3][0] * tmp8 - A[3][1] * tmp12 + A[3][4] * tmp15);
-  std::complex<double> tmp34(A[3][0] * tmp9 - A[3][1] * tmp13 + A[3][3] * tmp15);
-  std::complex<double> tmp35(A[3][0] * tmp10 - A[3][1] * tmp14 + A[3][2] * tmp15);
-
-  std::complex<double> tmp36(A[2][2] * tmp16 - A[2][3] * tmp17 + A[2][4] * tmp18 - A[2][5] * tmp19);
-  std::complex<double> tmp37(A[2][1] * tmp16 - A[2][3] * tmp20 + A[2][4] * tmp21 - A[2][5] * tmp22);
-  std::complex<double> tmp38(A[2][1] * tmp17 - A[2][2] * tmp20 + A[2][4] * tmp23 - A[2][5] * tmp24);
-  std::complex<double> tmp39(A[2][1] * tmp18 - A[2][2] * tmp21 + A[2][3] * tmp23 - A[2][5] * tmp25);
-  std::complex<double> tmp40(A[2][1] * tmp19 - A[2][2] * tmp22 + A[2][3] * tmp24 - A[2][4] * tmp25);
-  std::complex<double> tmp41(A[2][0] * tmp16 - A[2][3] * tmp26 + A[2][4] * tmp27 - A[2][5] * tmp28);
-  std::complex<double> tmp42(A[2][0] * tmp17 - A[2][2] * tmp26 + A[2][4] * tmp29 - A[2][5] * tmp30);
-  std::complex<double> tmp43(A[2][0] * tmp18 - A[2][2] * tmp27 + A[2][3] * tmp29 - A[2][5] * tmp31);
-  std::complex<double> tmp44(A[2][0] * tmp19 - A[2][2] * tmp28 + A[2][3] * tmp30 - A[2][4] * tmp31);
-
-  B[0][0] = A[1][1] * tmp36 - A[1][2] * tmp37 + A[1][3] * tmp38 - A[1][4] * tmp39 + A[1][5] * tmp40;
-  B[0][1] = -A[0][1] * tmp36 + A[0][2] * tmp37 - A[0][3] * tmp38 + A[0][4] * tmp39 - A[0][5] * tmp40;
-  B[1][0] = -A[1][0] * tmp36 + A[1][2] * tmp41 - A[1][3] * tmp42 + A[1][4] * tmp43 - A[1][5] * tmp44;
-  B[1][1] = A[0][0] * tmp36 - A[0][2] * tmp41 + A[0][3] * tmp42 - A[0][4] * tmp43 + A[0][5] * tmp44;
-
-  std::complex<double> tmp45(A[2][0] * tmp20 - A[2][1] * tmp26 + A[2][4] * tmp32 - A[2][5] * tmp33);
-  std::complex<double> tmp46(A[2][0] * tmp21 - A[2][1] * tmp27 + A[2][3] * tmp32 - A[2][5] * tmp34);
-  std::complex<double> tmp47(A[2][0] * tmp22 - A[2][1] * tmp28 + A[2][3] * tmp33 - A[2][4] * tmp34);
-  std::complex<double> tmp48(A[2][0] * tmp23 - A[2][1] * tmp29 + A[2][2] * tmp32 - A[2][5] * tmp35);
-  std::complex<double> tmp49(A[2][0] * tmp24 - A[2][1] * tmp30 + A[2][2] * tmp33 - A[2][4] * tmp35);
-
-  B[2][0] = A[1][0] * tmp37 - A[1][1] * tmp41 + A[1][3] * tmp45 - A[1][4] * tmp46 + A[1][5] * tmp47;
-  B[2][1] = -A[0][0] * tmp37 + A[0][1] * tmp41 - A[0][3] * tmp45 + A[0][4] * tmp46 - A[0][5] * tmp47;
-  B[3][0] = -A[1][0] * tmp38 + A[1][1] * tmp42 - A[1][2] * tmp45 + A[1][4] * tmp48 - A[1][5] * tmp49;
-  B[3][1] = A[0][0] * tmp38 - A[0][1] * tmp42 + A[0][2] * tmp45 - A[0][4] * tmp48 + A[0][5] * tmp49;
-
-  std::complex<double> tmp50(A[2][0] * tmp25 - A[2][1] * tmp31 + A[2][2] * tmp34 - A[2][3] * tmp35);
-
-  B[4][0] = A[1][0] * tmp39 - A[1][1] * tmp43 + A[1][2] * tmp46 - A[1][3] * tmp48 + A[1][5] * tmp50;
-  B[4][1] = -A[0][0] * tmp39 + A[0][1] * tmp43 - A[0][2] * tmp46 + A[0][3] * tmp48 - A[0][5] * tmp50;
-  B[5][0] = -A[1][0] * tmp40 + A[1][1] * tmp44 - A[1][2] * tmp47 + A[1][3] * tmp49 - A[1][4] * tmp50;
-  B[5][1] = A[0][0] * tmp40 - A[0][1] * tmp44 + A[0][2] * tmp47 - A[0][3] * tmp49 + A[0][4] * tmp50;
-
-  tmp36 = A[1][2] * tmp16 - A[1][3] * tmp17 + A[1][4] * tmp18 - A[1][5] * tmp19;
-  tmp37 = A[1][1] * tmp16 - A[1][3] * tmp20 + A[1][4] * tmp21 - A[1][5] * tmp22;
-  tmp38 = A[1][1] * tmp17 - A[1][2] * tmp20 + A[1][4] * tmp23 - A[1][5] * tmp24;
-  tmp39 = A[1][1] * tmp18 - A[1][2] * tmp21 + A[1][3] * tmp23 - A[1][5] * tmp25;
-  tmp40 = A[1][1] * tmp19 - A[1][2] * tmp22 + A[1][3] * tmp24 - A[1][4] * tmp25;
-  tmp41 = A[1][0] * tmp16 - A[1][3] * tmp26 + A[1][4] * tmp27 - A[1][5] * tmp28;
-  tmp42 = A[1][0] * tmp17 - A[1][2] * tmp26 + A[1][4] * tmp29 - A[1][5] * tmp30;
-  tmp43 = A[1][0] * tmp18 - A[1][2] * tmp27 + A[1][3] * tmp29 - A[1][5] * tmp31;
-  tmp44 = A[1][0] * tmp19 - A[1][2] * tmp28 + A[1][3] * tmp30 - A[1][4] * tmp31;
-  tmp45 = A[1][0] * tmp20 - A[1][1] * tmp26 + A[1][4] * tmp32 - A[1][5] * tmp33;
-  tmp46 = A[1][0] * tmp21 - A[1][1] * tmp27 + A[1][3] * tmp32 - A[1][5] * tmp34;
-  tmp47 = A[1][0] * tmp22 - A[1][1] * tmp28 + A[1][3] * tmp33 - A[1][4] * tmp34;
-  tmp48 = A[1][0] * tmp23 - A[1][1] * tmp29 + A[1][2] * tmp32 - A[1][5] * tmp35;
-  tmp49 = A[1][0] * tmp24 - A[1][1] * tmp30 + A[1][2] * tmp33 - A[1][4] * tmp35;
-  tmp50 = A[1][0] * tmp25 - A[1][1] * tmp31 + A[1][2] * tmp34 - A[1][3] * tmp35;
-
-  B[0][2] = A[0][1] * tmp36 - A[0][2] * tmp37 + A[0][3] * tmp38 - A[0][4] * tmp39 + A[0][5] * tmp40;
-  B[1][2] = -A[0][0] * tmp36 + A[0][2] * tmp41 - A[0][3] * tmp42 + A[0][4] * tmp43 - A[0][5] * tmp44;
-  B[2][2] = A[0][0] * tmp37 - A[0][1] * tmp41 + A[0][3] * tmp45 - A[0][4] * tmp46 + A[0][5] * tmp47;
-  B[3][2] = -A[0][0] * tmp38 + A[0][1] * tmp42 - A[0][2] * tmp45 + A[0][4] * tmp48 - A[0][5] * tmp49;
-  B[4][2] = A[0][0] * tmp39 - A[0][1] * tmp43 + A[0][2] * tmp46 - A[0][3] * tmp48 + A[0][5] * tmp50;
-  B[5][2] = -A[0][0] * tmp40 + A[0][1] * tmp44 - A[0][2] * tmp47 + A[0][3] * tmp49 - A[0][4] * tmp50;
-
-  tmp1 = A[0][3] * A[1][4] - A[0][4] * A[1][3];
-  tmp2 = A[0][2] * A[1][4] - A[0][4] * A[1][2];
-  tmp3 = A[0][2] * A[1][3] - A[0][3] * A[1][2];
-  tmp4 = A[0][1] * A[1][4] - A[0][4] * A[1][1];
-  tmp5 = A[0][1] * A[1][3] - A[0][3] * A[1][1];
-  tmp6 = A[0][1] * A[1][2] - A[0][2] * A[1][1];
-  tmp7 = A[0][0] * A[1][4] - A[0][4] * A[1][0];
-  tmp8 = A[0][0] * A[1][3] - A[0][3] * A[1][0];
-  tmp9 = A[0][0] * A[1][2] - A[0][2] * A[1][0];
-  tmp10 = A[0][0] * A[1][1] - A[0][1] * A[1][0];
-  tmp11 = A[0][3] * A[1][5] - A[0][5] * A[1][3];
-  tmp12 = A[0][2] * A[1][5] - A[0][5] * A[1][2];
-  tmp13 = A[0][1] * A[1][5] - A[0][5] * A[1][1];
-  tmp14 = A[0][0] * A[1][5] - A[0][5] * A[1][0];
-  tmp15 = A[0][4] * A[1][5] - A[0][5] * A[1][4];
-
-  tmp16 = A[2][3] * tmp15 - A[2][4] * tmp11 + A[2][5] * tmp1;
-  tmp17 = A[2][2] * tmp15 - A[2][4] * tmp12 + A[2][5] * tmp2;
-  tmp18 = A[2][2] * tmp11 - A[2][3] * tmp12 + A[2][5] * tmp3;
-  tmp19 = A[2][2] * tmp1 - A[2][3] * tmp2 + A[2][4] * tmp3;
-  tmp20 = A[2][1] * tmp15 - A[2][4] * tmp13 + A[2][5] * tmp4;
-  tmp21 = A[2][1] * tmp11 - A[2][3] * tmp13 + A[2][5] * tmp5;
-  tmp22 = A[2][1] * tmp1 - A[2][3] * tmp4 + A[2][4] * tmp5;
-  tmp23 = A[2][1] * tmp12 - A[2][2] * tmp13 + A[2][5] * tmp6;
-  tmp24 = A[2][1] * tmp2 - A[2][2] * tmp4 + A[2][4] * tmp6;
-  tmp25 = A[2][1] * tmp3 - A[2][2] * tmp5 + A[2][3] * tmp6;
-  tmp26 = A[2][0] * tmp15 - A[2][4] * tmp14 + A[2][5] * tmp7;
-  tmp27 = A[2][0] * tmp11 - A[2][3] * tmp14 + A[2][5] * tmp8;
-  tmp28 = A[2][0] * tmp1 - A[2][3] * tmp7 + A[2][4] * tmp8;
-  tmp29 = A[2][0] * tmp12 - A[2][2] * tmp14 + A[2][5] * tmp9;
-  tmp30 = A[2][0] * tmp2 - A[2][2] * tmp7 + A[2][4] * tmp9;
-  tmp31 = A[2][0] * tmp3 - A[2][2] * tmp8 + A[2][3] * tmp9;
-  tmp32 = A[2][0] * tmp13 - A[2][1] * tmp14 + A[2][5] * tmp10;
-  tmp33 = A[2][0] * tmp4 - A[2][1] * tmp7 + A[2][4] * tmp10;
-  tmp34 = A[2][0] * tmp5 - A[2][1] * tmp8 + A[2][3] * tmp10;
-  tmp35 = A[2][0] * tmp6 - A[2][1] * tmp9 + A[2][2] * tmp10;
-
-  tmp36 = A[3][2] * tmp16 - A[3][3] * tmp17 + A[3][4] * tmp18 - A[3][5] * tmp19;
-  tmp37 = A[3][1] * tmp16 - A[3][3] * tmp20 + A[3][4] * tmp21 - A[3][5] * tmp22;
-  tmp38 = A[3][1] * tmp17 - A[3][2] * tmp20 + A[3][4] * tmp23 - A[3][5] * tmp24;
-  tmp39 = A[3][1] * tmp18 - A[3][2] * tmp21 + A[3][3] * tmp23 - A[3][5] * tmp25;
-  tmp40 = A[3][1] * tmp19 - A[3][2] * tmp22 + A[3][3] * tmp24 - A[3][4] * tmp25;
-  tmp41 = A[3][0] * tmp16 - A[3][3] * tmp26 + A[3][4] * tmp27 - A[3][5] * tmp28;
-  tmp42 = A[3][0] * tmp17 - A[3][2] * tmp26 + A[3][4] * tmp29 - A[3][5] * tmp30;
-  tmp43 = A[3][0] * tmp18 - A[3][2] * tmp27 + A[3][3] * tmp29 - A[3][5] * tmp31;
-  tmp44 = A[3][0] * tmp19 - A[3][2] * tmp28 + A[3][3] * tmp30 - A[3][4] * tmp31;
-
-  B[0][4] = -A[5][1] * tmp36 + A[5][2] * tmp37 - A[5][3] * tmp38 + A[5][4] * tmp39 - A[5][5] * tmp40;
-  B[0][5] = A[4][1] * tmp36 - A[4][2] * tmp37 + A[4][3] * tmp38 - A[4][4] * tmp39 + A[4][5] * tmp40;
-  B[1][4] = A[5][0] * tmp36 - A[5][2] * tmp41 + A[5][3] * tmp42 - A[5][4] * tmp43 + A[5][5] * tmp44;
-  B[1][5] = -A[4][0] * tmp36 + A[4][2] * tmp41 - A[4][3] * tmp42 + A[4][4] * tmp43 - A[4][5] * tmp44;
-
-  tmp45 = A[3][0] * tmp20 - A[3][1] * tmp26 + A[3][4] * tmp32 - A[3][5] * tmp33;
-  tmp46 = A[3][0] * tmp21 - A[3][1] * tmp27 + A[3][3] * tmp32 - A[3][5] * tmp34;
-  tmp47 = A[3][0] * tmp22 - A[3][1] * tmp28 + A[3][3] * tmp33 - A[3][4] * tmp34;
-  tmp48 = A[3][0] * tmp23 - A[3][1] * tmp29 + A[3][2] * tmp32 - A[3][5] * tmp35;
-  tmp49 = A[3][0] * tmp24 - A[3][1] * tmp30 + A[3][2] * tmp33 - A[3][4] * tmp35;
-
-  B[2][4] = -A[5][0] * tmp37 + A[5][1] * tmp41 - A[5][3] * tmp45 + A[5][4] * tmp46 - A[5][5] * tmp47;
-  B[2][5] = A[4][0] * tmp37 - A[4][1] * tmp41 + A[4][3] * tmp45 - A[4][4] * tmp46 + A[4][5] * tmp47;
-  B[3][4] = A[5][0] * tmp38 - A[5][1] * tmp42 + A[5][2] * tmp45 - A[5][4] * tmp48 + A[5][5] * tmp49;
-  B[3][5] = -A[4][0] * tmp38 + A[4][1] * tmp42 - A[4][2] * tmp45 + A[4][4] * tmp48 - A[4][5] * tmp49;
-
-  tmp50 = A[3][0] * tmp25 - A[3][1] * tmp31 + A[3][2] * tmp34 - A[3][3] * tmp35;
-
-  B[4][4] = -A[5][0] * tmp39 + A[5][1] * tmp43 - A[5][2] * tmp46 + A[5][3] * tmp48 - A[5][5] * tmp50;
-  B[4][5] = A[4][0] * tmp39 - A[4][1] * tmp43 + A[4][2] * tmp46 - A[4][3] * tmp48 + A[4][5] * tmp50;
-  B[5][4] = A[5][0] * tmp40 - A[5][1] * tmp44 + A[5][2] * tmp47 - A[5][3] * tmp49 + A[5][4] * tmp50;
-  B[5][5] = -A[4][0] * tmp40 + A[4][1] * tmp44 - A[4][2] * tmp47 + A[4][3] * tmp49 - A[4][4] * tmp50;
-
-  tmp36 = A[4][2] * tmp16 - A[4][3] * tmp17 + A[4][4] * tmp18 - A[4][5] * tmp19;
-  tmp37 = A[4][1] * tmp16 - A[4][3] * tmp20 + A[4][4] * tmp21 - A[4][5] * tmp22;
-  tmp38 = A[4][1] * tmp17 - A[4][2] * tmp20 + A[4][4] * tmp23 - A[4][5] * tmp24;
-  tmp39 = A[4][1] * tmp18 - A[4][2] * tmp21 + A[4][3] * tmp23 - A[4][5] * tmp25;
-  tmp40 = A[4][1] * tmp19 - A[4][2] * tmp22 + A[4][3] * tmp24 - A[4][4] * tmp25;
-  tmp41 = A[4][0] * tmp16 - A[4][3] * tmp26 + A[4][4] * tmp27 - A[4][5] * tmp28;
-  tmp42 = A[4][0] * tmp17 - A[4][2] * tmp26 + A[4][4] * tmp29 - A[4][5] * tmp30;
-  tmp43 = A[4][0] * tmp18 - A[4][2] * tmp27 + A[4][3] * tmp29 - A[4][5] * tmp31;
-  tmp44 = A[4][0] * tmp19 - A[4][2] * tmp28 + A[4][3] * tmp30 - A[4][4] * tmp31;
-  tmp45 = A[4][0] * tmp20 - A[4][1] * tmp26 + A[4][4] * tmp32 - A[4][5] * tmp33;
-  tmp46 = A[4][0] * tmp21 - A[4][1] * tmp27 + A[4][3] * tmp32 - A[4][5] * tmp34;
-  tmp47 = A[4][0] * tmp22 - A[4][1] * tmp28 + A[4][3] * tmp33 - A[4][4] * tmp34;
-  tmp48 = A[4][0] * tmp23 - A[4][1] * tmp29 + A[4][2] * tmp32 - A[4][5] * tmp35;
-  tmp49 = A[4][0] * tmp24 - A[4][1] * tmp30 + A[4][2] * tmp33 - A[4][4] * tmp35;
-  tmp50 = A[4][0] * tmp25 - A[4][1] * tmp31 + A[4][2] * tmp34 - A[4][3] * tmp35;
-
-  B[0][3] = A[5][1] * tmp36 - A[5][2] * tmp37 + A[5][3] * tmp38 - A[5][4] * tmp39 + A[5][5] * tmp40;
-  B[1][3] = -A[5][0] * tmp36 + A[5][2] * tmp41 - A[5][3] * tmp42 + A[5][4] * tmp43 - A[5][5] * tmp44;
-  B[2][3] = A[5][0] * tmp37 - A[5][1] * tmp41 + A[5][3] * tmp45 - A[5][4] * tmp46 + A[5][5] * tmp47;
-  B[3][3] = -A[5][0] * tmp38 + A[5][1] * tmp42 - A[5][2] * tmp45 + A[5][4] * tmp48 - A[5][5] * tmp49;
-  B[4][3] = A[5][0] * tmp39 - A[5][1] * tmp43 + A[5][2] * tmp46 - A[5][3] * tmp48 + A[5][5] * tmp50;
-  B[5][3] = -A[5][0] * tmp40 + A[5][1] * tmp44 - A[5][2] * tmp47 + A[5][3] * tmp49 - A[5][4] * tmp50;
-
-  const std::complex<double> det(A[0][0] * B[0][0] + A[0][1] * B[1][0] + A[0][2] * B[2][0] +
-    A[0][3] * B[3][0] + A[0][4] * B[4][0] + A[0][5] * B[5][0]);
-
+  typedef typename CplxElementOf<MT1>::Type ET;
+  ET a[6][6];
   for (int i = 0; i < 6; i++)
     for (int j = 0; j < 6; j++)
-      B[i][j] /= det;
+      a[i][j] = A[i][j];
+
+  ET tmp1(a[4][4] * a[5][5] - a[4][5] * a[5][4]);
+  ET tmp2(a[4][3] * a[5][5] - a[4][5] * a[5][3]);
+  ET tmp3(a[4][3] * a[5][4] - a[4][4] * a[5][3]);
+  ET tmp4(a[4][2] * a[5][5] - a[4][5] * a[5][2]);
+  ET tmp5(a[4][2] * a[5][4] - a[4][4] * a[5][2]);
+  ET tmp6(a[4][2] * a[5][3] - a[4][3] * a[5][2]);
+  ET tmp7(a[4][1] * a[5][5] - a[4][5] * a[5][1]);
+  ET tmp8(a[4][1] * a[5][4] - a[4][4] * a[5][1]);
+  ET tmp9(a[4][1] * a[5][3] - a[4][3] * a[5][1]);
+  ET tmp10(a[4][1] * a[5][2] - a[4][2] * a[5][1]);
+  ET tmp11(a[4][0] * a[5][5] - a[4][5] * a[5][0]);
+  ET tmp12(a[4][0] * a[5][4] - a[4][4] * a[5][0]);
+  ET tmp13(a[4][0] * a[5][3] - a[4][3] * a[5][0]);
+  ET tmp14(a[4][0] * a[5][2] - a[4][2] * a[5][0]);
+  ET tmp15(a[4][0] * a[5][1] - a[4][1] * a[5][0]);
+
+  ET tmp16(a[3][3] * tmp1 - a[3][4] * tmp2 + a[3][5] * tmp3);
+  ET tmp17(a[3][2] * tmp1 - a[3][4] * tmp4 + a[3][5] * tmp5);
+  ET tmp18(a[3][2] * tmp2 - a[3][3] * tmp4 + a[3][5] * tmp6);
+  ET tmp19(a[3][2] * tmp3 - a[3][3] * tmp5 + a[3][4] * tmp6);
+  ET tmp20(a[3][1] * tmp1 - a[3][4] * tmp7 + a[3][5] * tmp8);
+  ET tmp21(a[3][1] * tmp2 - a[3][3] * tmp7 + a[3][5] * tmp9);
+  ET tmp22(a[3][1] * tmp3 - a[3][3] * tmp8 + a[3][4] * tmp9);
+  ET tmp23(a[3][1] * tmp4 - a[3][2] * tmp7 + a[3][5] * tmp10);
+  ET tmp24(a[3][1] * tmp5 - a[3][2] * tmp8 + a[3][4] * tmp10);
+  ET tmp25(a[3][1] * tmp6 - a[3][2] * tmp9 + a[3][3] * tmp10);
+  ET tmp26(a[3][0] * tmp1 - a[3][4] * tmp11 + a[3][5] * tmp12);
+  ET tmp27(a[3][0] * tmp2 - a[3][3] * tmp11 + a[3][5] * tmp13);
+  ET tmp28(a[3][0] * tmp3 - a[3][3] * tmp12 + a[3][4] * tmp13);
+  ET tmp29(a[3][0] * tmp4 - a[3][2] * tmp11 + a[3][5] * tmp14);
+  ET tmp30(a[3][0] * tmp5 - a[3][2] * tmp12 + a[3][4] * tmp14);
+  ET tmp31(a[3][0] * tmp6 - a[3][2] * tmp13 + a[3][3] * tmp14);
+  ET tmp32(a[3][0] * tmp7 - a[3][1] * tmp11 + a[3][5] * tmp15);
+  ET tmp33(a[3][0] * tmp8 - a[3][1] * tmp12 + a[3][4] * tmp15);
+  ET tmp34(a[3][0] * tmp9 - a[3][1] * tmp13 + a[3][3] * tmp15);
+  ET tmp35(a[3][0] * tmp10 - a[3][1] * tmp14 + a[3][2] * tmp15);
+
+  ET tmp36(a[2][2] * tmp16 - a[2][3] * tmp17 + a[2][4] * tmp18 - a[2][5] * tmp19);
+  ET tmp37(a[2][1] * tmp16 - a[2][3] * tmp20 + a[2][4] * tmp21 - a[2][5] * tmp22);
+  ET tmp38(a[2][1] * tmp17 - a[2][2] * tmp20 + a[2][4] * tmp23 - a[2][5] * tmp24);
+  ET tmp39(a[2][1] * tmp18 - a[2][2] * tmp21 + a[2][3] * tmp23 - a[2][5] * tmp25);
+  ET tmp40(a[2][1] * tmp19 - a[2][2] * tmp22 + a[2][3] * tmp24 - a[2][4] * tmp25);
+  ET tmp41(a[2][0] * tmp16 - a[2][3] * tmp26 + a[2][4] * tmp27 - a[2][5] * tmp28);
+  ET tmp42(a[2][0] * tmp17 - a[2][2] * tmp26 + a[2][4] * tmp29 - a[2][5] * tmp30);
+  ET tmp43(a[2][0] * tmp18 - a[2][2] * tmp27 + a[2][3] * tmp29 - a[2][5] * tmp31);
+  ET tmp44(a[2][0] * tmp19 - a[2][2] * tmp28 + a[2][3] * tmp30 - a[2][4] * tmp31);
+
+  B[0][0] = a[1][1] * tmp36 - a[1][2] * tmp37 + a[1][3] * tmp38 - a[1][4] * tmp39 + a[1][5] * tmp40;
+  B[0][1] = -a[0][1] * tmp36 + a[0][2] * tmp37 - a[0][3] * tmp38 + a[0][4] * tmp39 - a[0][5] * tmp40;
+  B[1][0] = -a[1][0] * tmp36 + a[1][2] * tmp41 - a[1][3] * tmp42 + a[1][4] * tmp43 - a[1][5] * tmp44;
+  B[1][1] = a[0][0] * tmp36 - a[0][2] * tmp41 + a[0][3] * tmp42 - a[0][4] * tmp43 + a[0][5] * tmp44;
+
+  ET tmp45(a[2][0] * tmp20 - a[2][1] * tmp26 + a[2][4] * tmp32 - a[2][5] * tmp33);
+  ET tmp46(a[2][0] * tmp21 - a[2][1] * tmp27 + a[2][3] * tmp32 - a[2][5] * tmp34);
+  ET tmp47(a[2][0] * tmp22 - a[2][1] * tmp28 + a[2][3] * tmp33 - a[2][4] * tmp34);
+  ET tmp48(a[2][0] * tmp23 - a[2][1] * tmp29 + a[2][2] * tmp32 - a[2][5] * tmp35);
+  ET tmp49(a[2][0] * tmp24 - a[2][1] * tmp30 + a[2][2] * tmp33 - a[2][4] * tmp35);
+
+  B[2][0] = a[1][0] * tmp37 - a[1][1] * tmp41 + a[1][3] * tmp45 - a[1][4] * tmp46 + a[1][5] * tmp47;
+  B[2][1] = -a[0][0] * tmp37 + a[0][1] * tmp41 - a[0][3] * tmp45 + a[0][4] * tmp46 - a[0][5] * tmp47;
+  B[3][0] = -a[1][0] * tmp38 + a[1][1] * tmp42 - a[1][2] * tmp45 + a[1][4] * tmp48 - a[1][5] * tmp49;
+  B[3][1] = a[0][0] * tmp38 - a[0][1] * tmp42 + a[0][2] * tmp45 - a[0][4] * tmp48 + a[0][5] * tmp49;
+
+  ET tmp50(a[2][0] * tmp25 - a[2][1] * tmp31 + a[2][2] * tmp34 - a[2][3] * tmp35);
+
+  B[4][0] = a[1][0] * tmp39 - a[1][1] * tmp43 + a[1][2] * tmp46 - a[1][3] * tmp48 + a[1][5] * tmp50;
+  B[4][1] = -a[0][0] * tmp39 + a[0][1] * tmp43 - a[0][2] * tmp46 + a[0][3] * tmp48 - a[0][5] * tmp50;
+  B[5][0] = -a[1][0] * tmp40 + a[1][1] * tmp44 - a[1][2] * tmp47 + a[1][3] * tmp49 - a[1][4] * tmp50;
+  B[5][1] = a[0][0] * tmp40 - a[0][1] * tmp44 + a[0][2] * tmp47 - a[0][3] * tmp49 + a[0][4] * tmp50;
+
+  tmp36 = a[1][2] * tmp16 - a[1][3] * tmp17 + a[1][4] * tmp18 - a[1][5] * tmp19;
+  tmp37 = a[1][1] * tmp16 - a[1][3] * tmp20 + a[1][4] * tmp21 - a[1][5] * tmp22;
+  tmp38 = a[1][1] * tmp17 - a[1][2] * tmp20 + a[1][4] * tmp23 - a[1][5] * tmp24;
+  tmp39 = a[1][1] * tmp18 - a[1][2] * tmp21 + a[1][3] * tmp23 - a[1][5] * tmp25;
+  tmp40 = a[1][1] * tmp19 - a[1][2] * tmp22 + a[1][3] * tmp24 - a[1][4] * tmp25;
+  tmp41 = a[1][0] * tmp16 - a[1][3] * tmp26 + a[1][4] * tmp27 - a[1][5] * tmp28;
+  tmp42 = a[1][0] * tmp17 - a[1][2] * tmp26 + a[1][4] * tmp29 - a[1][5] * tmp30;
+  tmp43 = a[1][0] * tmp18 - a[1][2] * tmp27 + a[1][3] * tmp29 - a[1][5] * tmp31;
+  tmp44 = a[1][0] * tmp19 - a[1][2] * tmp28 + a[1][3] * tmp30 - a[1][4] * tmp31;
+  tmp45 = a[1][0] * tmp20 - a[1][1] * tmp26 + a[1][4] * tmp32 - a[1][5] * tmp33;
+  tmp46 = a[1][0] * tmp21 - a[1][1] * tmp27 + a[1][3] * tmp32 - a[1][5] * tmp34;
+  tmp47 = a[1][0] * tmp22 - a[1][1] * tmp28 + a[1][3] * tmp33 - a[1][4] * tmp34;
+  tmp48 = a[1][0] * tmp23 - a[1][1] * tmp29 + a[1][2] * tmp32 - a[1][5] * tmp35;
+  tmp49 = a[1][0] * tmp24 - a[1][1] * tmp30 + a[1][2] * tmp33 - a[1][4] * tmp35;
+  tmp50 = a[1][0] * tmp25 - a[1][1] * tmp31 + a[1][2] * tmp34 - a[1][3] * tmp35;
+
+  B[0][2] = a[0][1] * tmp36 - a[0][2] * tmp37 + a[0][3] * tmp38 - a[0][4] * tmp39 + a[0][5] * tmp40;
+  B[1][2] = -a[0][0] * tmp36 + a[0][2] * tmp41 - a[0][3] * tmp42 + a[0][4] * tmp43 - a[0][5] * tmp44;
+  B[2][2] = a[0][0] * tmp37 - a[0][1] * tmp41 + a[0][3] * tmp45 - a[0][4] * tmp46 + a[0][5] * tmp47;
+  B[3][2] = -a[0][0] * tmp38 + a[0][1] * tmp42 - a[0][2] * tmp45 + a[0][4] * tmp48 - a[0][5] * tmp49;
+  B[4][2] = a[0][0] * tmp39 - a[0][1] * tmp43 + a[0][2] * tmp46 - a[0][3] * tmp48 + a[0][5] * tmp50;
+  B[5][2] = -a[0][0] * tmp40 + a[0][1] * tmp44 - a[0][2] * tmp47 + a[0][3] * tmp49 - a[0][4] * tmp50;
+
+  tmp1 = a[0][3] * a[1][4] - a[0][4] * a[1][3];
+  tmp2 = a[0][2] * a[1][4] - a[0][4] * a[1][2];
+  tmp3 = a[0][2] * a[1][3] - a[0][3] * a[1][2];
+  tmp4 = a[0][1] * a[1][4] - a[0][4] * a[1][1];
+  tmp5 = a[0][1] * a[1][3] - a[0][3] * a[1][1];
+  tmp6 = a[0][1] * a[1][2] - a[0][2] * a[1][1];
+  tmp7 = a[0][0] * a[1][4] - a[0][4] * a[1][0];
+  tmp8 = a[0][0] * a[1][3] - a[0][3] * a[1][0];
+  tmp9 = a[0][0] * a[1][2] - a[0][2] * a[1][0];
+  tmp10 = a[0][0] * a[1][1] - a[0][1] * a[1][0];
+  tmp11 = a[0][3] * a[1][5] - a[0][5] * a[1][3];
+  tmp12 = a[0][2] * a[1][5] - a[0][5] * a[1][2];
+  tmp13 = a[0][1] * a[1][5] - a[0][5] * a[1][1];
+  tmp14 = a[0][0] * a[1][5] - a[0][5] * a[1][0];
+  tmp15 = a[0][4] * a[1][5] - a[0][5] * a[1][4];
+
+  tmp16 = a[2][3] * tmp15 - a[2][4] * tmp11 + a[2][5] * tmp1;
+  tmp17 = a[2][2] * tmp15 - a[2][4] * tmp12 + a[2][5] * tmp2;
+  tmp18 = a[2][2] * tmp11 - a[2][3] * tmp12 + a[2][5] * tmp3;
+  tmp19 = a[2][2] * tmp1 - a[2][3] * tmp2 + a[2][4] * tmp3;
+  tmp20 = a[2][1] * tmp15 - a[2][4] * tmp13 + a[2][5] * tmp4;
+  tmp21 = a[2][1] * tmp11 - a[2][3] * tmp13 + a[2][5] * tmp5;
+  tmp22 = a[2][1] * tmp1 - a[2][3] * tmp4 + a[2][4] * tmp5;
+  tmp23 = a[2][1] * tmp12 - a[2][2] * tmp13 + a[2][5] * tmp6;
+  tmp24 = a[2][1] * tmp2 - a[2][2] * tmp4 + a[2][4] * tmp6;
+  tmp25 = a[2][1] * tmp3 - a[2][2] * tmp5 + a[2][3] * tmp6;
+  tmp26 = a[2][0] * tmp15 - a[2][4] * tmp14 + a[2][5] * tmp7;
+  tmp27 = a[2][0] * tmp11 - a[2][3] * tmp14 + a[2][5] * tmp8;
+  tmp28 = a[2][0] * tmp1 - a[2][3] * tmp7 + a[2][4] * tmp8;
+  tmp29 = a[2][0] * tmp12 - a[2][2] * tmp14 + a[2][5] * tmp9;
+  tmp30 = a[2][0] * tmp2 - a[2][2] * tmp7 + a[2][4] * tmp9;
+  tmp31 = a[2][0] * tmp3 - a[2][2] * tmp8 + a[2][3] * tmp9;
+  tmp32 = a[2][0] * tmp13 - a[2][1] * tmp14 + a[2][5] * tmp10;
+  tmp33 = a[2][0] * tmp4 - a[2][1] * tmp7 + a[2][4] * tmp10;
+  tmp34 = a[2][0] * tmp5 - a[2][1] * tmp8 + a[2][3] * tmp10;
+  tmp35 = a[2][0] * tmp6 - a[2][1] * tmp9 + a[2][2] * tmp10;
+
+  tmp36 = a[3][2] * tmp16 - a[3][3] * tmp17 + a[3][4] * tmp18 - a[3][5] * tmp19;
+  tmp37 = a[3][1] * tmp16 - a[3][3] * tmp20 + a[3][4] * tmp21 - a[3][5] * tmp22;
+  tmp38 = a[3][1] * tmp17 - a[3][2] * tmp20 + a[3][4] * tmp23 - a[3][5] * tmp24;
+  tmp39 = a[3][1] * tmp18 - a[3][2] * tmp21 + a[3][3] * tmp23 - a[3][5] * tmp25;
+  tmp40 = a[3][1] * tmp19 - a[3][2] * tmp22 + a[3][3] * tmp24 - a[3][4] * tmp25;
+  tmp41 = a[3][0] * tmp16 - a[3][3] * tmp26 + a[3][4] * tmp27 - a[3][5] * tmp28;
+  tmp42 = a[3][0] * tmp17 - a[3][2] * tmp26 + a[3][4] * tmp29 - a[3][5] * tmp30;
+  tmp43 = a[3][0] * tmp18 - a[3][2] * tmp27 + a[3][3] * tmp29 - a[3][5] * tmp31;
+  tmp44 = a[3][0] * tmp19 - a[3][2] * tmp28 + a[3][3] * tmp30 - a[3][4] * tmp31;
+
+  B[0][4] = -a[5][1] * tmp36 + a[5][2] * tmp37 - a[5][3] * tmp38 + a[5][4] * tmp39 - a[5][5] * tmp40;
+  B[0][5] = a[4][1] * tmp36 - a[4][2] * tmp37 + a[4][3] * tmp38 - a[4][4] * tmp39 + a[4][5] * tmp40;
+  B[1][4] = a[5][0] * tmp36 - a[5][2] * tmp41 + a[5][3] * tmp42 - a[5][4] * tmp43 + a[5][5] * tmp44;
+  B[1][5] = -a[4][0] * tmp36 + a[4][2] * tmp41 - a[4][3] * tmp42 + a[4][4] * tmp43 - a[4][5] * tmp44;
+
+  tmp45 = a[3][0] * tmp20 - a[3][1] * tmp26 + a[3][4] * tmp32 - a[3][5] * tmp33;
+  tmp46 = a[3][0] * tmp21 - a[3][1] * tmp27 + a[3][3] * tmp32 - a[3][5] * tmp34;
+  tmp47 = a[3][0] * tmp22 - a[3][1] * tmp28 + a[3][3] * tmp33 - a[3][4] * tmp34;
+  tmp48 = a[3][0] * tmp23 - a[3][1] * tmp29 + a[3][2] * tmp32 - a[3][5] * tmp35;
+  tmp49 = a[3][0] * tmp24 - a[3][1] * tmp30 + a[3][2] * tmp33 - a[3][4] * tmp35;
+
+  B[2][4] = -a[5][0] * tmp37 + a[5][1] * tmp41 - a[5][3] * tmp45 + a[5][4] * tmp46 - a[5][5] * tmp47;
+  B[2][5] = a[4][0] * tmp37 - a[4][1] * tmp41 + a[4][3] * tmp45 - a[4][4] * tmp46 + a[4][5] * tmp47;
+  B[3][4] = a[5][0] * tmp38 - a[5][1] * tmp42 + a[5][2] * tmp45 - a[5][4] * tmp48 + a[5][5] * tmp49;
+  B[3][5] = -a[4][0] * tmp38 + a[4][1] * tmp42 - a[4][2] * tmp45 + a[4][4] * tmp48 - a[4][5] * tmp49;
+
+  tmp50 = a[3][0] * tmp25 - a[3][1] * tmp31 + a[3][2] * tmp34 - a[3][3] * tmp35;
+
+  B[4][4] = -a[5][0] * tmp39 + a[5][1] * tmp43 - a[5][2] * tmp46 + a[5][3] * tmp48 - a[5][5] * tmp50;
+  B[4][5] = a[4][0] * tmp39 - a[4][1] * tmp43 + a[4][2] * tmp46 - a[4][3] * tmp48 + a[4][5] * tmp50;
+  B[5][4] = a[5][0] * tmp40 - a[5][1] * tmp44 + a[5][2] * tmp47 - a[5][3] * tmp49 + a[5][4] * tmp50;
+  B[5][5] = -a[4][0] * tmp40 + a[4][1] * tmp44 - a[4][2] * tmp47 + a[4][3] * tmp49 - a[4][4] * tmp50;
+
+  tmp36 = a[4][2] * tmp16 - a[4][3] * tmp17 + a[4][4] * tmp18 - a[4][5] * tmp19;
+  tmp37 = a[4][1] * tmp16 - a[4][3] * tmp20 + a[4][4] * tmp21 - a[4][5] * tmp22;
+  tmp38 = a[4][1] * tmp17 - a[4][2] * tmp20 + a[4][4] * tmp23 - a[4][5] * tmp24;
+  tmp39 = a[4][1] * tmp18 - a[4][2] * tmp21 + a[4][3] * tmp23 - a[4][5] * tmp25;
+  tmp40 = a[4][1] * tmp19 - a[4][2] * tmp22 + a[4][3] * tmp24 - a[4][4] * tmp25;
+  tmp41 = a[4][0] * tmp16 - a[4][3] * tmp26 + a[4][4] * tmp27 - a[4][5] * tmp28;
+  tmp42 = a[4][0] * tmp17 - a[4][2] * tmp26 + a[4][4] * tmp29 - a[4][5] * tmp30;
+  tmp43 = a[4][0] * tmp18 - a[4][2] * tmp27 + a[4][3] * tmp29 - a[4][5] * tmp31;
+  tmp44 = a[4][0] * tmp19 - a[4][2] * tmp28 + a[4][3] * tmp30 - a[4][4] * tmp31;
+  tmp45 = a[4][0] * tmp20 - a[4][1] * tmp26 + a[4][4] * tmp32 - a[4][5] * tmp33;
+  tmp46 = a[4][0] * tmp21 - a[4][1] * tmp27 + a[4][3] * tmp32 - a[4][5] * tmp34;
+  tmp47 = a[4][0] * tmp22 - a[4][1] * tmp28 + a[4][3] * tmp33 - a[4][4] * tmp34;
+  tmp48 = a[4][0] * tmp23 - a[4][1] * tmp29 + a[4][2] * tmp32 - a[4][5] * tmp35;
+  tmp49 = a[4][0] * tmp24 - a[4][1] * tmp30 + a[4][2] * tmp33 - a[4][4] * tmp35;
+  tmp50 = a[4][0] * tmp25 - a[4][1] * tmp31 + a[4][2] * tmp34 - a[4][3] * tmp35;
+
+  B[0][3] = a[5][1] * tmp36 - a[5][2] * tmp37 + a[5][3] * tmp38 - a[5][4] * tmp39 + a[5][5] * tmp40;
+  B[1][3] = -a[5][0] * tmp36 + a[5][2] * tmp41 - a[5][3] * tmp42 + a[5][4] * tmp43 - a[5][5] * tmp44;
+  B[2][3] = a[5][0] * tmp37 - a[5][1] * tmp41 + a[5][3] * tmp45 - a[5][4] * tmp46 + a[5][5] * tmp47;
+  B[3][3] = -a[5][0] * tmp38 + a[5][1] * tmp42 - a[5][2] * tmp45 + a[5][4] * tmp48 - a[5][5] * tmp49;
+  B[4][3] = a[5][0] * tmp39 - a[5][1] * tmp43 + a[5][2] * tmp46 - a[5][3] * tmp48 + a[5][5] * tmp50;
+  B[5][3] = -a[5][0] * tmp40 + a[5][1] * tmp44 - a[5][2] * tmp47 + a[5][3] * tmp49 - a[5][4] * tmp50;
+
+  const ET det(a[0][0] * B[0][0] + a[0][1] * B[1][0] + a[0][2] * B[2][0] +
+    a[0][3] * B[3][0] + a[0][4] * B[4][0] + a[0][5] * B[5][0]);
+
+  CplxDivByDet<6>(B, det);
+  return det;
 }
 
-inline std::complex<double> DetCplx6x6(std::complex<double>** A)
+template <typename MT1, typename MT2>
+inline void InvertCplx6x6(MT1 A, MT2 B)
 {
+  InvertAndDetCplx6x6(A, B);
+}
 
-  std::complex<double> tmp1(A[4][4] * A[5][5] - A[4][5] * A[5][4]);
-  std::complex<double> tmp2(A[4][3] * A[5][5] - A[4][5] * A[5][3]);
-  std::complex<double> tmp3(A[4][3] * A[5][4] - A[4][4] * A[5][3]);
-  std::complex<double> tmp4(A[4][2] * A[5][5] - A[4][5] * A[5][2]);
-  std::complex<double> tmp5(A[4][2] * A[5][4] - A[4][4] * A[5][2]);
-  std::complex<double> tmp6(A[4][2] * A[5][3] - A[4][3] * A[5][2]);
-  std::complex<double> tmp7(A[4][1] * A[5][5] - A[4][5] * A[5][1]);
-  std::complex<double> tmp8(A[4][1] * A[5][4] - A[4][4] * A[5][1]);
-  std::complex<double> tmp9(A[4][1] * A[5][3] - A[4][3] * A[5][1]);
-  std::complex<double> tmp10(A[4][1] * A[5][2] - A[4][2] * A[5][1]);
-  std::complex<double> tmp11(A[4][0] * A[5][5] - A[4][5] * A[5][0]);
-  std::complex<double> tmp12(A[4][0] * A[5][4] - A[4][4] * A[5][0]);
-  std::complex<double> tmp13(A[4][0] * A[5][3] - A[4][3] * A[5][0]);
-  std::complex<double> tmp14(A[4][0] * A[5][2] - A[4][2] * A[5][0]);
-  std::complex<double> tmp15(A[4][0] * A[5][1] - A[4][1] * A[5][0]);
-
-  std::complex<double> tmp16(A[3][3] * tmp1 - A[3][4] * tmp2 + A[3][5] * tmp3);
-  std::complex<double> tmp17(A[3][2] * tmp1 - A[3][4] * tmp4 + A[3][5] * tmp5);
-  std::complex<double> tmp18(A[3][2] * tmp2 - A[3][3] * tmp4 + A[3][5] * tmp6);
-  std::complex<double> tmp19(A[3][2] * tmp3 - A[3][3] * tmp5 + A[3][4] * tmp6);
-  std::complex<double> tmp20(A[3][1] * tmp1 - A[3][4] * tmp7 + A[3][5] * tmp8);
-  std::complex<double> tmp21(A[3][1] * tmp2 - A[3][3] * tmp7 + A[3][5] * tmp9);
-  std::complex<double> tmp22(A[3][1] * tmp3 - A[3][3] * tmp8 + A[3][4] * tmp9);
-  std::complex<double> tmp23(A[3][1] * tmp4 - A[3][2] * tmp7 + A[3][5] * tmp10);
-  std::complex<double> tmp24(A[3][1] * tmp5 - A[3][2] * tmp8 + A[3][4] * tmp10);
-  std::complex<double> tmp25(A[3][1] * tmp6 - A[3][2] * tmp9 + A[3][3] * tmp10);
-  std::complex<double> tmp26(A[3][0] * tmp1 - A[3][4] * tmp11 + A[3][5] * tmp12);
-  std::complex<double> tmp27(A[3][0] * tmp2 - A[3][3] * tmp11 + A[3][5] * tmp13);
-  std::complex<double> tmp28(A[3][0] * tmp3 - A[3][3] * tmp12 + A[3][4] * tmp13);
-  std::complex<double> tmp29(A[3][0] * tmp4 - A[3][2] * tmp11 + A[3][5] * tmp14);
-  std::complex<double> tmp30(A[3][0] * tmp5 - A[3][2] * tmp12 + A[3][4] * tmp14);
-  std::complex<double> tmp31(A[3][0] * tmp6 - A[3][2] * tmp13 + A[3][3] * tmp14);
-  std::complex<double> tmp32(A[3][0] * tmp7 - A[3][1] * tmp11 + A[3][5] * tmp15);
-  std::complex<double> tmp33(A[3][0] * tmp8 - A[3][1] * tmp12 + A[3][4] * tmp15);
-  std::complex<double> tmp34(A[3][0] * tmp9 - A[3][1] * tmp13 + A[3][3] * tmp15);
-  std::complex<double> tmp35(A[3][0] * tmp10 - A[3][1] * tmp14 + A[3][2] * tmp15);
-
-  std::complex<double> tmp36(A[2][2] * tmp16 - A[2][3] * tmp17 + A[2][4] * tmp18 - A[2][5] * tmp19);
-  std::complex<double> tmp37(A[2][1] * tmp16 - A[2][3] * tmp20 + A[2][4] * tmp21 - A[2][5] * tmp22);
-  std::complex<double> tmp38(A[2][1] * tmp17 - A[2][2] * tmp20 + A[2][4] * tmp23 - A[2][5] * tmp24);
-  std::complex<double> tmp39(A[2][1] * tmp18 - A[2][2] * tmp21 + A[2][3] * tmp23 - A[2][5] * tmp25);
-  std::complex<double> tmp40(A[2][1] * tmp19 - A[2][2] * tmp22 + A[2][3] * tmp24 - A[2][4] * tmp25);
-  std::complex<double> tmp41(A[2][0] * tmp16 - A[2][3] * tmp26 + A[2][4] * tmp27 - A[2][5] * tmp28);
-  std::complex<double> tmp42(A[2][0] * tmp17 - A[2][2] * tmp26 + A[2][4] * tmp29 - A[2][5] * tmp30);
-  std::complex<double> tmp43(A[2][0] * tmp18 - A[2][2] * tmp27 + A[2][3] * tmp29 - A[2][5] * tmp31);
-  std::complex<double> tmp44(A[2][0] * tmp19 - A[2][2] * tmp28 + A[2][3] * tmp30 - A[2][4] * tmp31);
-
-  std::complex<double>b0 = A[1][1] * tmp36 - A[1][2] * tmp37 + A[1][3] * tmp38 - A[1][4] * tmp39 + A[1][5] * tmp40;
-  std::complex<double>b1 = -A[1][0] * tmp36 + A[1][2] * tmp41 - A[1][3] * tmp42 + A[1][4] * tmp43 - A[1][5] * tmp44;
-
-  std::complex<double> tmp45(A[2][0] * tmp20 - A[2][1] * tmp26 + A[2][4] * tmp32 - A[2][5] * tmp33);
-  std::complex<double> tmp46(A[2][0] * tmp21 - A[2][1] * tmp27 + A[2][3] * tmp32 - A[2][5] * tmp34);
-  std::complex<double> tmp47(A[2][0] * tmp22 - A[2][1] * tmp28 + A[2][3] * tmp33 - A[2][4] * tmp34);
-  std::complex<double> tmp48(A[2][0] * tmp23 - A[2][1] * tmp29 + A[2][2] * tmp32 - A[2][5] * tmp35);
-  std::complex<double> tmp49(A[2][0] * tmp24 - A[2][1] * tmp30 + A[2][2] * tmp33 - A[2][4] * tmp35);
-
-  std::complex<double>b2 = A[1][0] * tmp37 - A[1][1] * tmp41 + A[1][3] * tmp45 - A[1][4] * tmp46 + A[1][5] * tmp47;
-  std::complex<double>b3 = -A[1][0] * tmp38 + A[1][1] * tmp42 - A[1][2] * tmp45 + A[1][4] * tmp48 - A[1][5] * tmp49;
-  std::complex<double> tmp50(A[2][0] * tmp25 - A[2][1] * tmp31 + A[2][2] * tmp34 - A[2][3] * tmp35);
-
-  std::complex<double>b4 = A[1][0] * tmp39 - A[1][1] * tmp43 + A[1][2] * tmp46 - A[1][3] * tmp48 + A[1][5] * tmp50;
-  std::complex<double>b5 = -A[1][0] * tmp40 + A[1][1] * tmp44 - A[1][2] * tmp47 + A[1][3] * tmp49 - A[1][4] * tmp50;
-
-  std::complex<double> det(A[0][0] * b0 + A[0][1] * b1 + A[0][2] * b2 + A[0][3] * b3 + A[0][4] * b4 + A[0][5] * b5);
+template <typename MT>
+inline typename CplxElementOf<MT>::Type DetCplx6x6(MT A)
+{
+  typedef typename CplxElementOf<MT>::Type ET;
+
+  ET tmp1(A[4][4] * A[5][5] - A[4][5] * A[5][4]);
+  ET tmp2(A[4][3] * A[5][5] - A[4][5] * A[5][3]);
+  ET tmp3(A[4][3] * A[5][4] - A[4][4] * A[5][3]);
+  ET tmp4(A[4][2] * A[5][5] - A[4][5] * A[5][2]);
+  ET tmp5(A[4][2] * A[5][4] - A[4][4] * A[5][2]);
+  ET tmp6(A[4][2] * A[5][3] - A[4][3] * A[5][2]);
+  ET tmp7(A[4][1] * A[5][5] - A[4][5] * A[5][1]);
+  ET tmp8(A[4][1] * A[5][4] - A[4][4] * A[5][1]);
+  ET tmp9(A[4][1] * A[5][3] - A[4][3] * A[5][1]);
+  ET tmp10(A[4][1] * A[5][2] - A[4][2] * A[5][1]);
+  ET tmp11(A[4][0] * A[5][5] - A[4][5] * A[5][0]);
+  ET tmp12(A[4][0] * A[5][4] - A[4][4] * A[5][0]);
+  ET tmp13(A[4][0] * A[5][3] - A[4][3] * A[5][0]);
+  ET tmp14(A[4][0] * A[5][2] - A[4][2] * A[5][0]);
+  ET tmp15(A[4][0] * A[5][1] - A[4][1] * A[5][0]);
+
+  ET tmp16(A[3][3] * tmp1 - A[3][4] * tmp2 + A[3][5] * tmp3);
+  ET tmp17(A[3][2] * tmp1 - A[3][4] * tmp4 + A[3][5] * tmp5);
+  ET tmp18(A[3][2] * tmp2 - A[3][3] * tmp4 + A[3][5] * tmp6);
+  ET tmp19(A[3][2] * tmp3 - A[3][3] * tmp5 + A[3][4] * tmp6);
+  ET tmp20(A[3][1] * tmp1 - A[3][4] * tmp7 + A[3][5] * tmp8);
+  ET tmp21(A[3][1] * tmp2 - A[3][3] * tmp7 + A[3][5] * tmp9);
+  ET tmp22(A[3][1] * tmp3 - A[3][3] * tmp8 + A[3][4] * tmp9);
+  ET tmp23(A[3][1] * tmp4 - A[3][2] * tmp7 + A[3][5] * tmp10);
+  ET tmp24(A[3][1] * tmp5 - A[3][2] * tmp8 + A[3][4] * tmp10);
+  ET tmp25(A[3][1] * tmp6 - A[3][2] * tmp9 + A[3][3] * tmp10);
+  ET tmp26(A[3][0] * tmp1 - A[3][4] * tmp11 + A[3][5] * tmp12);
+  ET tmp27(A[3][0] * tmp2 - A[3][3] * tmp11 + A[3][5] * tmp13);
+  ET tmp28(A[3][0] * tmp3 - A[3][3] * tmp12 + A[3][4] * tmp13);
+  ET tmp29(A[3][0] * tmp4 - A[3][2] * tmp11 + A[3][5] * tmp14);
+  ET tmp30(A[3][0] * tmp5 - A[3][2] * tmp12 + A[3][4] * tmp14);
+  ET tmp31(A[3][0] * tmp6 - A[3][2] * tmp13 + A[3][3] * tmp14);
+  ET tmp32(A[3][0] * tmp7 - A[3][1] * tmp11 + A[3][5] * tmp15);
+  ET tmp33(A[3][0] * tmp8 - A[3][1] * tmp12 + A[3][4] * tmp15);
+  ET tmp34(A[3][0] * tmp9 - A[3][1] * tmp13 + A[3][3] * tmp15);
+  ET tmp35(A[3][0] * tmp10 - A[3][1] * tmp14 + A[3][2] * tmp15);
+
+  ET tmp36(A[2][2] * tmp16 - A[2][3] * tmp17 + A[2][4] * tmp18 - A[2][5] * tmp19);
+  ET tmp37(A[2][1] * tmp16 - A[2][3] * tmp20 + A[2][4] * tmp21 - A[2][5] * tmp22);
+  ET tmp38(A[2][1] * tmp17 - A[2][2] * tmp20 + A[2][4] * tmp23 - A[2][5] * tmp24);
+  ET tmp39(A[2][1] * tmp18 - A[2][2] * tmp21 + A[2][3] * tmp23 - A[2][5] * tmp25);
+  ET tmp40(A[2][1] * tmp19 - A[2][2] * tmp22 + A[2][3] * tmp24 - A[2][4] * tmp25);
+  ET tmp41(A[2][0] * tmp16 - A[2][3] * tmp26 + A[2][4] * tmp27 - A[2][5] * tmp28);
+  ET tmp42(A[2][0] * tmp17 - A[2][2] * tmp26 + A[2][4] * tmp29 - A[2][5] * tmp30);
+  ET tmp43(A[2][0] * tmp18 - A[2][2] * tmp27 + A[2][3] * tmp29 - A[2][5] * tmp31);
+  ET tmp44(A[2][0] * tmp19 - A[2][2] * tmp28 + A[2][3] * tmp30 - A[2][4] * tmp31);
+
+  ET b0 = A[1][1] * tmp36 - A[1][2] * tmp37 + A[1][3] * tmp38 - A[1][4] * tmp39 + A[1][5] * tmp40;
+  ET b1 = -A[1][0] * tmp36 + A[1][2] * tmp41 - A[1][3] * tmp42 + A[1][4] * tmp43 - A[1][5] * tmp44;
+
+  ET tmp45(A[2][0] * tmp20 - A[2][1] * tmp26 + A[2][4] * tmp32 - A[2][5] * tmp33);
+  ET tmp46(A[2][0] * tmp21 - A[2][1] * tmp27 + A[2][3] * tmp32 - A[2][5] * tmp34);
+  ET tmp47(A[2][0] * tmp22 - A[2][1] * tmp28 + A[2][3] * tmp33 - A[2][4] * tmp34);
+  ET tmp48(A[2][0] * tmp23 - A[2][1] * tmp29 + A[2][2] * tmp32 - A[2][5] * tmp35);
+  ET tmp49(A[2][0] * tmp24 - A[2][1] * tmp30 + A[2][2] * tmp33 - A[2][4] * tmp35);
+
+  ET b2 = A[1][0] * tmp37 - A[1][1] * tmp41 + A[1][3] * tmp45 - A[1][4] * tmp46 + A[1][5] * tmp47;
+  ET b3 = -A[1][0] * tmp38 + A[1][1] * tmp42 - A[1][2] * tmp45 + A[1][4] * tmp48 - A[1][5] * tmp49;
+  ET tmp50(A[2][0] * tmp25 - A[2][1] * tmp31 + A[2][2] * tmp34 - A[2][3] * tmp35);
+
+  ET b4 = A[1][0] * tmp39 - A[1][1] * tmp43 + A[1][2] * tmp46 - A[1][3] * tmp48 + A[1][5] * tmp50;
+  ET b5 = -A[1][0] * tmp40 + A[1][1] * tmp44 - A[1][2] * tmp47 + A[1][3] * tmp49 - A[1][4] * tmp50;
+
+  ET det(A[0][0] * b0 + A[0][1] * b1 + A[0][2] * b2 + A[0][3] * b3 + A[0][4] * b4 + A[0][5] * b5);
   return det;
 
 }
 
-inline std::complex<double> DetCplx(std::complex<double>** mat, int dim) {
+/*
+Compile-time sized kernels : InvertCplx<N>(A, B) and DetCplx<N>(A) on any accessor the fixed-size
+kernels accept. 1..6 map onto the hand-written expansions above; any other N gets a Gauss-Jordan
+elimination with partial pivoting on a local N x N copy, whose loops the compiler unrolls for the
+given N. Pivots are chosen by |re| + |im|, which does not overflow. The result always goes to B;
+if a column has no nonzero pivot, det is 0 and B is filled with NaN, as the cofactor kernels'
+division by a zero det leaves it, so the finiteness checks downstream see the failure.
+*/
+template <int N>
+struct CplxFixed {
+  template <typename MT1, typename MT2>
+  static void Invert(MT1 A, MT2 B) {
+    InvertAndDet(A, B);
+  }
+
+  // det(A) is the signed product of the Gauss-Jordan pivots.
+  template <typename MT1, typename MT2>
+  static typename CplxElementOf<MT1>::Type InvertAndDet(MT1 A, MT2 B) {
+    typedef typename CplxElementOf<MT1>::Type ET;
+    typedef typename ET::value_type T;
+    ET a[N][N];
+    int p[N];
+    ET det(1.0);
+
+    for (int i = 0; i < N; i++)
+      for (int j = 0; j < N; j++)
+        a[i][j] = A[i][j];
+
+    for (int k = 0; k < N; k++) {
+      int piv = k;
+      T big = std::abs(a[k][k].real()) + std::abs(a[k][k].imag());
+      for (int i = k + 1; i < N; i++) {
+        const T m = std::abs(a[i][k].real()) + std::abs(a[i][k].imag());
+        if (m > big) {
+          big = m;
+          piv = i;
+        }
+      }
+      if (big == T(0)) {
+        const T nan = std::numeric_limits<T>::quiet_NaN();
+        for (int i = 0; i < N; i++)
+          for (int j = 0; j < N; j++)
+            B[i][j] = ET(nan, nan);
+        return ET(0.0);
+      }
+      p[k] = piv;
+      if (piv != k) {
+        for (int j = 0; j < N; j++)
+          std::swap(a[k][j], a[piv][j]);
+        det = -det;
+      }
+      det *= a[k][k];
+
+      const ET ipiv(ET(1.0) / a[k][k]);
+      a[k][k] = ET(1.0);
+      for (int j = 0; j < N; j++)
+        a[k][j] *= ipiv;
+
+      for (int i = 0; i < N; i++) {
+        if (i == k)
+          continue;
+        const ET f(a[i][k]);
+        a[i][k] = ET(0.0);
+        for (int j = 0; j < N; j++)
+          a[i][j] -= f * a[k][j];
+      }
+    }
+
+    // row interchanges of A are column interchanges of inv(A)
+    for (int k = N - 1; k >= 0; k--)
+      if (p[k] != k)
+        for (int i = 0; i < N; i++)
+          std::swap(a[i][k], a[i][p[k]]);
+
+    for (int i = 0; i < N; i++)
+      for (int j = 0; j < N; j++)
+        B[i][j] = a[i][j];
+    return det;
+  }
+
+  template <typename MT>
+  static typename CplxElementOf<MT>::Type Det(MT A) {
+    typedef typename CplxElementOf<MT>::Type ET;
+    typedef typename ET::value_type T;
+    ET a[N][N];
+
+    for (int i = 0; i < N; i++)
+      for (int j = 0; j < N; j++)
+        a[i][j] = A[i][j];
+
+    ET det(1.0);
+    for (int k = 0; k < N; k++) {
+      int piv = k;
+      T big = std::abs(a[k][k].real()) + std::abs(a[k][k].imag());
+      for (int i = k + 1; i < N; i++) {
+        const T m = std::abs(a[i][k].real()) + std::abs(a[i][k].imag());
+        if (m > big) {
+          big = m;
+          piv = i;
+        }
+      }
+      if (big == T(0))
+        return ET(0.0);
+      if (piv != k) {
+        for (int j = k; j < N; j++)
+          std::swap(a[k][j], a[piv][j]);
+        det = -det;
+      }
+      det *= a[k][k];
+
+      const ET ipiv(ET(1.0) / a[k][k]);
+      for (int i = k + 1; i < N; i++) {
+        const ET f(a[i][k] * ipiv);
+        for (int j = k + 1; j < N; j++)
+          a[i][j] -= f * a[k][j];
+      }
+    }
+    return det;
+  }
+};
+
+template <> struct CplxFixed<1> {
+  template <typename MT1, typename MT2> static void Invert(MT1 A, MT2 B) { InvertCplx1x1(A, B); }
+  template <typename MT1, typename MT2> static typename CplxElementOf<MT1>::Type InvertAndDet(MT1 A, MT2 B) {
+    return InvertAndDetCplx1x1(A, B);
+  }
+  template <typename MT> static typename CplxElementOf<MT>::Type Det(MT A) { return DetCplx1x1(A); }
+};
+
+template <> struct CplxFixed<2> {
+  template <typename MT1, typename MT2> static void Invert(MT1 A, MT2 B) { InvertCplx2x2(A, B); }
+  template <typename MT1, typename MT2> static typename CplxElementOf<MT1>::Type InvertAndDet(MT1 A, MT2 B) {
+    return InvertAndDetCplx2x2(A, B);
+  }
+  template <typename MT> static typename CplxElementOf<MT>::Type Det(MT A) { return DetCplx2x2(A); }
+};
+
+template <> struct CplxFixed<3> {
+  template <typename MT1, typename MT2> static void Invert(MT1 A, MT2 B) { InvertCplx3x3(A, B); }
+  template <typename MT1, typename MT2> static typename CplxElementOf<MT1>::Type InvertAndDet(MT1 A, MT2 B) {
+    return InvertAndDetCplx3x3(A, B);
+  }
+  template <typename MT> static typename CplxElementOf<MT>::Type Det(MT A) { return DetCplx3x3(A); }
+};
+
+template <> struct CplxFixed<4> {
+  template <typename MT1, typename MT2> static void Invert(MT1 A, MT2 B) { InvertCplx4x4(A, B); }
+  template <typename MT1, typename MT2> static typename CplxElementOf<MT1>::Type InvertAndDet(MT1 A, MT2 B) {
+    return InvertAndDetCplx4x4(A, B);
+  }
+  template <typename MT> static typename CplxElementOf<MT>::Type Det(MT A) { return DetCplx4x4(A); }
+};
+
+template <> struct CplxFixed<5> {
+  template <typename MT1, typename MT2> static void Invert(MT1 A, MT2 B) { InvertCplx5x5(A, B); }
+  template <typename MT1, typename MT2> static typename CplxElementOf<MT1>::Type InvertAndDet(MT1 A, MT2 B) {
+    return InvertAndDetCplx5x5(A, B);
+  }
+  template <typename MT> static typename CplxElementOf<MT>::Type Det(MT A) { return DetCplx5x5(A); }
+};
+
+template <> struct CplxFixed<6> {
+  template <typename MT1, typename MT2> static void Invert(MT1 A, MT2 B) { InvertCplx6x6(A, B); }
+  template <typename MT1, typename MT2> static typename CplxElementOf<MT1>::Type InvertAndDet(MT1 A, MT2 B) {
+    return InvertAndDetCplx6x6(A, B);
+  }
+  template <typename MT> static typename CplxElementOf<MT>::Type Det(MT A) { return DetCplx6x6(A); }
+};
+
+template <int N, typename MT1, typename MT2>
+inline void InvertCplx(MT1 A, MT2 B) {
+  CplxFixed<N>::Invert(A, B);
+}
+
+template <int N, typename MT>
+inline typename CplxElementOf<MT>::Type DetCplx(MT A) {
+  return CplxFixed<N>::Det(A);
+}
+
+template <int N, typename MT1, typename MT2>
+inline typename CplxElementOf<MT1>::Type InvertAndDetCplx(MT1 A, MT2 B) {
+  return CplxFixed<N>::InvertAndDet(A, B);
+}
+
+/*
+r = a * b + c, in one rounding where the target has a fused multiply-add (std::fma is a library
+call otherwise). The result is written through r, as GCC vector types for V are not returned by value.
+*/
+template <typename V>
+inline void CplxFma(V& r, const V& a, const V& b, const V& c) {
+  r = a * b + c;
+}
+
+#ifdef FP_FAST_FMA
+inline void CplxFma(double& r, const double& a, const double& b, const double& c) {
+  r = std::fma(a, b, c);
+}
+#endif
+
+#ifdef FP_FAST_FMAF
+inline void CplxFma(float& r, const float& a, const float& b, const float& c) {
+  r = std::fma(a, b, c);
+}
+#endif
+
+/*
+Complex element with plain arithmetic, V a real scalar or a W-lane vector (see inversion_simd.h).
+Products expand to real multiply-adds, without the inf/NaN recovery std::complex does in __muldc3.
+Division is a * conj(b) / |b|^2 with b first scaled by 1 / max(|b.re|, |b.im|), so |b|^2 neither
+overflows nor underflows for any finite b (a 1e200 determinant still gives a 1e-200 reciprocal).
+*/
+template <typename V>
+struct CplxPack {
+  V re, im;
+
+  CplxPack() {}
+  CplxPack(double r) : re(r + V()), im(V()) {}
+  CplxPack(const V& r, const V& i) : re(r), im(i) {}
+
+  CplxPack& operator+=(const CplxPack& b) { re += b.re; im += b.im; return *this; }
+  CplxPack& operator-=(const CplxPack& b) { re -= b.re; im -= b.im; return *this; }
+  CplxPack& operator*=(const CplxPack& b) { *this = *this * b; return *this; }
+  CplxPack& operator/=(const CplxPack& b) { *this = *this / b; return *this; }
+
+  friend CplxPack operator-(const CplxPack& a) { return CplxPack(-a.re, -a.im); }
+  friend CplxPack operator+(const CplxPack& a, const CplxPack& b) { return CplxPack(a.re + b.re, a.im + b.im); }
+  friend CplxPack operator-(const CplxPack& a, const CplxPack& b) { return CplxPack(a.re - b.re, a.im - b.im); }
+  friend CplxPack operator*(const CplxPack& a, const CplxPack& b) {
+    CplxPack r;
+    CplxFma(r.re, a.re, b.re, V(-(a.im * b.im)));
+    CplxFma(r.im, a.re, b.im, V(a.im * b.re));
+    return r;
+  }
+  friend CplxPack operator/(const CplxPack& a, const CplxPack& b) {
+    const V zero = V();
+    const V ar = b.re < zero ? V(-b.re) : b.re, ai = b.im < zero ? V(-b.im) : b.im;
+    const V k = 1.0 / (ar > ai ? ar : ai);
+    const V br = b.re * k, bi = b.im * k;
+    V d, s;
+    CplxFma(d, br, br, V(bi * bi));
+    s = k / d;
+    CplxPack r;
+    CplxFma(r.re, a.re, br, V(a.im * bi));
+    CplxFma(r.im, a.im, br, V(-(a.re * bi)));
+    r.re *= s;
+    r.im *= s;
+    return r;
+  }
+};
+
+template <int K, typename MT, typename V>
+inline void CplxDivByDet(MT B, const CplxPack<V>& det) {
+  const CplxPack<V> idet(CplxPack<V>(1.0) / det);
+  for (int i = 0; i < K; i++)
+    for (int j = 0; j < K; j++)
+      B[i][j] *= idet;
+}
+
+/*
+InvertCplxFast<N> / InvertAndDetCplxFast<N> / DetCplxFast<N>, N = 1..6 : the cofactor kernels above
+run on CplxPack<T> instead of std::complex<T>. A non-finite result (singular A, inf or NaN in A,
+or an overflow of the unscaled arithmetic) is caught by one check at the end, and only then is the
+matrix redone with the std::complex kernel, so results match InvertCplx<N> up to rounding.
+*/
+template <int N, typename MT1, typename MT2>
+inline typename CplxElementOf<MT1>::Type InvertAndDetCplxFast(MT1 A, MT2 B) {
+  static_assert(N >= 1 && N <= 6, "the fast kernels cover 1x1 - 6x6");
+  typedef typename CplxElementOf<MT1>::Type ET;
+  typedef typename ET::value_type T;
+  CplxPack<T> a[N][N], b[N][N];
+
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++)
+      a[i][j] = CplxPack<T>(A[i][j].real(), A[i][j].imag());
+
+  const CplxPack<T> det = InvertAndDetCplx<N>(a, b);
+
+  // x - x is 0 for finite x and NaN for inf / NaN
+  T check = (det.re - det.re) + (det.im - det.im);
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++)
+      check += (b[i][j].re - b[i][j].re) + (b[i][j].im - b[i][j].im);
+  if (check != T(0))
+    return InvertAndDetCplx<N>(A, B);
+
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++)
+      B[i][j] = ET(b[i][j].re, b[i][j].im);
+  return ET(det.re, det.im);
+}
+
+template <int N, typename MT1, typename MT2>
+inline void InvertCplxFast(MT1 A, MT2 B) {
+  InvertAndDetCplxFast<N>(A, B);
+}
+
+template <int N, typename MT>
+inline typename CplxElementOf<MT>::Type DetCplxFast(MT A) {
+  static_assert(N >= 1 && N <= 6, "the fast kernels cover 1x1 - 6x6");
+  typedef typename CplxElementOf<MT>::Type ET;
+  typedef typename ET::value_type T;
+  CplxPack<T> a[N][N];
+
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++)
+      a[i][j] = CplxPack<T>(A[i][j].real(), A[i][j].imag());
+
+  const CplxPack<T> det = DetCplx<N>(a);
+  if ((det.re - det.re) + (det.im - det.im) != T(0))
+    return DetCplx<N>(A);
+  return ET(det.re, det.im);
+}
+
+template <typename T>
+inline std::complex<T> DetCplx(std::complex<T>** mat, int dim, CplxInvWorkspaceT<T>& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_DET, dim, dim <= 8 ? CPLX_PATH_FIXED : CPLX_PATH_LAPACK, 1);
   switch (dim) {
   case 1: return DetCplx1x1(mat);
     break;
@@ -656,12 +1503,29 @@ inline std::complex<double> DetCplx(std::complex<double>** mat, int dim) {
     break;
   case 6:return DetCplx6x6(mat);
     break;
-  default:return DetCplxNxN(mat, dim);
+  case 7:return DetCplx<7>(mat);
+    break;
+  case 8:return DetCplx<8>(mat);
+    break;
+  default:return DetCplxNxN(mat, dim, ws);
     break;
   }
 }
 
-inline std::complex<double> InvertCplx(std::complex<double>** A, std::complex<double>** B, int dim) {
+template <typename T>
+inline std::complex<T> DetCplx(std::complex<T>** mat, int dim) {
+  CplxInvWorkspaceT<T> ws;
+  return DetCplx(mat, dim, ws);
+}
+
+/*
+The result goes to B for every size. B may be A itself (in place); with equally spaced rows
+the LAPACK path (dim > INVERSION_CPLX_NATIVE_MAX) then runs without copying the matrix.
+Otherwise A and B must not overlap.
+*/
+template <typename T>
+inline void InvertCplx(std::complex<T>** A, std::complex<T>** B, int dim, CplxInvWorkspaceT<T>& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_INVERT, dim, CplxStatsInvertPath(dim, INVERSION_CPLX_NATIVE_MAX), 1);
   switch (dim) {
   case 1: InvertCplx1x1(A, B);
     break;
@@ -675,10 +1539,1453 @@ inline std::complex<double> InvertCplx(std::complex<double>** A, std::complex<do
     break;
   case 6:InvertCplx6x6(A, B);
     break;
-  default:InvertCplxNxN(A, B, dim);
+  case 7:InvertCplx<7>(A, B);
+    break;
+  case 8:InvertCplx<8>(A, B);
+    break;
+  default:
+    if (dim <= INVERSION_CPLX_NATIVE_MAX) {
+      if (InvertCplxNative(A, B, dim, ws))
+        INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    }
+    else if (InvertCplxNxN(A, B, dim, ws))
+      INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    break;
+  }
+}
+
+template <typename T>
+inline void InvertCplx(std::complex<T>** A, std::complex<T>** B, int dim) {
+  CplxInvWorkspaceT<T> ws;
+  InvertCplx(A, B, dim, ws);
+}
+
+/*
+InvertCplx that also returns det(A), taken from the same computation : the cofactors of the
+fixed-size kernels, the Gauss-Jordan pivots or the LAPACK LU. Same aliasing rules as InvertCplx.
+A singular A returns 0, and B is not meaningful then.
+*/
+template <typename T>
+inline std::complex<T> InvertAndDetCplx(std::complex<T>** A, std::complex<T>** B, int dim, CplxInvWorkspaceT<T>& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_INVERT, dim, CplxStatsInvertPath(dim, INVERSION_CPLX_NATIVE_MAX), 1);
+  std::complex<T> det;
+  switch (dim) {
+  case 1: return InvertAndDetCplx1x1(A, B);
+  case 2: return InvertAndDetCplx2x2(A, B);
+  case 3: return InvertAndDetCplx3x3(A, B);
+  case 4: return InvertAndDetCplx4x4(A, B);
+  case 5: return InvertAndDetCplx5x5(A, B);
+  case 6: return InvertAndDetCplx6x6(A, B);
+  case 7: return InvertAndDetCplx<7>(A, B);
+  case 8: return InvertAndDetCplx<8>(A, B);
+  default:
+    if (dim <= INVERSION_CPLX_NATIVE_MAX) {
+      if (InvertCplxNative(A, B, dim, ws, &det))
+        INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    }
+    else if (InvertCplxNxN(A, B, dim, ws, &det))
+      INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    return det;
+  }
+}
+
+template <typename T>
+inline std::complex<T> InvertAndDetCplx(std::complex<T>** A, std::complex<T>** B, int dim) {
+  CplxInvWorkspaceT<T> ws;
+  return InvertAndDetCplx(A, B, dim, ws);
+}
+
+/*
+View overloads, templated on the view element so that const / non-const views of
+std::complex<double> and std::complex<float> are all accepted; the workspace precision must match.
+*/
+template <typename ET>
+inline std::complex<typename CplxRealOf<ET>::Type> DetCplxNxN(CplxMatrixViewT<ET> A,
+  CplxInvWorkspaceT<typename CplxRealOf<ET>::Type>& ws) {
+  typedef typename CplxRealOf<ET>::Type T;
+  const int n = A.rows;
+  ws.Reserve(n);
+  std::complex<T>* tmat = ws.Matrix();
+
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      tmat[i + j * n] = A(i, j);
+
+  CplxLapack<T>::Getrf(n, tmat, ws.Pivot());
+  return DetCplxFromLU(tmat, ws.Pivot(), n);
+}
+
+/*
+B == A (same data, layout and ld) inverts in place without copying; A and B must not overlap otherwise.
+det, if given, receives det(A) from the same factorization.
+*/
+template <typename ET1, typename ET2>
+inline int InvertCplxNxN(CplxMatrixViewT<ET1> A, CplxMatrixViewT<ET2> B,
+  CplxInvWorkspaceT<typename CplxRealOf<ET2>::Type>& ws, std::complex<typename CplxRealOf<ET2>::Type>* det = 0) {
+  typedef typename CplxRealOf<ET2>::Type T;
+  const int n = A.rows;
+  ws.Reserve(n);
+
+  // row-major storage is A^T in column-major order, inverted the same way as the copy below
+  if ((const void*)A.data == (const void*)B.data && A.layout == B.layout && A.ld == B.ld) {
+    lapack_int info = CplxLapack<T>::Getrf(n, B.data, ws.Pivot(), B.ld);
+    if (det)
+      *det = DetCplxFromLU(B.data, ws.Pivot(), n, B.ld);
+    if (!info)
+      info = CplxLapack<T>::Getri(n, B.data, ws.Pivot(), ws.Work(), ws.WorkSize(), B.ld);
+    return info;
+  }
+
+  std::complex<T>* tmat = ws.Matrix();
+
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      tmat[i + j * n] = A(i, j);
+
+  lapack_int info = CplxLapack<T>::Getrf(n, tmat, ws.Pivot());
+  if (det)
+    *det = DetCplxFromLU(tmat, ws.Pivot(), n);
+  if (!info)
+    info = CplxLapack<T>::Getri(n, tmat, ws.Pivot(), ws.Work(), ws.WorkSize());
+
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      B(i, j) = tmat[i + j * n];
+  return info;
+}
+
+template <typename ET>
+inline std::complex<typename CplxRealOf<ET>::Type> DetCplxNxN(CplxMatrixViewT<ET> A) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET>::Type> ws(A.rows);
+  return DetCplxNxN(A, ws);
+}
+
+template <typename ET1, typename ET2>
+inline int InvertCplxNxN(CplxMatrixViewT<ET1> A, CplxMatrixViewT<ET2> B) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET2>::Type> ws(A.rows);
+  return InvertCplxNxN(A, B, ws);
+}
+
+// View overloads : A is read in place, any layout or sub-block. A must be square.
+template <typename ET>
+inline std::complex<typename CplxRealOf<ET>::Type> DetCplx(CplxMatrixViewT<ET> A,
+  CplxInvWorkspaceT<typename CplxRealOf<ET>::Type>& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_DET, A.rows, A.rows <= 8 ? CPLX_PATH_FIXED : CPLX_PATH_LAPACK, 1);
+  switch (A.rows) {
+  case 1: return DetCplx1x1(A);
+  case 2: return DetCplx2x2(A);
+  case 3: return DetCplx3x3(A);
+  case 4: return DetCplx4x4(A);
+  case 5: return DetCplx5x5(A);
+  case 6: return DetCplx6x6(A);
+  case 7: return DetCplx<7>(A);
+  case 8: return DetCplx<8>(A);
+  default: return DetCplxNxN(A, ws);
+  }
+}
+
+template <typename ET>
+inline std::complex<typename CplxRealOf<ET>::Type> DetCplx(CplxMatrixViewT<ET> A) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET>::Type> ws;
+  return DetCplx(A, ws);
+}
+
+// B may be A itself (in place) for every size; otherwise A and B must not overlap.
+template <typename ET1, typename ET2>
+inline void InvertCplx(CplxMatrixViewT<ET1> A, CplxMatrixViewT<ET2> B,
+  CplxInvWorkspaceT<typename CplxRealOf<ET2>::Type>& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_INVERT, A.rows, CplxStatsInvertPath(A.rows, INVERSION_CPLX_NATIVE_MAX), 1);
+  switch (A.rows) {
+  case 1: InvertCplx1x1(A, B);
+    break;
+  case 2: InvertCplx2x2(A, B);
+    break;
+  case 3: InvertCplx3x3(A, B);
+    break;
+  case 4: InvertCplx4x4(A, B);
+    break;
+  case 5: InvertCplx5x5(A, B);
+    break;
+  case 6: InvertCplx6x6(A, B);
+    break;
+  case 7: InvertCplx<7>(A, B);
+    break;
+  case 8: InvertCplx<8>(A, B);
+    break;
+  default:
+    if (A.rows <= INVERSION_CPLX_NATIVE_MAX) {
+      if (InvertCplxNative(A, B, A.rows, ws))
+        INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    }
+    else if (InvertCplxNxN(A, B, ws))
+      INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    break;
+  }
+}
+
+template <typename ET1, typename ET2>
+inline void InvertCplx(CplxMatrixViewT<ET1> A, CplxMatrixViewT<ET2> B) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET2>::Type> ws;
+  InvertCplx(A, B, ws);
+}
+
+// InvertCplx returning det(A) from the same computation, as the row-pointer overload.
+template <typename ET1, typename ET2>
+inline std::complex<typename CplxRealOf<ET2>::Type> InvertAndDetCplx(CplxMatrixViewT<ET1> A, CplxMatrixViewT<ET2> B,
+  CplxInvWorkspaceT<typename CplxRealOf<ET2>::Type>& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_INVERT, A.rows, CplxStatsInvertPath(A.rows, INVERSION_CPLX_NATIVE_MAX), 1);
+  std::complex<typename CplxRealOf<ET2>::Type> det;
+  switch (A.rows) {
+  case 1: return InvertAndDetCplx1x1(A, B);
+  case 2: return InvertAndDetCplx2x2(A, B);
+  case 3: return InvertAndDetCplx3x3(A, B);
+  case 4: return InvertAndDetCplx4x4(A, B);
+  case 5: return InvertAndDetCplx5x5(A, B);
+  case 6: return InvertAndDetCplx6x6(A, B);
+  case 7: return InvertAndDetCplx<7>(A, B);
+  case 8: return InvertAndDetCplx<8>(A, B);
+  default:
+    if (A.rows <= INVERSION_CPLX_NATIVE_MAX) {
+      if (InvertCplxNative(A, B, A.rows, ws, &det))
+        INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    }
+    else if (InvertCplxNxN(A, B, ws, &det))
+      INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    return det;
+  }
+}
+
+template <typename ET1, typename ET2>
+inline std::complex<typename CplxRealOf<ET2>::Type> InvertAndDetCplx(CplxMatrixViewT<ET1> A, CplxMatrixViewT<ET2> B) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET2>::Type> ws;
+  return InvertAndDetCplx(A, B, ws);
+}
+
+// Overwrites A with its inverse, without an N x N scratch copy for any size.
+template <typename T>
+inline void InvertCplxInPlace(CplxMatrixViewT<std::complex<T> > A, CplxInvWorkspaceT<T>& ws) {
+  InvertCplx(A, A, ws);
+}
+
+template <typename T>
+inline void InvertCplxInPlace(CplxMatrixViewT<std::complex<T> > A) {
+  CplxInvWorkspaceT<T> ws;
+  InvertCplx(A, A, ws);
+}
+
+/*
+log(det(A)) for a fixed N : real part log|det|, imaginary part arg(det) in (-pi, pi].
+Partial-pivoted LU on a local copy; unlike DetCplx<N> the product of the pivots never overflows,
+so this is the one to use for likelihoods and information criteria.
+A singular matrix gives a real part of -inf.
+*/
+template <int N, typename MT>
+inline std::complex<double> LogDetCplx(MT A) {
+  std::complex<double> a[N][N];
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++)
+      a[i][j] = A[i][j];
+
+  CplxLogProduct p;
+  for (int k = 0; k < N; k++) {
+    int piv = k;
+    double best = std::abs(a[k][k].real()) + std::abs(a[k][k].imag());
+    for (int i = k + 1; i < N; i++) {
+      const double m = std::abs(a[i][k].real()) + std::abs(a[i][k].imag());
+      if (m > best) {
+        best = m;
+        piv = i;
+      }
+    }
+    if (best == 0.0)
+      return std::complex<double>(-std::numeric_limits<double>::infinity(), 0.0);
+    if (piv != k) {
+      for (int j = k; j < N; j++)
+        std::swap(a[k][j], a[piv][j]);
+      p.Mul(-a[k][k]);
+    }
+    else
+      p.Mul(a[k][k]);
+
+    const std::complex<double> ipivot = 1.0 / a[k][k];
+    for (int i = k + 1; i < N; i++) {
+      const std::complex<double> f = a[i][k] * ipivot;
+      for (int j = k + 1; j < N; j++)
+        a[i][j] -= f * a[k][j];
+    }
+  }
+  return p.Log();
+}
+
+template <typename MT>
+inline std::complex<double> LogDetCplxNxN(MT A, int n, CplxInvWorkspace& ws) {
+  ws.Reserve(n);
+  std::complex<double>* tmat = ws.Matrix();
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      tmat[i + j * n] = A[i][j];
+
+  // zgetrf's info only flags an exactly zero pivot, which gives -inf below
+  CplxLapack<double>::Getrf(n, tmat, ws.Pivot());
+  return LogDetCplxFromLU(tmat, ws.Pivot(), n);
+}
+
+// Accessor overload (row-pointer table, CplxRowMajorPtr, view).
+template <typename MT>
+inline std::complex<double> LogDetCplx(MT A, int dim, CplxInvWorkspace& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_LOGDET, dim, dim <= 8 ? CPLX_PATH_FIXED : CPLX_PATH_LAPACK, 1);
+  switch (dim) {
+  case 1: return LogDetCplx<1>(A);
+  case 2: return LogDetCplx<2>(A);
+  case 3: return LogDetCplx<3>(A);
+  case 4: return LogDetCplx<4>(A);
+  case 5: return LogDetCplx<5>(A);
+  case 6: return LogDetCplx<6>(A);
+  case 7: return LogDetCplx<7>(A);
+  case 8: return LogDetCplx<8>(A);
+  default: return LogDetCplxNxN(A, dim, ws);
+  }
+}
+
+template <typename MT>
+inline std::complex<double> LogDetCplx(MT A, int dim) {
+  CplxInvWorkspace ws;
+  return LogDetCplx(A, dim, ws);
+}
+
+inline std::complex<double> LogDetCplx(CplxConstMatrixView A, CplxInvWorkspace& ws) {
+  return LogDetCplx(A, A.rows, ws);
+}
+
+inline std::complex<double> LogDetCplx(CplxConstMatrixView A) {
+  CplxInvWorkspace ws;
+  return LogDetCplx(A, A.rows, ws);
+}
+
+// 1-norm (largest column sum of |a_ij|) of an n x n matrix.
+template <typename MT>
+inline double NormCplx1(MT A, int n) {
+  double norm = 0.0;
+  for (int j = 0; j < n; j++) {
+    double s = 0.0;
+    for (int i = 0; i < n; i++)
+      s += std::abs(A[i][j]);
+    // NaN is kept once seen
+    if (s > norm || s != s)
+      norm = s;
+  }
+  return norm;
+}
+
+/*
+Status bits of InvertCplxChecked. SINGULAR, ILL_CONDITIONED and NONFINITE describe A,
+REGULARIZED and FAILED describe what was written to B.
+*/
+enum CplxInvFlags {
+  CPLX_INV_OK = 0,
+  CPLX_INV_SINGULAR = 1,         // zero pivot or non-finite inverse
+  CPLX_INV_ILL_CONDITIONED = 2,  // rcond < CplxInvOptions::rcondMin
+  CPLX_INV_NONFINITE = 4,        // A contains inf or NaN
+  CPLX_INV_REGULARIZED = 8,      // B = inv(A + delta I), see CplxInvOptions::loading
+  CPLX_INV_FAILED = 16           // no usable inverse, B is set to zero
+};
+
+struct CplxInvOptions {
+  // matrices with rcond below this count as ill-conditioned
+  double rcondMin;
+  // Tikhonov loading : an ill-conditioned or singular A is replaced by A + loading * ||A||_1 * I. 0 disables it.
+  double loading;
+
+  CplxInvOptions(double rcondMin_ = 1e-12, double loading_ = 0.0) : rcondMin(rcondMin_), loading(loading_) {}
+};
+
+// Inverts A into B and returns rcond = 1 / (||A||_1 ||inv(A)||_1), 0 for a singular or non-finite result.
+inline double InvertCplxRcond(CplxConstMatrixView A, CplxMatrixView B, double anorm, CplxInvWorkspace& ws) {
+  const int n = A.rows;
+  if (n > 8) {
+    if (n <= INVERSION_CPLX_NATIVE_MAX ? InvertCplxNative(A, B, n, ws) : InvertCplxNxN(A, B, ws))
+      return 0.0;
+  }
+  else
+    InvertCplx(A, B, ws);
+  const double inorm = NormCplx1(B, n);
+  return std::isfinite(inorm) && inorm > 0.0 && anorm > 0.0 ? 1.0 / (anorm * inorm) : 0.0;
+}
+
+/*
+InvertCplx with singularity reporting : returns CplxInvFlags bits and optionally the reciprocal
+condition number of A in the 1-norm. rcond is exact (from the computed inverse, O(N^2) on top
+of the inversion), so no separate NaN scan of B is needed. If A is ill-conditioned and
+opt.loading > 0, B is the inverse of the diagonally loaded matrix instead.
+B may be A itself; A is then saved to the workspace first, as the loaded retry needs it.
+Otherwise A and B must not overlap.
+*/
+inline int InvertCplxChecked(CplxConstMatrixView A, CplxMatrixView B, const CplxInvOptions& opt,
+  CplxInvWorkspace& ws, double* rcond = 0) {
+  const int n = A.rows;
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_CHECKED, n, CplxStatsInvertPath(n, INVERSION_CPLX_NATIVE_MAX), 1);
+  if (A.data == B.data) {
+    ws.ReserveRhs(n, 2 * n);
+    CplxMatrixView S(ws.Rhs() + (size_t)n * n, n);
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        S(i, j) = A(i, j);
+    A = S;
+  }
+  const double anorm = NormCplx1(A, n);
+  double rc = 0.0;
+  int flags = CPLX_INV_OK;
+
+  if (!std::isfinite(anorm))
+    flags = CPLX_INV_NONFINITE | CPLX_INV_FAILED;
+  else {
+    rc = InvertCplxRcond(A, B, anorm, ws);
+    if (rc == 0.0)
+      flags = CPLX_INV_SINGULAR;
+    else if (rc < opt.rcondMin)
+      flags = CPLX_INV_ILL_CONDITIONED;
+
+    if (flags && opt.loading > 0.0 && anorm > 0.0) {
+      ws.ReserveRhs(n, n);
+      CplxMatrixView L(ws.Rhs(), n);
+      for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+          L(i, j) = A(i, j);
+      for (int i = 0; i < n; i++)
+        L(i, i) += opt.loading * anorm;
+      flags |= CPLX_INV_REGULARIZED;
+      if (InvertCplxRcond(L, B, NormCplx1(L, n), ws) == 0.0)
+        flags |= CPLX_INV_FAILED;
+    }
+    else if (flags & CPLX_INV_SINGULAR)
+      flags |= CPLX_INV_FAILED;
+  }
+
+  if (flags & (CPLX_INV_SINGULAR | CPLX_INV_ILL_CONDITIONED))
+    INVERSION_CPLX_PROBE_ILL(probe);
+  if (flags & CPLX_INV_FAILED) {
+    INVERSION_CPLX_PROBE_FAIL(probe, 1);
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        B(i, j) = 0.0;
+  }
+  if (rcond)
+    *rcond = rc;
+  return flags;
+}
+
+inline int InvertCplxChecked(CplxConstMatrixView A, CplxMatrixView B, const CplxInvOptions& opt = CplxInvOptions(),
+  double* rcond = 0) {
+  CplxInvWorkspace ws;
+  return InvertCplxChecked(A, B, opt, ws, rcond);
+}
+
+/*
+Hermitian positive definite matrices (spatial covariances) : Cholesky A = L L^H.
+Only the lower triangle of A is read. inv(A) = inv(L)^H inv(L) is formed on the lower triangle
+and mirrored into the upper one unless a single triangle is asked for.
+The return value follows LAPACK's info : 0 on success, k > 0 if the leading k x k minor is not
+positive definite (B is left untouched then).
+*/
+enum CplxTriangle {
+  CPLX_FULL,
+  CPLX_LOWER,
+  CPLX_UPPER
+};
+
+template <typename MT>
+inline void StoreHermCplx(MT B, int i, int j, const std::complex<double>& v, CplxTriangle tri) {
+  if (tri != CPLX_UPPER)
+    B[i][j] = v;
+  if (tri != CPLX_LOWER)
+    B[j][i] = std::conj(v);
+}
+
+template <int N>
+struct CplxHermFixed {
+  // L gets the Cholesky factor, d the reciprocals of its (real) diagonal.
+  template <typename MT>
+  static int Factor(MT A, std::complex<double>(&L)[N][N], double(&d)[N]) {
+    for (int j = 0; j < N; j++) {
+      double s = std::real(A[j][j]);
+      for (int k = 0; k < j; k++)
+        s -= std::norm(L[j][k]);
+      if (!(s > 0.0))
+        return j + 1;
+
+      const double ljj = std::sqrt(s);
+      L[j][j] = ljj;
+      d[j] = 1.0 / ljj;
+      for (int i = j + 1; i < N; i++) {
+        std::complex<double> t(A[i][j]);
+        for (int k = 0; k < j; k++)
+          t -= L[i][k] * std::conj(L[j][k]);
+        L[i][j] = t * d[j];
+      }
+    }
+    return 0;
+  }
+
+  template <typename MT1, typename MT2>
+  static int Invert(MT1 A, MT2 B, CplxTriangle tri) {
+    std::complex<double> L[N][N];
+    double d[N];
+    const int info = Factor(A, L, d);
+    if (info)
+      return info;
+
+    // inv(L) in place : column j only needs the untouched columns >= j of L
+    for (int j = 0; j < N; j++) {
+      L[j][j] = d[j];
+      for (int i = j + 1; i < N; i++) {
+        std::complex<double> t(0.0);
+        for (int k = j; k < i; k++)
+          t += L[i][k] * L[k][j];
+        L[i][j] = -t * d[i];
+      }
+    }
+
+    for (int j = 0; j < N; j++)
+      for (int i = j; i < N; i++) {
+        std::complex<double> t(0.0);
+        for (int k = i; k < N; k++)
+          t += std::conj(L[k][i]) * L[k][j];
+        StoreHermCplx(B, i, j, t, tri);
+      }
+    return 0;
+  }
+
+  template <typename MT>
+  static double Det(MT A) {
+    std::complex<double> L[N][N];
+    double d[N];
+    if (Factor(A, L, d))
+      return 0.0;
+    double det = 1.0;
+    for (int j = 0; j < N; j++)
+      det *= std::norm(L[j][j]);
+    return det;
+  }
+};
+
+// zpotrf / zpotri on the lower triangle, in the workspace matrix (column-major).
+template <typename MT1, typename MT2>
+inline int InvertHermCplxNxN(MT1 A, MT2 B, int n, CplxTriangle tri, CplxInvWorkspace& ws) {
+  ws.Reserve(n);
+  std::complex<double>* tmat = ws.Matrix();
+
+  for (int j = 0; j < n; j++)
+    for (int i = j; i < n; i++)
+      tmat[i + j * n] = A[i][j];
+
+  lapack_int info = LAPACKE_zpotrf(LAPACK_COL_MAJOR, 'L', n, tmat, n);
+  if (info == 0)
+    info = LAPACKE_zpotri(LAPACK_COL_MAJOR, 'L', n, tmat, n);
+  if (info)
+    return info;
+
+  for (int j = 0; j < n; j++)
+    for (int i = j; i < n; i++)
+      StoreHermCplx(B, i, j, tmat[i + j * n], tri);
+  return 0;
+}
+
+template <typename MT>
+inline double DetHermCplxNxN(MT A, int n, CplxInvWorkspace& ws) {
+  ws.Reserve(n);
+  std::complex<double>* tmat = ws.Matrix();
+
+  for (int j = 0; j < n; j++)
+    for (int i = j; i < n; i++)
+      tmat[i + j * n] = A[i][j];
+
+  if (LAPACKE_zpotrf(LAPACK_COL_MAJOR, 'L', n, tmat, n))
+    return 0.0;
+  double det = 1.0;
+  for (int i = 0; i < n; i++)
+    det *= std::norm(tmat[i + i * n]);
+  return det;
+}
+
+template <typename MT1, typename MT2>
+inline int InvertHermCplx(MT1 A, MT2 B, int dim, CplxTriangle tri, CplxInvWorkspace& ws) {
+  switch (dim) {
+  case 1: return CplxHermFixed<1>::Invert(A, B, tri);
+  case 2: return CplxHermFixed<2>::Invert(A, B, tri);
+  case 3: return CplxHermFixed<3>::Invert(A, B, tri);
+  case 4: return CplxHermFixed<4>::Invert(A, B, tri);
+  case 5: return CplxHermFixed<5>::Invert(A, B, tri);
+  case 6: return CplxHermFixed<6>::Invert(A, B, tri);
+  case 7: return CplxHermFixed<7>::Invert(A, B, tri);
+  case 8: return CplxHermFixed<8>::Invert(A, B, tri);
+  default: return InvertHermCplxNxN(A, B, dim, tri, ws);
+  }
+}
+
+template <typename MT1, typename MT2>
+inline int InvertHermCplx(MT1 A, MT2 B, int dim, CplxTriangle tri = CPLX_FULL) {
+  CplxInvWorkspace ws;
+  return InvertHermCplx(A, B, dim, tri, ws);
+}
+
+// Determinant of a Hermitian positive definite matrix (real, > 0); 0 if A is not positive definite.
+template <typename MT>
+inline double DetHermCplx(MT A, int dim, CplxInvWorkspace& ws) {
+  switch (dim) {
+  case 1: return CplxHermFixed<1>::Det(A);
+  case 2: return CplxHermFixed<2>::Det(A);
+  case 3: return CplxHermFixed<3>::Det(A);
+  case 4: return CplxHermFixed<4>::Det(A);
+  case 5: return CplxHermFixed<5>::Det(A);
+  case 6: return CplxHermFixed<6>::Det(A);
+  case 7: return CplxHermFixed<7>::Det(A);
+  case 8: return CplxHermFixed<8>::Det(A);
+  default: return DetHermCplxNxN(A, dim, ws);
+  }
+}
+
+template <typename MT>
+inline double DetHermCplx(MT A, int dim) {
+  CplxInvWorkspace ws;
+  return DetHermCplx(A, dim, ws);
+}
+
+/*
+Linear solve A x = b without forming inv(A). b and x are dim x nrhs, row-major (element (i,r) at
+[i * nrhs + r]) and may point to the same buffer. Sizes up to 8 run a fixed-size elimination
+with partial pivoting, larger ones zgesv (zposv for SolveHermCplx).
+Returns 0, or k > 0 if the k-th pivot is exactly zero (not positive definite for SolveHermCplx).
+*/
+template <int N>
+struct CplxSolveFixed {
+  template <typename MT>
+  static int Solve(MT A, const std::complex<double>* b, std::complex<double>* x, int nrhs) {
+    std::complex<double> a[N][N];
+
+    for (int i = 0; i < N; i++)
+      for (int j = 0; j < N; j++)
+        a[i][j] = A[i][j];
+    if (x != b)
+      memcpy(x, b, sizeof(std::complex<double>) * N * nrhs);
+
+    for (int k = 0; k < N; k++) {
+      int piv = k;
+      double big = std::abs(a[k][k].real()) + std::abs(a[k][k].imag());
+      for (int i = k + 1; i < N; i++) {
+        const double m = std::abs(a[i][k].real()) + std::abs(a[i][k].imag());
+        if (m > big) {
+          big = m;
+          piv = i;
+        }
+      }
+      if (big == 0.0)
+        return k + 1;
+      if (piv != k) {
+        for (int j = k; j < N; j++)
+          std::swap(a[k][j], a[piv][j]);
+        for (int r = 0; r < nrhs; r++)
+          std::swap(x[k * nrhs + r], x[piv * nrhs + r]);
+      }
+
+      const std::complex<double> ipiv(1.0 / a[k][k]);
+      for (int i = k + 1; i < N; i++) {
+        const std::complex<double> f(a[i][k] * ipiv);
+        for (int j = k + 1; j < N; j++)
+          a[i][j] -= f * a[k][j];
+        for (int r = 0; r < nrhs; r++)
+          x[i * nrhs + r] -= f * x[k * nrhs + r];
+      }
+    }
+
+    for (int k = N - 1; k >= 0; k--) {
+      const std::complex<double> ipiv(1.0 / a[k][k]);
+      for (int r = 0; r < nrhs; r++) {
+        std::complex<double> t(x[k * nrhs + r]);
+        for (int j = k + 1; j < N; j++)
+          t -= a[k][j] * x[j * nrhs + r];
+        x[k * nrhs + r] = t * ipiv;
+      }
+    }
+    return 0;
+  }
+
+  // L L^H x = b with the Cholesky factor of CplxHermFixed
+  template <typename MT>
+  static int SolveHerm(MT A, const std::complex<double>* b, std::complex<double>* x, int nrhs) {
+    std::complex<double> L[N][N];
+    double d[N];
+    const int info = CplxHermFixed<N>::Factor(A, L, d);
+    if (info)
+      return info;
+    if (x != b)
+      memcpy(x, b, sizeof(std::complex<double>) * N * nrhs);
+
+    for (int r = 0; r < nrhs; r++) {
+      for (int i = 0; i < N; i++) {
+        std::complex<double> t(x[i * nrhs + r]);
+        for (int k = 0; k < i; k++)
+          t -= L[i][k] * x[k * nrhs + r];
+        x[i * nrhs + r] = t * d[i];
+      }
+      for (int i = N - 1; i >= 0; i--) {
+        std::complex<double> t(x[i * nrhs + r]);
+        for (int k = i + 1; k < N; k++)
+          t -= std::conj(L[k][i]) * x[k * nrhs + r];
+        x[i * nrhs + r] = t * d[i];
+      }
+    }
+    return 0;
+  }
+};
+
+// zgesv / zposv on column-major copies of A and b in the workspace.
+template <typename MT>
+inline int SolveCplxNxN(MT A, const std::complex<double>* b, std::complex<double>* x, int n, int nrhs, bool herm,
+  CplxInvWorkspace& ws) {
+  ws.Reserve(n);
+  ws.ReserveRhs(n, nrhs);
+  std::complex<double>* tmat = ws.Matrix();
+  std::complex<double>* tb = ws.Rhs();
+
+  for (int j = 0; j < n; j++)
+    for (int i = herm ? j : 0; i < n; i++)
+      tmat[i + j * n] = A[i][j];
+  for (int i = 0; i < n; i++)
+    for (int r = 0; r < nrhs; r++)
+      tb[i + r * n] = b[i * nrhs + r];
+
+  const lapack_int info = herm ?
+    LAPACKE_zposv(LAPACK_COL_MAJOR, 'L', n, nrhs, tmat, n, tb, n) :
+    LAPACKE_zgesv(LAPACK_COL_MAJOR, n, nrhs, tmat, n, ws.Pivot(), tb, n);
+  if (info)
+    return info;
+
+  for (int i = 0; i < n; i++)
+    for (int r = 0; r < nrhs; r++)
+      x[i * nrhs + r] = tb[i + r * n];
+  return 0;
+}
+
+template <typename MT>
+inline int SolveCplx(MT A, const std::complex<double>* b, std::complex<double>* x, int dim, int nrhs,
+  CplxInvWorkspace& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_SOLVE, dim, dim <= 8 ? CPLX_PATH_FIXED : CPLX_PATH_LAPACK, 1);
+  int info;
+  switch (dim) {
+  case 1: info = CplxSolveFixed<1>::Solve(A, b, x, nrhs);
+    break;
+  case 2: info = CplxSolveFixed<2>::Solve(A, b, x, nrhs);
+    break;
+  case 3: info = CplxSolveFixed<3>::Solve(A, b, x, nrhs);
+    break;
+  case 4: info = CplxSolveFixed<4>::Solve(A, b, x, nrhs);
+    break;
+  case 5: info = CplxSolveFixed<5>::Solve(A, b, x, nrhs);
+    break;
+  case 6: info = CplxSolveFixed<6>::Solve(A, b, x, nrhs);
+    break;
+  case 7: info = CplxSolveFixed<7>::Solve(A, b, x, nrhs);
+    break;
+  case 8: info = CplxSolveFixed<8>::Solve(A, b, x, nrhs);
+    break;
+  default: info = SolveCplxNxN(A, b, x, dim, nrhs, false, ws);
+    break;
+  }
+  if (info)
+    INVERSION_CPLX_PROBE_FAIL(probe, 1);
+  return info;
+}
+
+template <typename MT>
+inline int SolveCplx(MT A, const std::complex<double>* b, std::complex<double>* x, int dim, int nrhs = 1) {
+  CplxInvWorkspace ws;
+  return SolveCplx(A, b, x, dim, nrhs, ws);
+}
+
+// Hermitian positive definite A, only its lower triangle is read.
+template <typename MT>
+inline int SolveHermCplx(MT A, const std::complex<double>* b, std::complex<double>* x, int dim, int nrhs,
+  CplxInvWorkspace& ws) {
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_SOLVE, dim, dim <= 8 ? CPLX_PATH_FIXED : CPLX_PATH_LAPACK, 1);
+  int info;
+  switch (dim) {
+  case 1: info = CplxSolveFixed<1>::SolveHerm(A, b, x, nrhs);
+    break;
+  case 2: info = CplxSolveFixed<2>::SolveHerm(A, b, x, nrhs);
+    break;
+  case 3: info = CplxSolveFixed<3>::SolveHerm(A, b, x, nrhs);
+    break;
+  case 4: info = CplxSolveFixed<4>::SolveHerm(A, b, x, nrhs);
+    break;
+  case 5: info = CplxSolveFixed<5>::SolveHerm(A, b, x, nrhs);
+    break;
+  case 6: info = CplxSolveFixed<6>::SolveHerm(A, b, x, nrhs);
+    break;
+  case 7: info = CplxSolveFixed<7>::SolveHerm(A, b, x, nrhs);
+    break;
+  case 8: info = CplxSolveFixed<8>::SolveHerm(A, b, x, nrhs);
+    break;
+  default: info = SolveCplxNxN(A, b, x, dim, nrhs, true, ws);
+    break;
+  }
+  if (info)
+    INVERSION_CPLX_PROBE_FAIL(probe, 1);
+  return info;
+}
+
+template <typename MT>
+inline int SolveHermCplx(MT A, const std::complex<double>* b, std::complex<double>* x, int dim, int nrhs = 1) {
+  CplxInvWorkspace ws;
+  return SolveHermCplx(A, b, x, dim, nrhs, ws);
+}
+
+/*
+LU factorization (zgetrf) kept for reuse : factor a matrix once, then query its determinant,
+log-determinant, solves against any number of right-hand sides and the explicit inverse
+without refactoring. Storage is sized by Reserve() / the first Factor() and reused afterwards.
+Before the first Factor(), Det() is 1, LogDet() 0 (the empty matrix) and Solve() / Inverse()
+return -1.
+*/
+class CplxLUFactorization {
+public:
+  CplxLUFactorization() : n(0), info(0) {}
+  explicit CplxLUFactorization(int dim) : n(0), info(0) { Reserve(dim); }
+
+  void Reserve(int dim) {
+    if ((size_t)dim * dim > lu.size()) {
+      lu.resize((size_t)dim * dim);
+      ipiv.resize(dim);
+    }
+    ws.Reserve(dim);
+  }
+
+  // Returns zgetrf's info : 0, or k > 0 if U(k,k) is exactly zero.
+  template <typename MT>
+  int Factor(MT A, int dim) {
+    Reserve(dim);
+    n = dim;
+    for (int j = 0; j < n; j++)
+      for (int i = 0; i < n; i++)
+        lu[i + j * n] = A[i][j];
+    info = LAPACKE_zgetrf(LAPACK_COL_MAJOR, n, n, &lu[0], n, &ipiv[0]);
+    return info;
+  }
+
+  int Dim() const { return n; }
+  int Info() const { return info; }
+
+  std::complex<double> Det() const {
+    if (n == 0)
+      return 1.0;
+    return DetCplxFromLU(&lu[0], &ipiv[0], n);
+  }
+
+  // log(det) : real part log|det|, imaginary part arg(det) in (-pi, pi]. Does not overflow.
+  std::complex<double> LogDet() const {
+    if (n == 0)
+      return 0.0;
+    return LogDetCplxFromLU(&lu[0], &ipiv[0], n);
+  }
+
+  // b and x as for SolveCplx (dim x nrhs row-major, may alias).
+  int Solve(const std::complex<double>* b, std::complex<double>* x, int nrhs = 1) {
+    if (n == 0)
+      return -1;
+    if (info)
+      return info;
+    ws.ReserveRhs(n, nrhs);
+    std::complex<double>* tb = ws.Rhs();
+    for (int i = 0; i < n; i++)
+      for (int r = 0; r < nrhs; r++)
+        tb[i + r * n] = b[i * nrhs + r];
+
+    const lapack_int ret = LAPACKE_zgetrs(LAPACK_COL_MAJOR, 'N', n, nrhs, &lu[0], n, &ipiv[0], tb, n);
+    if (ret)
+      return ret;
+    for (int i = 0; i < n; i++)
+      for (int r = 0; r < nrhs; r++)
+        x[i * nrhs + r] = tb[i + r * n];
+    return 0;
+  }
+
+  // inv(A) into B; the stored factors are kept.
+  template <typename MT>
+  int Inverse(MT B) {
+    if (n == 0)
+      return -1;
+    if (info)
+      return info;
+    std::complex<double>* tmat = ws.Matrix();
+    memcpy(tmat, &lu[0], sizeof(std::complex<double>) * n * n);
+    const lapack_int ret = LAPACKE_zgetri_work(LAPACK_COL_MAJOR, n, tmat, n, &ipiv[0], ws.Work(), ws.WorkSize());
+    if (ret)
+      return ret;
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        B[i][j] = tmat[i + j * n];
+    return 0;
+  }
+
+private:
+  int n;
+  int info;
+  std::vector<std::complex<double> > lu;
+  std::vector<lapack_int> ipiv;
+  CplxInvWorkspace ws;
+};
+
+/*
+Mixed-precision LU (the scheme of LAPACK zcgesv) : A is factored once in single precision
+(cgetrf), and every solve is refined in double precision, x += inv(A)_float * (b - A x),
+until the residual of each column satisfies ||r|| <= ||x|| * ||A|| * eps * sqrt(n).
+This gives double accuracy at the cost of the float factorization for well enough conditioned A.
+If the refinement does not converge in MaxIterations() steps (condition number near 1 / eps_float)
+or cgetrf hits a zero pivot, A is refactored with zgetrf and used from then on.
+*/
+class CplxMixedLU {
+public:
+  CplxMixedLU() : n(0), info(0), useDouble(false), anorm(0.0), iter(0), maxIter(30) {}
+  explicit CplxMixedLU(int dim) : n(0), info(0), useDouble(false), anorm(0.0), iter(0), maxIter(30) {
+    Reserve(dim);
+  }
+
+  void Reserve(int dim) {
+    if ((size_t)dim * dim > a.size()) {
+      a.resize((size_t)dim * dim);
+      af.resize((size_t)dim * dim);
+      ipiv.resize(dim);
+    }
+  }
+
+  // Returns 0, or k > 0 if U(k,k) is exactly zero in the double precision factorization as well.
+  template <typename MT>
+  int Factor(MT A, int dim) {
+    Reserve(dim);
+    n = dim;
+    anorm = 0.0;
+    for (int i = 0; i < n; i++) {
+      double s = 0.0;
+      for (int j = 0; j < n; j++) {
+        a[i + j * n] = A[i][j];
+        af[i + j * n] = std::complex<float>(a[i + j * n]);
+        s += std::abs(a[i + j * n]);
+      }
+      if (s > anorm)
+        anorm = s;
+    }
+    useDouble = false;
+    info = CplxLapack<float>::Getrf(n, &af[0], &ipiv[0]);
+    if (info)
+      info = FactorDouble();
+    return info;
+  }
+
+  int Dim() const { return n; }
+  int Info() const { return info; }
+  bool DoublePrecision() const { return useDouble; }
+
+  // Refinement steps of the last Solve / Inverse, -1 if it was solved in double precision.
+  int Iterations() const { return iter; }
+  int MaxIterations() const { return maxIter; }
+  void SetMaxIterations(int m) { maxIter = m; }
+
+  // b and x as for SolveCplx (dim x nrhs row-major, may alias). -1 before Factor().
+  int Solve(const std::complex<double>* b, std::complex<double>* x, int nrhs = 1) {
+    if (n == 0)
+      return -1;
+    if (info)
+      return info;
+    ReserveRhs(nrhs);
+    memcpy(&rhs[0], b, sizeof(std::complex<double>) * n * nrhs);
+    const int ret = Refine(nrhs);
+    if (ret)
+      return ret;
+    memcpy(x, &sol[0], sizeof(std::complex<double>) * n * nrhs);
+    return 0;
+  }
+
+  // inv(A) into B, refined column by column as a solve against the identity. -1 before Factor().
+  template <typename MT>
+  int Inverse(MT B) {
+    if (n == 0)
+      return -1;
+    if (info)
+      return info;
+    ReserveRhs(n);
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        rhs[i * n + j] = i == j ? 1.0 : 0.0;
+    const int ret = Refine(n);
+    if (ret)
+      return ret;
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        B[i][j] = sol[i * n + j];
+    return 0;
+  }
+
+private:
+  int FactorDouble() {
+    useDouble = true;
+    return dlu.Factor(CplxConstMatrixView(&a[0], n, CPLX_COL_MAJOR), n);
+  }
+
+  void ReserveRhs(int nrhs) {
+    const size_t m = (size_t)n * nrhs;
+    if (m > rhs.size()) {
+      rhs.resize(m);
+      sol.resize(m);
+      res.resize(m);
+      corr.resize(m);
+    }
+  }
+
+  // rhs -> sol, both n x nrhs row-major. corr is column-major for cgetrs.
+  int Refine(int nrhs) {
+    const size_t m = (size_t)n * nrhs;
+    if (!useDouble) {
+      const double tol = anorm * std::numeric_limits<double>::epsilon() * 0.5 * std::sqrt((double)n);
+      std::fill(sol.begin(), sol.begin() + m, std::complex<double>(0.0));
+      memcpy(&res[0], &rhs[0], sizeof(std::complex<double>) * m);
+
+      for (iter = 0; iter <= maxIter; iter++) {
+        for (int i = 0; i < n; i++)
+          for (int r = 0; r < nrhs; r++)
+            corr[i + r * n] = std::complex<float>(res[i * nrhs + r]);
+        CplxLapack<float>::Getrs(n, nrhs, &af[0], &ipiv[0], &corr[0]);
+        for (int i = 0; i < n; i++)
+          for (int r = 0; r < nrhs; r++)
+            sol[i * nrhs + r] += std::complex<double>(corr[i + r * n]);
+
+        bool converged = true;
+        for (int r = 0; r < nrhs; r++) {
+          double rnorm = 0.0, xnorm = 0.0;
+          for (int i = 0; i < n; i++) {
+            std::complex<double> t = rhs[i * nrhs + r];
+            for (int j = 0; j < n; j++)
+              t -= a[i + j * n] * sol[j * nrhs + r];
+            res[i * nrhs + r] = t;
+            rnorm = std::max(rnorm, std::abs(t));
+            xnorm = std::max(xnorm, std::abs(sol[i * nrhs + r]));
+          }
+          // also false for NaN, e.g. after float overflow
+          if (!(rnorm <= xnorm * tol))
+            converged = false;
+        }
+        if (converged)
+          return 0;
+      }
+
+      const int ret = FactorDouble();
+      if (ret)
+        return ret;
+    }
+    iter = -1;
+    return dlu.Solve(&rhs[0], &sol[0], nrhs);
+  }
+
+  int n;
+  int info;
+  bool useDouble;
+  double anorm;
+  int iter;
+  int maxIter;
+  std::vector<std::complex<double> > a;
+  std::vector<std::complex<float> > af;
+  std::vector<lapack_int> ipiv;
+  std::vector<std::complex<double> > rhs, sol, res;
+  std::vector<std::complex<float> > corr;
+  CplxLUFactorization dlu;
+};
+
+/*
+Sherman-Morrison update of an existing inverse, O(N^2) instead of a new O(N^3) inversion.
+Given Ainv = inv(A), overwrites it with inv(alpha * A + beta * u v^H).
+Returns 0, or 1 if alpha is 0 or the updated matrix is singular (Ainv is left unchanged then).
+*/
+template <typename MT>
+inline int UpdateInvCplxRank1(MT Ainv, int dim, std::complex<double> alpha, std::complex<double> beta,
+  const std::complex<double>* u, const std::complex<double>* v, CplxInvWorkspace& ws) {
+  const int n = dim;
+  if (alpha == 0.0)
+    return 1;
+  ws.ReserveRhs(n, 2);
+  std::complex<double>* p = ws.Rhs();
+  std::complex<double>* q = p + n;
+
+  // p = Ainv u, q = v^H Ainv
+  for (int i = 0; i < n; i++) {
+    p[i] = 0.0;
+    q[i] = 0.0;
+  }
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++) {
+      const std::complex<double> a = Ainv[i][j];
+      p[i] += a * u[j];
+      q[j] += std::conj(v[i]) * a;
+    }
+
+  const std::complex<double> g = beta / alpha;
+  std::complex<double> vp(0.0);
+  for (int i = 0; i < n; i++)
+    vp += std::conj(v[i]) * p[i];
+  const std::complex<double> den = 1.0 + g * vp;
+  if (den == 0.0)
+    return 1;
+
+  const std::complex<double> ialpha = 1.0 / alpha;
+  const std::complex<double> f = g / den;
+  for (int i = 0; i < n; i++) {
+    const std::complex<double> fp = f * p[i];
+    for (int j = 0; j < n; j++)
+      Ainv[i][j] = (Ainv[i][j] - fp * q[j]) * ialpha;
+  }
+  return 0;
+}
+
+template <typename MT>
+inline int UpdateInvCplxRank1(MT Ainv, int dim, std::complex<double> alpha, std::complex<double> beta,
+  const std::complex<double>* u, const std::complex<double>* v) {
+  CplxInvWorkspace ws;
+  return UpdateInvCplxRank1(Ainv, dim, alpha, beta, u, v, ws);
+}
+
+/*
+Rank-k version : inv(alpha * A + beta * U V^H), U and V dim x k row-major (column r is one update
+vector), applied as k successive rank-1 updates.
+*/
+template <typename MT>
+inline int UpdateInvCplxRankK(MT Ainv, int dim, std::complex<double> alpha, std::complex<double> beta,
+  const std::complex<double>* U, const std::complex<double>* V, int k, CplxInvWorkspace& ws) {
+  ws.ReserveRhs(dim, 4);
+  std::complex<double>* u = ws.Rhs() + 2 * dim;
+  std::complex<double>* v = u + dim;
+
+  for (int r = 0; r < k; r++) {
+    for (int i = 0; i < dim; i++) {
+      u[i] = U[i * k + r];
+      v[i] = V[i * k + r];
+    }
+    const int info = UpdateInvCplxRank1(Ainv, dim, r == 0 ? alpha : std::complex<double>(1.0), beta, u, v, ws);
+    if (info)
+      return info;
+  }
+  return 0;
+}
+
+/*
+Recursively averaged covariance R = a * R + (1 - a) * x x^H together with its inverse.
+Each Update() is a rank-1 Sherman-Morrison step; every refresh updates (0 : never) the inverse
+is recomputed from R with InvertHermCplx (InvertCplxChecked if R lost definiteness) to reset drift,
+and so is it when a rank-1 step fails, so R and its inverse always match. Update(), Reset() and
+Reinvert() return 0, or 1 if R is singular (the inverse is zero then).
+Matrices are dim x dim row-major.
+*/
+class CplxRecursiveInverse {
+public:
+  CplxRecursiveInverse() : n(0), refresh(0), updates(0) {}
+  CplxRecursiveInverse(int dim, int refresh_) : n(0), refresh(0), updates(0) { Init(dim, refresh_); }
+
+  void Init(int dim, int refresh_) {
+    n = dim;
+    refresh = refresh_;
+    updates = 0;
+    R.assign((size_t)n * n, 0.0);
+    Rinv.assign((size_t)n * n, 0.0);
+    ws.Reserve(n);
+    ws.ReserveRhs(n, 2);
+  }
+
+  // Starts from R0 (e.g. a diagonally loaded initial estimate) and inverts it.
+  int Reset(const std::complex<double>* R0) {
+    memcpy(&R[0], R0, sizeof(std::complex<double>) * n * n);
+    updates = 0;
+    return Reinvert();
+  }
+
+  int Update(double a, const std::complex<double>* x) {
+    for (int i = 0; i < n; i++)
+      for (int j = 0; j < n; j++)
+        R[i * n + j] = a * R[i * n + j] + (1.0 - a) * x[i] * std::conj(x[j]);
+
+    updates++;
+    if (refresh > 0 && updates >= refresh) {
+      updates = 0;
+      return Reinvert();
+    }
+    if (UpdateInvCplxRank1(CplxRowMajorPtr<std::complex<double> >(&Rinv[0], n), n, a, 1.0 - a, x, x, ws) == 0)
+      return 0;
+    updates = 0;
+    return Reinvert();
+  }
+
+  int Reinvert() {
+    CplxRowMajorPtr<std::complex<double> > r(&R[0], n), ri(&Rinv[0], n);
+    if (InvertHermCplx(r, ri, n, CPLX_FULL, ws) == 0)
+      return 0;
+    const int flags = InvertCplxChecked(CplxConstMatrixView(&R[0], n), CplxMatrixView(&Rinv[0], n),
+      CplxInvOptions(0.0), ws);
+    return flags & CPLX_INV_FAILED ? 1 : 0;
+  }
+
+  int Dim() const { return n; }
+  const std::complex<double>* Matrix() const { return &R[0]; }
+  const std::complex<double>* Inverse() const { return &Rinv[0]; }
+
+private:
+  int n;
+  int refresh;
+  int updates;
+  std::vector<std::complex<double> > R;
+  std::vector<std::complex<double> > Rinv;
+  CplxInvWorkspace ws;
+};
+
+
+/*
+Inverts count same-size matrices stored back to back in A (row-major, stride elements apart)
+and writes the results to the matching slots of B. The size dispatch is done once per batch.
+B == A inverts the whole batch in place, with no second buffer; otherwise A and B must not overlap.
+*/
+template <typename T>
+inline void InvertCplxBatch(const std::complex<T>* A, std::complex<T>* B, int dim, size_t count, size_t stride,
+  CplxInvWorkspaceT<T>& ws) {
+  typedef CplxRowMajorPtr<const std::complex<T> > In;
+  typedef CplxRowMajorPtr<std::complex<T> > Out;
+  const size_t n = (size_t)dim;
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_INVERT, dim, CplxStatsInvertPath(dim, INVERSION_CPLX_NATIVE_MAX), count);
+
+  switch (dim) {
+  case 1:
+    for (size_t k = 0; k < count; k++)
+      B[k * stride] = std::complex<T>(1) / A[k * stride];
+    break;
+  case 2:
+    for (size_t k = 0; k < count; k++)
+      InvertCplx2x2(In(A + k * stride, 2), Out(B + k * stride, 2));
     break;
+  case 3:
+    for (size_t k = 0; k < count; k++)
+      InvertCplx3x3(In(A + k * stride, 3), Out(B + k * stride, 3));
+    break;
+  case 4:
+    for (size_t k = 0; k < count; k++)
+      InvertCplx4x4(In(A + k * stride, 4), Out(B + k * stride, 4));
+    break;
+  case 5:
+    for (size_t k = 0; k < count; k++)
+      InvertCplx5x5(In(A + k * stride, 5), Out(B + k * stride, 5));
+    break;
+  case 6:
+    for (size_t k = 0; k < count; k++)
+      InvertCplx6x6(In(A + k * stride, 6), Out(B + k * stride, 6));
+    break;
+  case 7:
+    for (size_t k = 0; k < count; k++)
+      InvertCplx<7>(In(A + k * stride, 7), Out(B + k * stride, 7));
+    break;
+  case 8:
+    for (size_t k = 0; k < count; k++)
+      InvertCplx<8>(In(A + k * stride, 8), Out(B + k * stride, 8));
+    break;
+  default:
+    if (dim <= INVERSION_CPLX_NATIVE_MAX) {
+      for (size_t k = 0; k < count; k++)
+        if (InvertCplxNative(In(A + k * stride, dim), Out(B + k * stride, dim), dim, ws))
+          INVERSION_CPLX_PROBE_FAIL(probe, 1);
+      break;
+    }
+    // B holds A^T in column-major order, its column-major inverse is inv(A) in row-major order
+    ws.Reserve(dim);
+    for (size_t k = 0; k < count; k++) {
+      if (A != B)
+        memcpy(B + k * stride, A + k * stride, sizeof(std::complex<T>) * n * n);
+      if (CplxLapack<T>::Getrf(dim, B + k * stride, ws.Pivot())) {
+        INVERSION_CPLX_PROBE_FAIL(probe, 1);
+        continue;
+      }
+      CplxLapack<T>::Getri(dim, B + k * stride, ws.Pivot(), ws.Work(), ws.WorkSize());
+    }
+    break;
+  }
+}
+
+template <typename T>
+inline void InvertCplxBatch(const std::complex<T>* A, std::complex<T>* B, int dim, size_t count, size_t stride) {
+  CplxInvWorkspaceT<T> ws;
+  InvertCplxBatch(A, B, dim, count, stride, ws);
+}
+
+template <typename T>
+inline void InvertCplxBatchInPlace(std::complex<T>* A, int dim, size_t count, size_t stride, CplxInvWorkspaceT<T>& ws) {
+  InvertCplxBatch(A, A, dim, count, stride, ws);
+}
+
+template <typename T>
+inline void InvertCplxBatchInPlace(std::complex<T>* A, int dim, size_t count, size_t stride) {
+  CplxInvWorkspaceT<T> ws;
+  InvertCplxBatch(A, A, dim, count, stride, ws);
+}
+
+/*
+Batched InvertCplxChecked, same layout as InvertCplxBatch. flags[k] and rcond[k] receive the status
+and reciprocal condition number of matrix k (either may be 0). Returns the number of matrices
+flagged CPLX_INV_FAILED.
+*/
+inline size_t InvertCplxBatchChecked(const std::complex<double>* A, std::complex<double>* B, int dim, size_t count,
+  size_t stride, const CplxInvOptions& opt, int* flags, double* rcond, CplxInvWorkspace& ws) {
+  size_t failed = 0;
+  for (size_t k = 0; k < count; k++) {
+    const int f = InvertCplxChecked(CplxConstMatrixView(A + k * stride, dim), CplxMatrixView(B + k * stride, dim),
+      opt, ws, rcond ? rcond + k : 0);
+    if (flags)
+      flags[k] = f;
+    if (f & CPLX_INV_FAILED)
+      failed++;
   }
+  return failed;
+}
+
+inline size_t InvertCplxBatchChecked(const std::complex<double>* A, std::complex<double>* B, int dim, size_t count,
+  size_t stride, const CplxInvOptions& opt = CplxInvOptions(), int* flags = 0, double* rcond = 0) {
+  CplxInvWorkspace ws;
+  return InvertCplxBatchChecked(A, B, dim, count, stride, opt, flags, rcond, ws);
+}
+
+// det[k] = DetCplx of matrix k, layout as InvertCplxBatch; the size dispatch is done once per batch.
+template <typename T>
+inline void DetCplxBatch(const std::complex<T>* A, std::complex<T>* det, int dim, size_t count, size_t stride,
+  CplxInvWorkspaceT<T>& ws) {
+  typedef CplxRowMajorPtr<const std::complex<T> > In;
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_DET, dim, dim <= 8 ? CPLX_PATH_FIXED : CPLX_PATH_LAPACK, count);
+
+  switch (dim) {
+  case 1:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplx<1>(In(A + k * stride, 1));
+    break;
+  case 2:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplx<2>(In(A + k * stride, 2));
+    break;
+  case 3:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplx<3>(In(A + k * stride, 3));
+    break;
+  case 4:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplx<4>(In(A + k * stride, 4));
+    break;
+  case 5:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplx<5>(In(A + k * stride, 5));
+    break;
+  case 6:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplx<6>(In(A + k * stride, 6));
+    break;
+  case 7:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplx<7>(In(A + k * stride, 7));
+    break;
+  case 8:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplx<8>(In(A + k * stride, 8));
+    break;
+  default:
+    for (size_t k = 0; k < count; k++)
+      det[k] = DetCplxNxN(CplxMatrixViewT<const std::complex<T> >(A + k * stride, dim), ws);
+    break;
+  }
+}
+
+template <typename T>
+inline void DetCplxBatch(const std::complex<T>* A, std::complex<T>* det, int dim, size_t count, size_t stride) {
+  CplxInvWorkspaceT<T> ws;
+  DetCplxBatch(A, det, dim, count, stride, ws);
+}
+
+// logdet[k] = LogDetCplx of matrix k, layout as InvertCplxBatch.
+inline void LogDetCplxBatch(const std::complex<double>* A, std::complex<double>* logdet, int dim, size_t count,
+  size_t stride, CplxInvWorkspace& ws) {
+  typedef CplxRowMajorPtr<const std::complex<double> > In;
+  INVERSION_CPLX_PROBE(probe, CPLX_OP_LOGDET, dim, dim <= 8 ? CPLX_PATH_FIXED : CPLX_PATH_LAPACK, count);
+
+  switch (dim) {
+  case 1:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplx<1>(In(A + k * stride, 1));
+    break;
+  case 2:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplx<2>(In(A + k * stride, 2));
+    break;
+  case 3:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplx<3>(In(A + k * stride, 3));
+    break;
+  case 4:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplx<4>(In(A + k * stride, 4));
+    break;
+  case 5:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplx<5>(In(A + k * stride, 5));
+    break;
+  case 6:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplx<6>(In(A + k * stride, 6));
+    break;
+  case 7:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplx<7>(In(A + k * stride, 7));
+    break;
+  case 8:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplx<8>(In(A + k * stride, 8));
+    break;
+  default:
+    for (size_t k = 0; k < count; k++)
+      logdet[k] = LogDetCplxNxN(In(A + k * stride, dim), dim, ws);
+    break;
+  }
+}
+
+inline void LogDetCplxBatch(const std::complex<double>* A, std::complex<double>* logdet, int dim, size_t count,
+  size_t stride) {
+  CplxInvWorkspace ws;
+  LogDetCplxBatch(A, logdet, dim, count, stride, ws);
+}
+
+/*
+Batched SolveCplx / SolveHermCplx : matrix k is at A + k * stride (row-major, as InvertCplxBatch),
+its right-hand sides at b + k * rhsStride and the solution goes to x + k * rhsStride.
+info (optional, count entries) receives the per-matrix return value; the call returns the
+number of matrices that failed.
+*/
+inline size_t SolveCplxBatch(const std::complex<double>* A, const std::complex<double>* b, std::complex<double>* x,
+  int dim, int nrhs, size_t count, size_t stride, size_t rhsStride, bool herm, int* info, CplxInvWorkspace& ws) {
+  typedef CplxRowMajorPtr<const std::complex<double> > In;
+  size_t failed = 0;
+
+  for (size_t k = 0; k < count; k++) {
+    const In a(A + k * stride, dim);
+    const int r = herm ?
+      SolveHermCplx(a, b + k * rhsStride, x + k * rhsStride, dim, nrhs, ws) :
+      SolveCplx(a, b + k * rhsStride, x + k * rhsStride, dim, nrhs, ws);
+    if (info)
+      info[k] = r;
+    if (r)
+      failed++;
+  }
+  return failed;
+}
+
+inline size_t SolveCplxBatch(const std::complex<double>* A, const std::complex<double>* b, std::complex<double>* x,
+  int dim, int nrhs, size_t count, size_t stride, size_t rhsStride, bool herm = false, int* info = 0) {
+  CplxInvWorkspace ws;
+  return SolveCplxBatch(A, b, x, dim, nrhs, count, stride, rhsStride, herm, info, ws);
 }
 
 
-#endif
\ No newline at end of file
+#endif
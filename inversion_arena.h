@@ -0,0 +1,219 @@
+#ifndef _H_INVERSION_CPLX_ARENA_
+#define _H_INVERSION_CPLX_ARENA_
+/*
+Slab storage for per-bin matrix tensors.
+
+CplxArena is a bump allocator over one 64-byte aligned block : Alloc() is a pointer increment,
+Mark() / Rewind() and Reset() free everything after a point in O(1), and nothing is returned to
+the system before the arena is destroyed. With hugePages, the block is mmap'ed on Linux from
+hugetlbfs pages if any are reserved, else from ordinary pages advised for transparent huge pages,
+so a bins x N x N tensor set spans a few TLB entries. The block is zeroed by the constructing
+thread, which places its pages on that thread's NUMA node.
+
+CplxMatrixArena lays out in one such slab everything a frame of the row-pointer API needs :
+tensors x count matrices of dim x dim (each starting on a cache line, consecutive ones Stride()
+elements apart, so Data(t) also feeds the batch calls), the row-pointer table of every matrix,
+one CplxInvWorkspace per thread (the InvertCplxNxN scratch, in separate cache lines), and a frame
+area for per-frame temporaries released by ResetFrame().
+
+CplxThreadArena() is a lazily created per-thread CplxArena for scratch of calls that do not
+own one.
+*/
+#include "inversion.h"
+#include <cstdlib>
+#include <cstring>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#ifndef INVERSION_CPLX_THREAD_ARENA_BYTES
+#define INVERSION_CPLX_THREAD_ARENA_BYTES (1 << 20)
+#endif
+
+class CplxArena {
+public:
+  static const size_t Align = 64;
+
+  CplxArena() : base(0), raw(0), size(0), used(0), mapped(false) {}
+  explicit CplxArena(size_t bytes, bool hugePages = false) : base(0), raw(0), size(0), used(0), mapped(false) {
+    Init(bytes, hugePages);
+  }
+  ~CplxArena() { Release(); }
+
+  /*
+  (Re)allocates the block, invalidating everything handed out so far. Returns false (and leaves
+  the arena empty) if the allocation failed.
+  */
+  bool Init(size_t bytes, bool hugePages = false) {
+    Release();
+    bytes = Pad(bytes);
+    if (!bytes)
+      return true;
+#ifdef __linux__
+    if (hugePages) {
+      const size_t huge = (size_t)2 << 20;
+      const size_t len = (bytes + huge - 1) & ~(huge - 1);
+      void* p = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+      if (p == MAP_FAILED) {
+        p = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+#ifdef MADV_HUGEPAGE
+        if (p != MAP_FAILED)
+          madvise(p, len, MADV_HUGEPAGE);
+#endif
+      }
+      if (p != MAP_FAILED) {
+        raw = base = (char*)p;
+        size = len;
+        mapped = true;
+      }
+    }
+#else
+    (void)hugePages;
+#endif
+    if (!base) {
+      raw = (char*)std::malloc(bytes + Align);
+      if (!raw)
+        return false;
+      base = (char*)(((size_t)raw + Align) & ~(Align - 1));
+      size = bytes;
+    }
+    std::memset(base, 0, size);
+    return true;
+  }
+
+  // bytes rounded up to a cache line, 0 if the block is exhausted.
+  void* Alloc(size_t bytes) {
+    bytes = Pad(bytes);
+    if (bytes > size - used)
+      return 0;
+    void* p = base + used;
+    used += bytes;
+    return p;
+  }
+
+  template <typename T>
+  T* Alloc(size_t n) {
+    return (T*)Alloc(n * sizeof(T));
+  }
+
+  size_t Mark() const { return used; }
+  void Rewind(size_t mark) { used = mark; }
+  void Reset() { used = 0; }
+
+  size_t Used() const { return used; }
+  size_t Capacity() const { return size; }
+  bool HugePages() const { return mapped; }
+
+  static size_t Pad(size_t bytes) { return (bytes + Align - 1) & ~(Align - 1); }
+
+private:
+  CplxArena(const CplxArena&);
+  CplxArena& operator=(const CplxArena&);
+
+  void Release() {
+#ifdef __linux__
+    if (mapped)
+      munmap(raw, size);
+    else
+#endif
+      std::free(raw);
+    base = raw = 0;
+    size = used = 0;
+    mapped = false;
+  }
+
+  char* base;
+  char* raw;
+  size_t size;
+  size_t used;
+  bool mapped;
+};
+
+class CplxMatrixArena {
+public:
+  /*
+  tensors x count matrices of dim x dim, threads workspaces reserved for dim and dim x nrhs
+  right-hand sides, and frameBytes of frame area. Valid() is false if the slab could not be
+  allocated.
+  */
+  CplxMatrixArena(int dim_, size_t count_, int tensors_ = 2, int threads = 1, int nrhs = 1,
+    size_t frameBytes = 0, bool hugePages = false)
+    : dim(dim_), count(count_), tensors(tensors_),
+    stride(CplxArena::Pad((size_t)dim_ * dim_ * sizeof(std::complex<double>)) / sizeof(std::complex<double>)),
+    data(0), rows(0), frameMark(0)
+  {
+    const size_t matrices = (size_t)tensors * count;
+    const size_t wsBytes = CplxInvWorkspace::Bytes(dim, nrhs);
+    const size_t bytes = CplxArena::Pad(matrices * stride * sizeof(std::complex<double>))
+      + CplxArena::Pad(matrices * dim * sizeof(std::complex<double>*)) + threads * CplxArena::Pad(wsBytes)
+      + CplxArena::Pad(frameBytes);
+    if (!arena.Init(bytes, hugePages))
+      return;
+
+    data = arena.Alloc<std::complex<double> >(matrices * stride);
+    rows = arena.Alloc<std::complex<double>*>(matrices * dim);
+    for (size_t k = 0; k < matrices; k++)
+      for (int i = 0; i < dim; i++)
+        rows[k * dim + i] = data + k * stride + (size_t)i * dim;
+    for (int i = 0; i < threads; i++)
+      ws.push_back(CplxInvWorkspace(dim, nrhs, arena.Alloc(wsBytes)));
+    frameMark = arena.Mark();
+  }
+
+  bool Valid() const { return data != 0; }
+  int Dim() const { return dim; }
+  size_t Count() const { return count; }
+  int Tensors() const { return tensors; }
+  int Threads() const { return (int)ws.size(); }
+  bool HugePages() const { return arena.HugePages(); }
+
+  // Elements between consecutive matrices of a tensor (dim * dim rounded up to a cache line).
+  size_t Stride() const { return stride; }
+
+  // Tensor t, matrix k at Data(t) + k * Stride(), row-major with leading dimension dim.
+  std::complex<double>* Data(int t) { return data + (size_t)t * count * stride; }
+  std::complex<double>* Matrix(int t, size_t k) { return Data(t) + k * stride; }
+
+  // Row-pointer table of matrix k of tensor t, for the std::complex<double>** calls.
+  std::complex<double>** Rows(int t, size_t k) { return rows + ((size_t)t * count + k) * dim; }
+
+  CplxInvWorkspace& Workspace(int thread = 0) { return ws[thread]; }
+
+  // Frame-area temporaries, 0 once the frame area is exhausted.
+  void* FrameAlloc(size_t bytes) { return arena.Alloc(bytes); }
+  template <typename T>
+  T* FrameAlloc(size_t n) { return arena.Alloc<T>(n); }
+
+  // Releases every FrameAlloc() at once; the tensors, tables and workspaces are kept.
+  void ResetFrame() { arena.Rewind(frameMark); }
+
+private:
+  CplxMatrixArena(const CplxMatrixArena&);
+  CplxMatrixArena& operator=(const CplxMatrixArena&);
+
+  int dim;
+  size_t count;
+  int tensors;
+  size_t stride;
+  CplxArena arena;
+  std::complex<double>* data;
+  std::complex<double>** rows;
+  std::vector<CplxInvWorkspace> ws;
+  size_t frameMark;
+};
+
+/*
+Arena of the calling thread, created on first use with INVERSION_CPLX_THREAD_ARENA_BYTES (or
+minBytes if larger). A later call asking for more than the capacity re-creates it, which is only
+allowed while it is empty (Used() == 0), otherwise the call returns the arena as it is.
+*/
+inline CplxArena& CplxThreadArena(size_t minBytes = 0) {
+  static thread_local CplxArena arena;
+  if (arena.Capacity() < minBytes || !arena.Capacity()) {
+    if (!arena.Used())
+      arena.Init(minBytes > INVERSION_CPLX_THREAD_ARENA_BYTES ? minBytes : INVERSION_CPLX_THREAD_ARENA_BYTES);
+  }
+  return arena;
+}
+
+#endif
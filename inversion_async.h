@@ -0,0 +1,290 @@
+#ifndef _H_INVERSION_CPLX_ASYNC_
+#define _H_INVERSION_CPLX_ASYNC_
+/*
+Asynchronous per-frame inversion / solve for real-time callers.
+
+CplxAsyncInverter owns a few frame slots, each holding a batch of count dim x dim matrices (and
+dim x nrhs right-hand sides for a solver) plus its results. The real-time thread takes a free
+slot with Acquire(), fills it in place and Submit()s it; a dispatcher thread pops submitted slots
+from a lock-free ring (CplxJobRing) and runs them on a CplxBatchExecutor, in submission order.
+Latest() returns the results of the most recent completed frame, so when the current frame misses
+its deadline (Wait() with a time limit, or just not polling) the caller keeps the previous frame's
+inverse. None of Acquire / Submit / Wait / Latest locks, allocates or makes a system call; if
+every slot is busy, Acquire() returns -1 and that frame is dropped.
+
+Completion is signalled through the slot state, which Wait() / Latest() poll, and optionally a
+callback run on the dispatcher thread. (std::future is not offered : its shared state is heap
+allocated and mutex protected.) The dispatcher spins briefly when idle, then sleeps
+INVERSION_CPLX_ASYNC_IDLE_US between polls, so the producer never has to wake it.
+
+Acquire() and Submit() may be called from several threads; Latest() and Wait() from one.
+*/
+#include "inversion.h"
+#include "inversion_parallel.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#ifndef INVERSION_CPLX_ASYNC_IDLE_US
+#define INVERSION_CPLX_ASYNC_IDLE_US 50
+#endif
+
+/*
+Bounded lock-free multi-producer queue (per-cell sequence numbers, capacity rounded up to a power
+of two). TryPush / TryPop never block and fail when the ring is full / empty.
+*/
+template <typename T>
+class CplxJobRing {
+public:
+  explicit CplxJobRing(size_t capacity) : mask(0), head(0), tail(0) {
+    size_t n = 1;
+    while (n < capacity)
+      n <<= 1;
+    mask = n - 1;
+    cells = std::vector<Cell>(n);
+    for (size_t i = 0; i < n; i++)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  bool TryPush(const T& item) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& c = cells[pos & mask];
+      const size_t seq = c.seq.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          c.item = item;
+          c.seq.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = tail.load(std::memory_order_relaxed);
+    }
+  }
+
+  bool TryPop(T& item) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+      Cell& c = cells[pos & mask];
+      const size_t seq = c.seq.load(std::memory_order_acquire);
+      const intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          item = c.item;
+          c.seq.store(pos + mask + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0)
+        return false;
+      else
+        pos = head.load(std::memory_order_relaxed);
+    }
+  }
+
+private:
+  struct Cell {
+    std::atomic<size_t> seq;
+    T item;
+
+    Cell() : seq(0), item() {}
+    Cell(const Cell&) : seq(0), item() {}
+  };
+
+  std::vector<Cell> cells;
+  size_t mask;
+  // producers and the consumer update different cache lines
+  char pad0[64];
+  std::atomic<size_t> head;
+  char pad1[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> tail;
+  char pad2[64 - sizeof(std::atomic<size_t>)];
+};
+
+/*
+Runs on the dispatcher thread when frame (in slot) is done, before Latest() can see it, so it may
+read Output(slot); failed as returned by the batch call.
+*/
+typedef void (*CplxAsyncCallback)(void* user, uint64_t frame, int slot, size_t failed);
+
+class CplxAsyncInverter {
+public:
+  /*
+  count matrices of dim x dim per frame. nrhs = 0 inverts them (InvertCplxBatchChecked with opt);
+  nrhs > 0 solves A X = B for dim x nrhs right-hand sides (SolveCplxBatch, Cholesky first if herm).
+  threads : size of the executor behind the dispatcher (<= 0 : one per hardware thread).
+  slots >= 2 : one is held by Latest(), the others are in flight or being filled.
+  */
+  CplxAsyncInverter(int dim_, size_t count_, int nrhs_ = 0, int threads = 1, int slots = 3, bool herm_ = false,
+    const CplxInvOptions& opt_ = CplxInvOptions(), CplxAsyncCallback callback_ = 0, void* user_ = 0)
+    : dim(dim_), count(count_), nrhs(nrhs_), herm(herm_), opt(opt_), callback(callback_), user(user_),
+    slot(slots < 2 ? 2 : slots), ring(slots < 2 ? 2 : slots), front(-1), frontFrame(0), submitted(0),
+    pool(threads), quit(false)
+  {
+    const size_t in = (size_t)dim * dim * count, rhs = (size_t)dim * nrhs * count;
+    for (size_t s = 0; s < slot.size(); s++) {
+      slot[s].A.resize(in);
+      slot[s].B.resize(nrhs ? rhs : in);
+      slot[s].rhs.resize(rhs);
+      slot[s].state.store(SLOT_FREE, std::memory_order_relaxed);
+    }
+    dispatcher = std::thread(&CplxAsyncInverter::DispatchLoop, this);
+  }
+
+  ~CplxAsyncInverter() {
+    quit.store(true, std::memory_order_release);
+    dispatcher.join();
+  }
+
+  int Dim() const { return dim; }
+  size_t Count() const { return count; }
+  int Slots() const { return (int)slot.size(); }
+
+  // A free slot for the next frame, or -1 if all are in flight.
+  int Acquire() {
+    for (size_t s = 0; s < slot.size(); s++) {
+      int expected = SLOT_FREE;
+      if (slot[s].state.compare_exchange_strong(expected, SLOT_FILLING, std::memory_order_acquire))
+        return (int)s;
+    }
+    return -1;
+  }
+
+  // Matrices of an acquired slot, matrix k at Input(s) + k * dim * dim (row-major).
+  std::complex<double>* Input(int s) { return &slot[s].A[0]; }
+  // Right-hand sides (solver), matrix k at Rhs(s) + k * dim * nrhs.
+  std::complex<double>* Rhs(int s) { return &slot[s].rhs[0]; }
+
+  // Results of slot s, for the completion callback.
+  const std::complex<double>* Output(int s) const { return &slot[s].B[0]; }
+
+  // Queues an acquired, filled slot. Returns its frame number (1, 2, ...).
+  uint64_t Submit(int s) {
+    const uint64_t frame = submitted.fetch_add(1, std::memory_order_relaxed) + 1;
+    slot[s].frame = frame;
+    slot[s].state.store(SLOT_QUEUED, std::memory_order_release);
+    // the ring holds every slot, so a push cannot fail
+    ring.TryPush(s);
+    return frame;
+  }
+
+  /*
+  Results of the most recent completed frame (inverses, or X laid out as Rhs()), stable until the
+  next Latest() / Wait() call; 0 before the first frame completes. frame and failed (optional)
+  receive its frame number and the failure count of its batch call.
+  */
+  const std::complex<double>* Latest(uint64_t* frame = 0, size_t* failed = 0) {
+    int best = front;
+    uint64_t bestFrame = frontFrame;
+    for (size_t s = 0; s < slot.size(); s++)
+      if (slot[s].state.load(std::memory_order_acquire) == SLOT_DONE && slot[s].frame > bestFrame) {
+        best = (int)s;
+        bestFrame = slot[s].frame;
+      }
+    if (best != front) {
+      if (front >= 0)
+        slot[front].state.store(SLOT_FREE, std::memory_order_release);
+      front = best;
+      frontFrame = bestFrame;
+      slot[front].state.store(SLOT_FRONT, std::memory_order_relaxed);
+    }
+    // frames overtaken by a newer result are not needed any more
+    for (size_t s = 0; s < slot.size(); s++)
+      if (slot[s].state.load(std::memory_order_acquire) == SLOT_DONE && slot[s].frame < frontFrame)
+        slot[s].state.store(SLOT_FREE, std::memory_order_release);
+
+    if (front < 0)
+      return 0;
+    if (frame)
+      *frame = frontFrame;
+    if (failed)
+      *failed = slot[front].failed;
+    return &slot[front].B[0];
+  }
+
+  /*
+  Spins until submitted slot s is done or deadline passes, then returns Latest() : the results of
+  s, or the previous frame's if s missed the deadline (compare *frame with Submit()'s return).
+  */
+  const std::complex<double>* Wait(int s, std::chrono::steady_clock::time_point deadline, uint64_t* frame = 0,
+    size_t* failed = 0) {
+    for (;;) {
+      const int state = slot[s].state.load(std::memory_order_acquire);
+      if ((state != SLOT_QUEUED && state != SLOT_BUSY) || std::chrono::steady_clock::now() >= deadline)
+        break;
+    }
+    return Latest(frame, failed);
+  }
+
+private:
+  enum {
+    SLOT_FREE,
+    SLOT_FILLING,
+    SLOT_QUEUED,
+    SLOT_BUSY,
+    SLOT_DONE,
+    SLOT_FRONT
+  };
+
+  struct Slot {
+    std::vector<std::complex<double> > A;
+    std::vector<std::complex<double> > B;
+    std::vector<std::complex<double> > rhs;
+    uint64_t frame;
+    size_t failed;
+    std::atomic<int> state;
+
+    Slot() : frame(0), failed(0), state(SLOT_FREE) {}
+    Slot(const Slot&) : frame(0), failed(0), state(SLOT_FREE) {}
+  };
+
+  void DispatchLoop() {
+    int idle = 0;
+    while (!quit.load(std::memory_order_acquire)) {
+      int s;
+      if (!ring.TryPop(s)) {
+        if (++idle < 256)
+          std::this_thread::yield();
+        else
+          std::this_thread::sleep_for(std::chrono::microseconds(INVERSION_CPLX_ASYNC_IDLE_US));
+        continue;
+      }
+      idle = 0;
+      Slot& job = slot[s];
+      job.state.store(SLOT_BUSY, std::memory_order_relaxed);
+      const size_t nn = (size_t)dim * dim;
+      if (nrhs)
+        job.failed = pool.SolveBatch(&job.A[0], &job.rhs[0], &job.B[0], dim, nrhs, count, nn, (size_t)dim * nrhs, herm);
+      else
+        job.failed = pool.InvertBatchChecked(&job.A[0], &job.B[0], dim, count, nn, opt);
+      if (callback)
+        callback(user, job.frame, s, job.failed);
+      job.state.store(SLOT_DONE, std::memory_order_release);
+    }
+  }
+
+  int dim;
+  size_t count;
+  int nrhs;
+  bool herm;
+  CplxInvOptions opt;
+  CplxAsyncCallback callback;
+  void* user;
+  std::vector<Slot> slot;
+  CplxJobRing<int> ring;
+  // owned by the Latest() / Wait() thread
+  int front;
+  uint64_t frontFrame;
+  std::atomic<uint64_t> submitted;
+  CplxBatchExecutor pool;
+  std::atomic<bool> quit;
+  std::thread dispatcher;
+};
+
+#endif
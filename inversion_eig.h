@@ -0,0 +1,354 @@
+#ifndef _H_INVERSION_CPLX_EIG_
+#define _H_INVERSION_CPLX_EIG_
+/*
+Eigendecomposition of small Hermitian matrices, A = V diag(w) V^H, and of Hermitian-definite
+pencils Rs v = w Rn v (GEV beamformer : the principal eigenvector of inv(Rn) Rs; MUSIC : the
+noise subspace of Rs).
+
+Sizes up to 8 run a cyclic complex Jacobi on a local copy : every rotation zeroes one off-diagonal
+pair, so 2x2 is done in closed form by its single rotation, and larger sizes converge in a few
+sweeps. The kernel works on CplxPack<V>, so inversion_simd.h runs it on W matrices of a SoA batch
+at once (EigHermCplxBatchSoA). One matrix at a time the Jacobi only beats zheev up to 4x4, so the
+runtime-dim calls take it that far and go to zheev / zhegv beyond; the SoA batch keeps it to 8x8.
+
+Only the lower triangle of A (Rs, Rn) is read. w is ascending, column j of V is the eigenvector
+of w[j], so the principal one is column dim - 1. The eigenvectors of a pencil are Rn-orthonormal
+(V^H Rn V = I), as zhegv returns them.
+*/
+#include "inversion.h"
+
+#ifndef INVERSION_CPLX_JACOBI_SWEEPS
+#define INVERSION_CPLX_JACOBI_SWEEPS 16
+#endif
+
+inline void CplxSqrt(double& r, const double& x) {
+  r = std::sqrt(x);
+}
+
+// lane by lane for the GCC vector types of inversion_simd.h
+template <typename V>
+inline void CplxSqrt(V& r, const V& x) {
+  V t = V();
+  for (size_t l = 0; l < sizeof(V) / sizeof(double); l++)
+    t[l] = std::sqrt(x[l]);
+  r = t;
+}
+
+// Number of lanes with x > lim (or NaN).
+inline int CplxLanesAbove(const double& x, const double& lim) {
+  return x <= lim ? 0 : 1;
+}
+
+template <typename V>
+inline int CplxLanesAbove(const V& x, const V& lim) {
+  int n = 0;
+  for (size_t l = 0; l < sizeof(V) / sizeof(double); l++)
+    if (!(x[l] <= lim[l]))
+      n++;
+  return n;
+}
+
+/*
+Cyclic Jacobi on a full Hermitian a (both triangles set). On return the real parts of the
+diagonal of a are the eigenvalues (unsorted) and v holds the eigenvectors in its columns.
+Rotation (p,q) is J = diag(1, conj(e)) R with e = a_pq / |a_pq| and R the real Jacobi rotation of
+[a_pp |a_pq|; |a_pq| a_qq]; a zero a_pq gives J = I, without a branch, so all lanes of V take the
+same path. Returns the number of lanes that are not diagonal to working precision after
+INVERSION_CPLX_JACOBI_SWEEPS sweeps, 0 normally.
+*/
+template <int N, typename V>
+inline int CplxJacobiHerm(CplxPack<V> (&a)[N][N], CplxPack<V> (&v)[N][N]) {
+  typedef CplxPack<V> P;
+  const V zero = V(), one = zero + 1.0;
+  const double eps = std::numeric_limits<double>::epsilon();
+
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++)
+      v[i][j] = P(i == j ? 1.0 : 0.0);
+
+  for (int sweep = 0;; sweep++) {
+    V off = zero, diag = zero;
+    for (int p = 0; p < N; p++) {
+      diag += a[p][p].re * a[p][p].re;
+      for (int q = p + 1; q < N; q++)
+        off += a[p][q].re * a[p][q].re + a[p][q].im * a[p][q].im;
+    }
+    // the 2x2 rotation below is exact, one pass is the closed form
+    if (N == 2 && sweep == 1)
+      return 0;
+    const int above = CplxLanesAbove(off, V(diag * (eps * eps)));
+    if (!above || sweep == INVERSION_CPLX_JACOBI_SWEEPS)
+      return above;
+
+    for (int p = 0; p < N - 1; p++)
+      for (int q = p + 1; q < N; q++) {
+        const V g2 = a[p][q].re * a[p][q].re + a[p][q].im * a[p][q].im;
+        V g = V();
+        CplxSqrt(g, g2);
+        const auto nz = g2 > zero;
+        const V gs = nz ? g : one;
+        const V er = nz ? V(a[p][q].re / gs) : one;
+        const V ei = nz ? V(a[p][q].im / gs) : zero;
+
+        const V tau = (a[q][q].re - a[p][p].re) / (2.0 * gs);
+        V root = V();
+        CplxSqrt(root, V(one + tau * tau));
+        V t = (tau >= zero ? one : -one) / ((tau >= zero ? tau : -tau) + root);
+        t = nz ? t : zero;
+        V c = V();
+        CplxSqrt(c, V(one + t * t));
+        c = one / c;
+        const V s = t * c;
+
+        // J = [c, s; -s conj(e), c conj(e)], A <- J^H A J, V <- V J
+        const P jpp(c, zero), jpq(s, zero), jqp(-s * er, s * ei), jqq(c * er, -c * ei);
+        const P cpp(c, zero), cpq(s, zero), cqp(-s * er, -s * ei), cqq(c * er, c * ei);
+        for (int k = 0; k < N; k++) {
+          const P akp = a[k][p], akq = a[k][q];
+          a[k][p] = akp * jpp + akq * jqp;
+          a[k][q] = akp * jpq + akq * jqq;
+          const P vkp = v[k][p], vkq = v[k][q];
+          v[k][p] = vkp * jpp + vkq * jqp;
+          v[k][q] = vkp * jpq + vkq * jqq;
+        }
+        for (int k = 0; k < N; k++) {
+          const P apk = a[p][k], aqk = a[q][k];
+          a[p][k] = cpp * apk + cqp * aqk;
+          a[q][k] = cpq * apk + cqq * aqk;
+        }
+        a[p][q] = a[q][p] = P(0.0);
+        a[p][p].im = a[q][q].im = zero;
+      }
+  }
+}
+
+// Sorts w ascending and the columns of V (an accessor) along with it.
+template <typename MT>
+inline void SortEigHermCplx(double* w, MT V, int n) {
+  for (int i = 0; i < n - 1; i++) {
+    int m = i;
+    for (int j = i + 1; j < n; j++)
+      if (w[j] < w[m])
+        m = j;
+    if (m != i) {
+      std::swap(w[i], w[m]);
+      for (int k = 0; k < n; k++)
+        std::swap(V[k][i], V[k][m]);
+    }
+  }
+}
+
+/*
+Fixed-size A = V diag(w) V^H, N = 1..8. V may be A itself.
+Returns 0, or 1 if the sweeps did not converge (w and V then hold the last iterate).
+*/
+template <int N, typename MT1, typename MT2>
+inline int EigHermCplx(MT1 A, double* w, MT2 V) {
+  CplxPack<double> a[N][N], v[N][N];
+  for (int j = 0; j < N; j++)
+    for (int i = j; i < N; i++) {
+      const std::complex<double> x(A[i][j]);
+      a[i][j] = CplxPack<double>(x.real(), i == j ? 0.0 : x.imag());
+      a[j][i] = CplxPack<double>(x.real(), i == j ? 0.0 : -x.imag());
+    }
+
+  const int unconverged = CplxJacobiHerm<N>(a, v);
+
+  for (int i = 0; i < N; i++) {
+    w[i] = a[i][i].re;
+    for (int j = 0; j < N; j++)
+      V[i][j] = std::complex<double>(v[i][j].re, v[i][j].im);
+  }
+  SortEigHermCplx(w, V, N);
+  return unconverged ? 1 : 0;
+}
+
+// zheev on the lower triangle, in the workspace matrix (column-major).
+template <typename MT1, typename MT2>
+inline int EigHermCplxNxN(MT1 A, double* w, MT2 V, int n, CplxInvWorkspace& ws) {
+  ws.ReserveMatrix(n);
+  std::complex<double>* tmat = ws.Matrix();
+
+  for (int j = 0; j < n; j++)
+    for (int i = j; i < n; i++)
+      tmat[i + j * n] = A[i][j];
+
+  const lapack_int info = LAPACKE_zheev(LAPACK_COL_MAJOR, 'V', 'L', n, tmat, n, w);
+  if (info)
+    return info;
+
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      V[i][j] = tmat[i + j * n];
+  return 0;
+}
+
+template <typename MT1, typename MT2>
+inline int EigHermCplx(MT1 A, double* w, MT2 V, int dim, CplxInvWorkspace& ws) {
+  switch (dim) {
+  case 1: return EigHermCplx<1>(A, w, V);
+  case 2: return EigHermCplx<2>(A, w, V);
+  case 3: return EigHermCplx<3>(A, w, V);
+  case 4: return EigHermCplx<4>(A, w, V);
+  default: return EigHermCplxNxN(A, w, V, dim, ws);
+  }
+}
+
+template <typename MT1, typename MT2>
+inline int EigHermCplx(MT1 A, double* w, MT2 V, int dim) {
+  CplxInvWorkspace ws;
+  return EigHermCplx(A, w, V, dim, ws);
+}
+
+/*
+Fixed-size pencil Rs v = w Rn v, Rn positive definite, N = 1..8. With the Cholesky factor
+Rn = L L^H of CplxHermFixed, C = inv(L) Rs inv(L)^H is Hermitian with the same eigenvalues, and
+v = inv(L)^H u for its eigenvectors u. Returns 0, k > 0 if the leading k x k minor of Rn is not
+positive definite (w and V untouched), or N + 1 if the sweeps did not converge.
+*/
+template <int N, typename MT1, typename MT2, typename MT3>
+inline int EigGenHermCplx(MT1 Rs, MT2 Rn, double* w, MT3 V) {
+  std::complex<double> L[N][N], c[N][N];
+  double d[N];
+  const int info = CplxHermFixed<N>::Factor(Rn, L, d);
+  if (info)
+    return info;
+
+  // c = inv(L) Rs, column by column (forward substitution), on the full Rs
+  for (int j = 0; j < N; j++)
+    for (int i = 0; i < N; i++) {
+      std::complex<double> t(i >= j ? std::complex<double>(Rs[i][j]) : std::conj(std::complex<double>(Rs[j][i])));
+      for (int k = 0; k < i; k++)
+        t -= L[i][k] * c[k][j];
+      c[i][j] = t * d[i];
+    }
+  // C = c inv(L)^H = (inv(L) c^H)^H, lower triangle only
+  CplxPack<double> a[N][N], u[N][N];
+  std::complex<double> y[N];
+  for (int r = 0; r < N; r++) {
+    // y = inv(L) conj(row r of c)
+    for (int i = 0; i < N; i++) {
+      std::complex<double> t(std::conj(c[r][i]));
+      for (int k = 0; k < i; k++)
+        t -= L[i][k] * y[k];
+      y[i] = t * d[i];
+    }
+    for (int i = r; i < N; i++) {
+      const std::complex<double> x(y[i]);
+      a[i][r] = CplxPack<double>(x.real(), i == r ? 0.0 : x.imag());
+      a[r][i] = CplxPack<double>(x.real(), i == r ? 0.0 : -x.imag());
+    }
+  }
+
+  const int unconverged = CplxJacobiHerm<N>(a, u);
+
+  // v = inv(L)^H u, back substitution on each column
+  for (int j = 0; j < N; j++) {
+    w[j] = a[j][j].re;
+    for (int i = N - 1; i >= 0; i--) {
+      std::complex<double> t(u[i][j].re, u[i][j].im);
+      for (int k = i + 1; k < N; k++)
+        t -= std::conj(L[k][i]) * y[k];
+      y[i] = t * d[i];
+    }
+    for (int i = 0; i < N; i++)
+      V[i][j] = y[i];
+  }
+  SortEigHermCplx(w, V, N);
+  return unconverged ? N + 1 : 0;
+}
+
+// zhegv (itype 1) on the lower triangles, Rs in the workspace matrix and Rn in its right-hand-side buffer.
+template <typename MT1, typename MT2, typename MT3>
+inline int EigGenHermCplxNxN(MT1 Rs, MT2 Rn, double* w, MT3 V, int n, CplxInvWorkspace& ws) {
+  ws.ReserveMatrix(n);
+  ws.ReserveRhs(n, n);
+  std::complex<double>* ts = ws.Matrix();
+  std::complex<double>* tn = ws.Rhs();
+
+  for (int j = 0; j < n; j++)
+    for (int i = j; i < n; i++) {
+      ts[i + j * n] = Rs[i][j];
+      tn[i + j * n] = Rn[i][j];
+    }
+
+  // info > n : the leading (info - n) minor of Rn is not positive definite
+  const lapack_int info = LAPACKE_zhegv(LAPACK_COL_MAJOR, 1, 'V', 'L', n, ts, n, tn, n, w);
+  if (info)
+    return info > n ? info - n : n + 1;
+
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      V[i][j] = ts[i + j * n];
+  return 0;
+}
+
+template <typename MT1, typename MT2, typename MT3>
+inline int EigGenHermCplx(MT1 Rs, MT2 Rn, double* w, MT3 V, int dim, CplxInvWorkspace& ws) {
+  switch (dim) {
+  case 1: return EigGenHermCplx<1>(Rs, Rn, w, V);
+  case 2: return EigGenHermCplx<2>(Rs, Rn, w, V);
+  case 3: return EigGenHermCplx<3>(Rs, Rn, w, V);
+  case 4: return EigGenHermCplx<4>(Rs, Rn, w, V);
+  default: return EigGenHermCplxNxN(Rs, Rn, w, V, dim, ws);
+  }
+}
+
+template <typename MT1, typename MT2, typename MT3>
+inline int EigGenHermCplx(MT1 Rs, MT2 Rn, double* w, MT3 V, int dim) {
+  CplxInvWorkspace ws;
+  return EigGenHermCplx(Rs, Rn, w, V, dim, ws);
+}
+
+/*
+Batched EigHermCplx : matrix k at A + k * stride (row-major, as InvertCplxBatch), its eigenvalues
+at w + k * dim and its eigenvectors at V + k * stride. info (optional, count entries) receives the
+per-matrix return value; the call returns the number of matrices that failed.
+*/
+inline size_t EigHermCplxBatch(const std::complex<double>* A, double* w, std::complex<double>* V, int dim,
+  size_t count, size_t stride, int* info, CplxInvWorkspace& ws) {
+  typedef CplxRowMajorPtr<const std::complex<double> > In;
+  typedef CplxRowMajorPtr<std::complex<double> > Out;
+  size_t failed = 0;
+
+  for (size_t k = 0; k < count; k++) {
+    const int r = EigHermCplx(In(A + k * stride, dim), w + k * dim, Out(V + k * stride, dim), dim, ws);
+    if (info)
+      info[k] = r;
+    if (r)
+      failed++;
+  }
+  return failed;
+}
+
+inline size_t EigHermCplxBatch(const std::complex<double>* A, double* w, std::complex<double>* V, int dim,
+  size_t count, size_t stride, int* info = 0) {
+  CplxInvWorkspace ws;
+  return EigHermCplxBatch(A, w, V, dim, count, stride, info, ws);
+}
+
+// Batched EigGenHermCplx, Rs and Rn laid out as A of EigHermCplxBatch.
+inline size_t EigGenHermCplxBatch(const std::complex<double>* Rs, const std::complex<double>* Rn, double* w,
+  std::complex<double>* V, int dim, size_t count, size_t stride, int* info, CplxInvWorkspace& ws) {
+  typedef CplxRowMajorPtr<const std::complex<double> > In;
+  typedef CplxRowMajorPtr<std::complex<double> > Out;
+  size_t failed = 0;
+
+  for (size_t k = 0; k < count; k++) {
+    const int r = EigGenHermCplx(In(Rs + k * stride, dim), In(Rn + k * stride, dim), w + k * dim,
+      Out(V + k * stride, dim), dim, ws);
+    if (info)
+      info[k] = r;
+    if (r)
+      failed++;
+  }
+  return failed;
+}
+
+inline size_t EigGenHermCplxBatch(const std::complex<double>* Rs, const std::complex<double>* Rn, double* w,
+  std::complex<double>* V, int dim, size_t count, size_t stride, int* info = 0) {
+  CplxInvWorkspace ws;
+  return EigGenHermCplxBatch(Rs, Rn, w, V, dim, count, stride, info, ws);
+}
+
+#endif
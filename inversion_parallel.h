@@ -0,0 +1,307 @@
+#ifndef _H_INVERSION_CPLX_PARALLEL_
+#define _H_INVERSION_CPLX_PARALLEL_
+/*
+Parallel batch executor over a persistent thread pool.
+
+The pool is created once; each call splits [0, count) into one contiguous range per thread,
+and a thread that finishes its own range steals chunks from the others, so uneven matrices
+(e.g. NaN bins, LAPACK fallbacks) do not leave cores idle. The calling thread takes part as
+worker 0. Every worker owns a CplxInvWorkspace, so the LAPACK path does not allocate per call.
+Calls from several threads are serialized.
+*/
+#include "inversion.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+class CplxBatchExecutor {
+public:
+  /*
+  threads <= 0 : one per hardware thread. cpus : pool thread i (i >= 1) is pinned to
+  cpus[i % cpus.size()]. The calling thread (worker 0) keeps its affinity unless PinCaller() is called.
+  */
+  explicit CplxBatchExecutor(int threads = 0, const std::vector<int>& cpus = std::vector<int>())
+    : nthreads(threads > 0 ? threads : (int)std::thread::hardware_concurrency()),
+    generation(0), pending(0), quit(false), job(0), ctx(0), grain(1), failed(0)
+  {
+    if (nthreads < 1)
+      nthreads = 1;
+    ranges = std::vector<Range>(nthreads);
+    ws = std::vector<CplxInvWorkspace>(nthreads);
+    affinity = cpus;
+    for (int i = 1; i < nthreads; i++)
+      workers.push_back(std::thread(&CplxBatchExecutor::WorkerLoop, this, i));
+  }
+
+  ~CplxBatchExecutor() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      quit = true;
+    }
+    wake.notify_all();
+    for (size_t i = 0; i < workers.size(); i++)
+      workers[i].join();
+  }
+
+  int Threads() const { return nthreads; }
+
+  // Pins the calling thread to cpus[0], the slot of worker 0. No-op without cpus.
+  void PinCaller() {
+    if (!affinity.empty())
+      Pin(0);
+  }
+
+  // Runs fn(begin, end, worker) over chunks of at most grain_ items covering [0, count).
+  template <typename F>
+  void ParallelFor(size_t count, size_t grain_, F& fn) {
+    std::lock_guard<std::mutex> serial(callMtx);
+    Dispatch(count, grain_, fn);
+  }
+
+  void InvertBatch(const std::complex<double>* A, std::complex<double>* B, int dim, size_t count, size_t stride) {
+    std::lock_guard<std::mutex> serial(callMtx);
+    InvertTask t = { A, B, dim, stride, this };
+    ReserveAll(dim);
+    Dispatch(count, GrainFor(dim), t);
+  }
+
+  void DetBatch(const std::complex<double>* A, std::complex<double>* det, int dim, size_t count, size_t stride) {
+    std::lock_guard<std::mutex> serial(callMtx);
+    DetTask t = { A, det, dim, stride, this };
+    ReserveAll(dim);
+    Dispatch(count, GrainFor(dim), t);
+  }
+
+  void LogDetBatch(const std::complex<double>* A, std::complex<double>* logdet, int dim, size_t count, size_t stride) {
+    std::lock_guard<std::mutex> serial(callMtx);
+    LogDetTask t = { A, logdet, dim, stride, this };
+    ReserveAll(dim);
+    Dispatch(count, GrainFor(dim), t);
+  }
+
+  // InvertCplxBatchChecked split across the pool; returns the number of failed matrices.
+  size_t InvertBatchChecked(const std::complex<double>* A, std::complex<double>* B, int dim, size_t count,
+    size_t stride, const CplxInvOptions& opt = CplxInvOptions(), int* flags = 0, double* rcond = 0) {
+    std::lock_guard<std::mutex> serial(callMtx);
+    CheckedTask t = { A, B, dim, stride, &opt, flags, rcond, this };
+    ReserveAll(dim);
+    for (int i = 0; i < nthreads; i++)
+      ws[i].ReserveRhs(dim, dim);
+    failed = 0;
+    Dispatch(count, GrainFor(dim), t);
+    return failed;
+  }
+
+  // SolveCplxBatch split across the pool; returns the number of failed matrices.
+  size_t SolveBatch(const std::complex<double>* A, const std::complex<double>* b, std::complex<double>* x,
+    int dim, int nrhs, size_t count, size_t stride, size_t rhsStride, bool herm = false, int* info = 0) {
+    std::lock_guard<std::mutex> serial(callMtx);
+    SolveTask t = { A, b, x, dim, nrhs, stride, rhsStride, herm, info, this };
+    ReserveAll(dim);
+    for (int i = 0; i < nthreads; i++)
+      ws[i].ReserveRhs(dim, nrhs);
+    failed = 0;
+    Dispatch(count, GrainFor(dim), t);
+    return failed;
+  }
+
+private:
+  struct Range {
+    std::atomic<size_t> next;
+    size_t end;
+    char pad[64 - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+    Range() : next(0), end(0) {}
+    Range(const Range&) : next(0), end(0) {}
+  };
+
+  typedef void (*JobFn)(void*, size_t, size_t, int);
+
+  template <typename F>
+  static void Trampoline(void* c, size_t b, size_t e, int w) { (*static_cast<F*>(c))(b, e, w); }
+
+  // Every public call holds callMtx around its whole body (workspace reservation, the shared
+  // failure count and the run itself), so Run() and Dispatch() take no lock of their own.
+  template <typename F>
+  void Dispatch(size_t count, size_t grain_, F& fn) {
+    Run(count, grain_, &Trampoline<F>, &fn);
+  }
+
+  struct InvertTask {
+    const std::complex<double>* A;
+    std::complex<double>* B;
+    int dim;
+    size_t stride;
+    CplxBatchExecutor* ex;
+    void operator()(size_t b, size_t e, int w) {
+      InvertCplxBatch(A + b * stride, B + b * stride, dim, e - b, stride, ex->ws[w]);
+    }
+  };
+
+  struct DetTask {
+    const std::complex<double>* A;
+    std::complex<double>* det;
+    int dim;
+    size_t stride;
+    CplxBatchExecutor* ex;
+    void operator()(size_t b, size_t e, int w) {
+      DetCplxBatch(A + b * stride, det + b, dim, e - b, stride, ex->ws[w]);
+    }
+  };
+
+  struct LogDetTask {
+    const std::complex<double>* A;
+    std::complex<double>* logdet;
+    int dim;
+    size_t stride;
+    CplxBatchExecutor* ex;
+    void operator()(size_t b, size_t e, int w) {
+      LogDetCplxBatch(A + b * stride, logdet + b, dim, e - b, stride, ex->ws[w]);
+    }
+  };
+
+  struct CheckedTask {
+    const std::complex<double>* A;
+    std::complex<double>* B;
+    int dim;
+    size_t stride;
+    const CplxInvOptions* opt;
+    int* flags;
+    double* rcond;
+    CplxBatchExecutor* ex;
+    void operator()(size_t b, size_t e, int w) {
+      const size_t f = InvertCplxBatchChecked(A + b * stride, B + b * stride, dim, e - b, stride, *opt,
+        flags ? flags + b : 0, rcond ? rcond + b : 0, ex->ws[w]);
+      if (f)
+        ex->failed += f;
+    }
+  };
+
+  struct SolveTask {
+    const std::complex<double>* A;
+    const std::complex<double>* b;
+    std::complex<double>* x;
+    int dim, nrhs;
+    size_t stride, rhsStride;
+    bool herm;
+    int* info;
+    CplxBatchExecutor* ex;
+    void operator()(size_t lo, size_t hi, int w) {
+      const size_t f = SolveCplxBatch(A + lo * stride, b + lo * rhsStride, x + lo * rhsStride, dim, nrhs, hi - lo,
+        stride, rhsStride, herm, info ? info + lo : 0, ex->ws[w]);
+      if (f)
+        ex->failed += f;
+    }
+  };
+
+  // Small matrices are cheap, hand them out in larger chunks to keep stealing overhead low.
+  static size_t GrainFor(int dim) {
+    return dim <= 4 ? 64 : (dim <= 8 ? 16 : 1);
+  }
+
+  void ReserveAll(int dim) {
+    if (dim > 8)
+      for (int i = 0; i < nthreads; i++)
+        ws[i].Reserve(dim);
+  }
+
+  void Pin(int w) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(affinity[w % affinity.size()], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+    (void)w;
+#endif
+  }
+
+  void Run(size_t count, size_t grain_, JobFn fn, void* c) {
+    if (count == 0)
+      return;
+
+    grain = grain_ ? grain_ : 1;
+    const size_t per = (count + nthreads - 1) / nthreads;
+    for (int i = 0; i < nthreads; i++) {
+      const size_t b = per * i < count ? per * i : count;
+      ranges[i].end = b + per < count ? b + per : count;
+      ranges[i].next.store(b, std::memory_order_relaxed);
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      job = fn;
+      ctx = c;
+      pending = nthreads - 1;
+      generation++;
+    }
+    wake.notify_all();
+
+    Work(0);
+
+    std::unique_lock<std::mutex> lock(mtx);
+    done.wait(lock, [this] { return pending == 0; });
+  }
+
+  // Own range first, then steal from the others.
+  void Work(int w) {
+    for (int v = 0; v < nthreads; v++) {
+      Range& r = ranges[(w + v) % nthreads];
+      for (;;) {
+        const size_t b = r.next.fetch_add(grain, std::memory_order_relaxed);
+        if (b >= r.end)
+          break;
+        const size_t e = b + grain < r.end ? b + grain : r.end;
+        job(ctx, b, e, w);
+      }
+    }
+  }
+
+  void WorkerLoop(int w) {
+    if (!affinity.empty())
+      Pin(w);
+    unsigned long seen = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        wake.wait(lock, [&] { return quit || generation != seen; });
+        if (quit)
+          return;
+        seen = generation;
+      }
+      Work(w);
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (--pending == 0)
+          done.notify_one();
+      }
+    }
+  }
+
+  int nthreads;
+  std::vector<std::thread> workers;
+  std::vector<Range> ranges;
+  std::vector<CplxInvWorkspace> ws;
+  std::vector<int> affinity;
+
+  std::mutex callMtx;
+  std::mutex mtx;
+  std::condition_variable wake;
+  std::condition_variable done;
+  unsigned long generation;
+  int pending;
+  bool quit;
+
+  JobFn job;
+  void* ctx;
+  size_t grain;
+  std::atomic<size_t> failed;
+};
+
+#endif
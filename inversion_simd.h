@@ -0,0 +1,448 @@
+#ifndef _H_INVERSION_CPLX_SIMD_
+#define _H_INVERSION_CPLX_SIMD_
+/*
+Structure-of-arrays batched inversion and determinants for 1x1 - 6x6, and Hermitian
+eigendecomposition for 1x1 - 8x8 (EigHermCplxBatchSoA).
+
+Layout : the real and imaginary parts live in separate planes. Element (i,j) of matrix m
+is stored at re[(i * dim + j) * ld + m] and im[(i * dim + j) * ld + m], with ld >= count,
+so each element of all matrices in the batch is one contiguous run.
+
+The fixed-size kernels of inversion.h are reused as they are : they run on CplxPack
+(inversion.h), which here holds one element of W matrices (W = 2/4/8 lanes for SSE2/AVX2/AVX-512).
+The instruction set is picked at runtime, so a single binary runs on any x86-64.
+*/
+#include "inversion.h"
+#include "inversion_eig.h"
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INVERSION_CPLX_SIMD_X86
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+typedef double CplxSimd2d __attribute__((vector_size(16)));
+typedef double CplxSimd4d __attribute__((vector_size(32)));
+typedef double CplxSimd8d __attribute__((vector_size(64)));
+#endif
+
+enum CplxSimdLevel {
+  CPLX_SIMD_SCALAR = 0,
+  CPLX_SIMD_SSE2,
+  CPLX_SIMD_AVX2,
+  CPLX_SIMD_AVX512
+};
+
+/*
+Redoes lane l of the packed matrices ap (SoA matrix m) with the std::complex kernels (scaled
+complex division), writing the same outputs as CplxSoARange. A is taken from ap, not re-read from
+memory, as B may already have overwritten it in place. Returns false if det or the inverse is
+still not finite (singular or non-finite A, or det out of range).
+*/
+template <int N, typename V>
+inline bool CplxSoARedo(const CplxPack<V> (&ap)[N][N], size_t l, double* Bre, double* Bim,
+  double* detRe, double* detIm, size_t ld, size_t m)
+{
+  const size_t W = sizeof(V) / sizeof(double);
+  std::complex<double> a[N][N], b[N][N], det;
+  for (int i = 0; i < N; i++)
+    for (int j = 0; j < N; j++) {
+      double re[W], im[W];
+      memcpy(re, &ap[i][j].re, sizeof(V));
+      memcpy(im, &ap[i][j].im, sizeof(V));
+      a[i][j] = std::complex<double>(re[l], im[l]);
+    }
+
+  det = Bre ? InvertAndDetCplx<N>(a, b) : DetCplx<N>(a);
+
+  // an infinite det leaves a finite but zero inverse
+  bool finite = std::isfinite(det.real()) && std::isfinite(det.imag());
+  if (Bre)
+    for (int i = 0; i < N; i++)
+      for (int j = 0; j < N; j++) {
+        Bre[(i * N + j) * ld + m] = b[i][j].real();
+        Bim[(i * N + j) * ld + m] = b[i][j].imag();
+        finite = finite && std::isfinite(b[i][j].real()) && std::isfinite(b[i][j].imag());
+      }
+  if (detRe) {
+    detRe[m] = det.real();
+    detIm[m] = det.imag();
+  }
+  return finite;
+}
+
+/*
+Runs matrices [begin, end) of a SoA batch through the fixed-size kernels, W = sizeof(V) / sizeof(double)
+at a time : the inverse goes to Bre / Bim unless Bre is null, the determinant to detRe / detIm
+(one value per matrix) unless detRe is null. Both together come from one cofactor pass.
+Lanes with a non-finite output are redone one by one (CplxSoARedo); returns how many of those
+stayed non-finite.
+*/
+template <int N, typename V>
+inline size_t CplxSoARange(const double* Are, const double* Aim, double* Bre, double* Bim,
+  double* detRe, double* detIm, size_t ld, size_t begin, size_t end)
+{
+  const size_t W = sizeof(V) / sizeof(double);
+  CplxPack<V> a[N][N], b[N][N], det;
+  size_t failed = 0;
+
+  for (size_t m = begin; m < end; m += W) {
+    for (int i = 0; i < N; i++)
+      for (int j = 0; j < N; j++) {
+        memcpy(&a[i][j].re, Are + (i * N + j) * ld + m, sizeof(V));
+        memcpy(&a[i][j].im, Aim + (i * N + j) * ld + m, sizeof(V));
+      }
+
+    det = Bre ? InvertAndDetCplx<N>(a, b) : DetCplx<N>(a);
+
+    // x - x is 0 for finite x and NaN for inf / NaN, lane by lane; det is checked in every mode.
+    // One partial sum per column keeps the adds off a single dependency chain.
+    V part[N];
+    for (int j = 0; j < N; j++)
+      part[j] = V();
+    part[0] = (det.re - det.re) + (det.im - det.im);
+    if (Bre)
+      for (int i = 0; i < N; i++)
+        for (int j = 0; j < N; j++) {
+          memcpy(Bre + (i * N + j) * ld + m, &b[i][j].re, sizeof(V));
+          memcpy(Bim + (i * N + j) * ld + m, &b[i][j].im, sizeof(V));
+          part[j] += (b[i][j].re - b[i][j].re) + (b[i][j].im - b[i][j].im);
+        }
+    V check = part[0];
+    for (int j = 1; j < N; j++)
+      check += part[j];
+    if (detRe) {
+      memcpy(detRe + m, &det.re, sizeof(V));
+      memcpy(detIm + m, &det.im, sizeof(V));
+    }
+
+    double lanes[W];
+    memcpy(lanes, &check, sizeof(V));
+    for (size_t l = 0; l < W; l++)
+      if (lanes[l] != 0.0 && !CplxSoARedo<N>(a, l, Bre, Bim, detRe, detIm, ld, m + l))
+        failed++;
+  }
+  return failed;
+}
+
+template <typename V>
+inline size_t CplxSoADim(const double* Are, const double* Aim, double* Bre, double* Bim,
+  double* detRe, double* detIm, int dim, size_t ld, size_t begin, size_t end)
+{
+  switch (dim) {
+  case 1: return CplxSoARange<1, V>(Are, Aim, Bre, Bim, detRe, detIm, ld, begin, end);
+  case 2: return CplxSoARange<2, V>(Are, Aim, Bre, Bim, detRe, detIm, ld, begin, end);
+  case 3: return CplxSoARange<3, V>(Are, Aim, Bre, Bim, detRe, detIm, ld, begin, end);
+  case 4: return CplxSoARange<4, V>(Are, Aim, Bre, Bim, detRe, detIm, ld, begin, end);
+  case 5: return CplxSoARange<5, V>(Are, Aim, Bre, Bim, detRe, detIm, ld, begin, end);
+  case 6: return CplxSoARange<6, V>(Are, Aim, Bre, Bim, detRe, detIm, ld, begin, end);
+  }
+  return 0;
+}
+
+// Sorts the eigenpairs of SoA matrix m ascending, as SortEigHermCplx.
+inline void SortEigHermCplxSoA(double* w, double* Vre, double* Vim, int dim, size_t ld, size_t m)
+{
+  for (int i = 0; i < dim - 1; i++) {
+    int k = i;
+    for (int j = i + 1; j < dim; j++)
+      if (w[j * ld + m] < w[k * ld + m])
+        k = j;
+    if (k != i) {
+      std::swap(w[i * ld + m], w[k * ld + m]);
+      for (int r = 0; r < dim; r++) {
+        std::swap(Vre[(r * dim + i) * ld + m], Vre[(r * dim + k) * ld + m]);
+        std::swap(Vim[(r * dim + i) * ld + m], Vim[(r * dim + k) * ld + m]);
+      }
+    }
+  }
+}
+
+// EigHermCplx on matrices [begin, end) of a SoA batch, W at a time; returns the number that did not converge.
+template <int N, typename V>
+inline size_t EigHermCplxSoARange(const double* Are, const double* Aim, double* w, double* Vre, double* Vim,
+  size_t ld, size_t begin, size_t end)
+{
+  CplxPack<V> a[N][N], v[N][N];
+  size_t failed = 0;
+
+  for (size_t m = begin; m < end; m += sizeof(V) / sizeof(double)) {
+    for (int i = 0; i < N; i++)
+      for (int j = 0; j <= i; j++) {
+        memcpy(&a[i][j].re, Are + (i * N + j) * ld + m, sizeof(V));
+        memcpy(&a[i][j].im, Aim + (i * N + j) * ld + m, sizeof(V));
+        a[j][i] = CplxPack<V>(a[i][j].re, -a[i][j].im);
+      }
+    for (int i = 0; i < N; i++)
+      a[i][i].im = V();
+
+    failed += CplxJacobiHerm<N>(a, v);
+
+    for (int i = 0; i < N; i++) {
+      memcpy(w + i * ld + m, &a[i][i].re, sizeof(V));
+      for (int j = 0; j < N; j++) {
+        memcpy(Vre + (i * N + j) * ld + m, &v[i][j].re, sizeof(V));
+        memcpy(Vim + (i * N + j) * ld + m, &v[i][j].im, sizeof(V));
+      }
+    }
+  }
+  for (size_t m = begin; m < end; m++)
+    SortEigHermCplxSoA(w, Vre, Vim, N, ld, m);
+  return failed;
+}
+
+template <typename V>
+inline size_t EigHermCplxSoADim(const double* Are, const double* Aim, double* w, double* Vre, double* Vim,
+  int dim, size_t ld, size_t begin, size_t end)
+{
+  switch (dim) {
+  case 1: return EigHermCplxSoARange<1, V>(Are, Aim, w, Vre, Vim, ld, begin, end);
+  case 2: return EigHermCplxSoARange<2, V>(Are, Aim, w, Vre, Vim, ld, begin, end);
+  case 3: return EigHermCplxSoARange<3, V>(Are, Aim, w, Vre, Vim, ld, begin, end);
+  case 4: return EigHermCplxSoARange<4, V>(Are, Aim, w, Vre, Vim, ld, begin, end);
+  case 5: return EigHermCplxSoARange<5, V>(Are, Aim, w, Vre, Vim, ld, begin, end);
+  case 6: return EigHermCplxSoARange<6, V>(Are, Aim, w, Vre, Vim, ld, begin, end);
+  case 7: return EigHermCplxSoARange<7, V>(Are, Aim, w, Vre, Vim, ld, begin, end);
+  case 8: return EigHermCplxSoARange<8, V>(Are, Aim, w, Vre, Vim, ld, begin, end);
+  }
+  return 0;
+}
+
+#ifdef INVERSION_CPLX_SIMD_X86
+// Each entry point is compiled for its own instruction set; flatten pulls the kernels in.
+__attribute__((target("sse2"), flatten))
+inline size_t CplxSoA_SSE2(const double* Are, const double* Aim, double* Bre, double* Bim,
+  double* detRe, double* detIm, int dim, size_t ld, size_t count)
+{
+  return CplxSoADim<CplxSimd2d>(Are, Aim, Bre, Bim, detRe, detIm, dim, ld, 0, count);
+}
+
+__attribute__((target("avx2,fma"), flatten))
+inline size_t CplxSoA_AVX2(const double* Are, const double* Aim, double* Bre, double* Bim,
+  double* detRe, double* detIm, int dim, size_t ld, size_t count)
+{
+  return CplxSoADim<CplxSimd4d>(Are, Aim, Bre, Bim, detRe, detIm, dim, ld, 0, count);
+}
+
+__attribute__((target("avx512f,fma"), flatten))
+inline size_t CplxSoA_AVX512(const double* Are, const double* Aim, double* Bre, double* Bim,
+  double* detRe, double* detIm, int dim, size_t ld, size_t count)
+{
+  return CplxSoADim<CplxSimd8d>(Are, Aim, Bre, Bim, detRe, detIm, dim, ld, 0, count);
+}
+
+__attribute__((target("sse2"), flatten))
+inline size_t EigHermCplxSoA_SSE2(const double* Are, const double* Aim, double* w, double* Vre, double* Vim,
+  int dim, size_t ld, size_t count)
+{
+  return EigHermCplxSoADim<CplxSimd2d>(Are, Aim, w, Vre, Vim, dim, ld, 0, count);
+}
+
+__attribute__((target("avx2,fma"), flatten))
+inline size_t EigHermCplxSoA_AVX2(const double* Are, const double* Aim, double* w, double* Vre, double* Vim,
+  int dim, size_t ld, size_t count)
+{
+  return EigHermCplxSoADim<CplxSimd4d>(Are, Aim, w, Vre, Vim, dim, ld, 0, count);
+}
+
+__attribute__((target("avx512f,fma"), flatten))
+inline size_t EigHermCplxSoA_AVX512(const double* Are, const double* Aim, double* w, double* Vre, double* Vim,
+  int dim, size_t ld, size_t count)
+{
+  return EigHermCplxSoADim<CplxSimd8d>(Are, Aim, w, Vre, Vim, dim, ld, 0, count);
+}
+#endif
+
+inline CplxSimdLevel DetectCplxSimdLevel() {
+#ifdef INVERSION_CPLX_SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+    return CPLX_SIMD_AVX512;
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return CPLX_SIMD_AVX2;
+  if (__builtin_cpu_supports("sse2"))
+    return CPLX_SIMD_SSE2;
+#endif
+  return CPLX_SIMD_SCALAR;
+}
+
+inline CplxSimdLevel& CplxSimdLevelSelected() {
+  static CplxSimdLevel level = DetectCplxSimdLevel();
+  return level;
+}
+
+// Forces a lower instruction set (e.g. for testing); requests above what the CPU supports are clamped.
+inline void SetCplxSimdLevel(CplxSimdLevel level) {
+  const CplxSimdLevel detected = DetectCplxSimdLevel();
+  CplxSimdLevelSelected() = level < detected ? level : detected;
+}
+
+/*
+Common driver of the SoA entry points below; Bre or detRe may be null (see CplxSoARange).
+Returns the number of matrices whose outputs are not finite or, when inverting, whose
+determinant is zero (the dim > 6 paths can return a finite B for a singular A).
+*/
+inline size_t CplxBatchSoA(const double* Are, const double* Aim, double* Bre, double* Bim,
+  double* detRe, double* detIm, int dim, size_t count, size_t ld)
+{
+  if (dim > 6) {
+    const size_t nn = (size_t)dim * dim;
+    std::vector<std::complex<double> > a(nn), b(nn);
+    CplxInvWorkspace ws;
+    const CplxConstMatrixView av(&a[0], dim);
+    const CplxMatrixView bv(&b[0], dim);
+    size_t failed = 0;
+    for (size_t m = 0; m < count; m++) {
+      for (size_t e = 0; e < nn; e++)
+        a[e] = std::complex<double>(Are[e * ld + m], Aim[e * ld + m]);
+      const std::complex<double> det = Bre ? InvertAndDetCplx(av, bv, ws) : DetCplx(av, ws);
+      bool ok = std::isfinite(det.real()) && std::isfinite(det.imag()) && (!Bre || det != 0.0);
+      if (Bre)
+        for (size_t e = 0; e < nn; e++) {
+          Bre[e * ld + m] = b[e].real();
+          Bim[e * ld + m] = b[e].imag();
+          ok = ok && std::isfinite(b[e].real()) && std::isfinite(b[e].imag());
+        }
+      if (detRe) {
+        detRe[m] = det.real();
+        detIm[m] = det.imag();
+      }
+      if (!ok)
+        failed++;
+    }
+    return failed;
+  }
+
+  size_t done = 0, failed = 0;
+#ifdef INVERSION_CPLX_SIMD_X86
+  switch (CplxSimdLevelSelected()) {
+  case CPLX_SIMD_AVX512:
+    done = count - count % 8;
+    failed = CplxSoA_AVX512(Are, Aim, Bre, Bim, detRe, detIm, dim, ld, done);
+    break;
+  case CPLX_SIMD_AVX2:
+    done = count - count % 4;
+    failed = CplxSoA_AVX2(Are, Aim, Bre, Bim, detRe, detIm, dim, ld, done);
+    break;
+  case CPLX_SIMD_SSE2:
+    done = count - count % 2;
+    failed = CplxSoA_SSE2(Are, Aim, Bre, Bim, detRe, detIm, dim, ld, done);
+    break;
+  default:
+    break;
+  }
+#endif
+  // remaining lanes
+  return failed + CplxSoADim<double>(Are, Aim, Bre, Bim, detRe, detIm, dim, ld, done, count);
+}
+
+/*
+Inverts count matrices stored in SoA layout (see top of file).
+Bre/Bim may be Are/Aim themselves (in place); otherwise A and B must not overlap.
+dim > 6 falls back to InvertCplx one matrix at a time. Lanes that come out non-finite (an overflow
+of the unscaled products, a singular or non-finite A) are redone with the std::complex kernels;
+returns the number of matrices that are singular or still non-finite after that.
+*/
+inline size_t InvertCplxBatchSoA(const double* Are, const double* Aim, double* Bre, double* Bim,
+  int dim, size_t count, size_t ld)
+{
+  return CplxBatchSoA(Are, Aim, Bre, Bim, 0, 0, dim, count, ld);
+}
+
+/*
+Determinants of count SoA matrices : det of matrix m goes to detRe[m], detIm[m].
+The 2x2 and 3x3 minors are formed once per W matrices instead of once per matrix.
+Returns the number of non-finite determinants, as InvertCplxBatchSoA.
+*/
+inline size_t DetCplxBatchSoA(const double* Are, const double* Aim, double* detRe, double* detIm,
+  int dim, size_t count, size_t ld)
+{
+  return CplxBatchSoA(Are, Aim, 0, 0, detRe, detIm, dim, count, ld);
+}
+
+// InvertCplxBatchSoA that also writes the determinants, from the same cofactors.
+inline size_t InvertAndDetCplxBatchSoA(const double* Are, const double* Aim, double* Bre, double* Bim,
+  double* detRe, double* detIm, int dim, size_t count, size_t ld)
+{
+  return CplxBatchSoA(Are, Aim, Bre, Bim, detRe, detIm, dim, count, ld);
+}
+
+/*
+EigHermCplx over count SoA matrices (lower triangles read) : eigenvalue i of matrix m goes to
+w[i * ld + m], eigenvector element (i,j) to Vre / Vim like the matrix elements. dim <= 8 runs the
+Jacobi kernel on W matrices at once, larger dims go to EigHermCplx one matrix at a time.
+Returns the number of matrices that failed.
+*/
+inline size_t EigHermCplxBatchSoA(const double* Are, const double* Aim, double* w, double* Vre, double* Vim,
+  int dim, size_t count, size_t ld)
+{
+  if (dim > 8) {
+    const size_t nn = (size_t)dim * dim;
+    std::vector<std::complex<double> > a(nn), v(nn);
+    std::vector<double> wm(dim);
+    CplxInvWorkspace ws;
+    size_t failed = 0;
+    for (size_t m = 0; m < count; m++) {
+      for (size_t e = 0; e < nn; e++)
+        a[e] = std::complex<double>(Are[e * ld + m], Aim[e * ld + m]);
+      if (EigHermCplx(CplxConstMatrixView(&a[0], dim), &wm[0], CplxMatrixView(&v[0], dim), dim, ws))
+        failed++;
+      for (int i = 0; i < dim; i++)
+        w[i * ld + m] = wm[i];
+      for (size_t e = 0; e < nn; e++) {
+        Vre[e * ld + m] = v[e].real();
+        Vim[e * ld + m] = v[e].imag();
+      }
+    }
+    return failed;
+  }
+
+  size_t done = 0, failed = 0;
+#ifdef INVERSION_CPLX_SIMD_X86
+  switch (CplxSimdLevelSelected()) {
+  case CPLX_SIMD_AVX512:
+    done = count - count % 8;
+    failed = EigHermCplxSoA_AVX512(Are, Aim, w, Vre, Vim, dim, ld, done);
+    break;
+  case CPLX_SIMD_AVX2:
+    done = count - count % 4;
+    failed = EigHermCplxSoA_AVX2(Are, Aim, w, Vre, Vim, dim, ld, done);
+    break;
+  case CPLX_SIMD_SSE2:
+    done = count - count % 2;
+    failed = EigHermCplxSoA_SSE2(Are, Aim, w, Vre, Vim, dim, ld, done);
+    break;
+  default:
+    break;
+  }
+#endif
+  // remaining lanes
+  return failed + EigHermCplxSoADim<double>(Are, Aim, w, Vre, Vim, dim, ld, done, count);
+}
+
+// AoS (InvertCplxBatch layout) -> SoA planes.
+inline void CplxBatchToSoA(const std::complex<double>* A, int dim, size_t count, size_t stride,
+  double* re, double* im, size_t ld)
+{
+  const size_t nn = (size_t)dim * dim;
+  for (size_t m = 0; m < count; m++)
+    for (size_t e = 0; e < nn; e++) {
+      re[e * ld + m] = A[m * stride + e].real();
+      im[e * ld + m] = A[m * stride + e].imag();
+    }
+}
+
+// SoA planes -> AoS (InvertCplxBatch layout).
+inline void CplxBatchFromSoA(const double* re, const double* im, size_t ld,
+  std::complex<double>* A, int dim, size_t count, size_t stride)
+{
+  const size_t nn = (size_t)dim * dim;
+  for (size_t m = 0; m < count; m++)
+    for (size_t e = 0; e < nn; e++)
+      A[m * stride + e] = std::complex<double>(re[e * ld + m], im[e * ld + m]);
+}
+
+#ifdef INVERSION_CPLX_SIMD_X86
+#pragma GCC diagnostic pop
+#endif
+
+#endif
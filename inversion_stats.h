@@ -0,0 +1,362 @@
+#ifndef _H_INVERSION_CPLX_STATS_
+#define _H_INVERSION_CPLX_STATS_
+/*
+Instrumentation of the inversion.h dispatchers, compiled in only with -DINVERSION_CPLX_STATS
+(otherwise the probes expand to nothing and this header is not included).
+
+Every instrumented call records, per operation, dim and path (fixed-size kernel, native
+Gauss-Jordan, LAPACK) : a call count, cumulative ticks, failures (singular / zero pivot / not
+positive definite) and, for InvertCplxChecked, ill-conditioned matrices. Ticks are rdtsc cycles
+on x86 (steady_clock nanoseconds elsewhere, or with -DINVERSION_CPLX_STATS_STEADY).
+
+Counters are thread-local and written only by their own thread, so recording is a few plain
+adds; CplxStatsSnapshot() sums all threads, including those that have exited, on demand.
+CplxStatsSetTracing() additionally buffers one event per call for CplxStatsWriteChromeTrace()
+(chrome://tracing, Perfetto), and CplxStatsSetHook() forwards each call to a user callback,
+e.g. to emit perf / USDT / LTTng events.
+*/
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#if (defined(__x86_64__) || defined(__i386__)) && !defined(INVERSION_CPLX_STATS_STEADY)
+#include <x86intrin.h>
+#define INVERSION_CPLX_STATS_RDTSC
+#endif
+
+enum CplxStatsOp {
+  CPLX_OP_INVERT,
+  CPLX_OP_DET,
+  CPLX_OP_LOGDET,
+  CPLX_OP_SOLVE,
+  CPLX_OP_CHECKED,  // InvertCplxChecked; its dim <= 8 inversions also count under CPLX_OP_INVERT
+  CPLX_OP_COUNT
+};
+
+enum CplxStatsPath {
+  CPLX_PATH_FIXED,
+  CPLX_PATH_NATIVE,
+  CPLX_PATH_LAPACK,
+  CPLX_PATH_COUNT
+};
+
+// dims 1..64 are counted individually, everything larger in the last bucket
+const int CPLX_STATS_MAX_DIM = 64;
+const int CPLX_STATS_DIMS = CPLX_STATS_MAX_DIM + 2;
+
+inline int CplxStatsDimIndex(int dim) {
+  return dim < 0 ? 0 : (dim > CPLX_STATS_MAX_DIM ? CPLX_STATS_MAX_DIM + 1 : dim);
+}
+
+inline int CplxStatsInvertPath(int dim, int nativeMax) {
+  return dim <= 8 ? CPLX_PATH_FIXED : (dim <= nativeMax ? CPLX_PATH_NATIVE : CPLX_PATH_LAPACK);
+}
+
+inline const char* CplxStatsOpName(int op) {
+  static const char* names[CPLX_OP_COUNT] = { "InvertCplx", "DetCplx", "LogDetCplx", "SolveCplx", "InvertCplxChecked" };
+  return names[op];
+}
+
+inline const char* CplxStatsPathName(int path) {
+  static const char* names[CPLX_PATH_COUNT] = { "fixed", "native", "lapack" };
+  return names[path];
+}
+
+inline uint64_t CplxStatsNow() {
+#ifdef INVERSION_CPLX_STATS_RDTSC
+  return __rdtsc();
+#else
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+inline const char* CplxStatsTickUnit() {
+#ifdef INVERSION_CPLX_STATS_RDTSC
+  return "cycles";
+#else
+  return "ns";
+#endif
+}
+
+// Microseconds since the first call, the time base of the trace events.
+inline double CplxStatsMicros() {
+  static const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Written by its owning thread only (load + store, no locked RMW), read by anyone.
+struct CplxStatsCounter {
+  std::atomic<uint64_t> v;
+
+  CplxStatsCounter() : v(0) {}
+  void Add(uint64_t x) { v.store(v.load(std::memory_order_relaxed) + x, std::memory_order_relaxed); }
+  uint64_t Get() const { return v.load(std::memory_order_relaxed); }
+};
+
+struct CplxStatsEntry {
+  CplxStatsCounter calls[CPLX_PATH_COUNT];
+  CplxStatsCounter ticks[CPLX_PATH_COUNT];
+  CplxStatsCounter failures;
+  CplxStatsCounter illConditioned;
+};
+
+struct CplxTraceEvent {
+  double ts, dur;  // microseconds
+  int op, path, dim;
+  unsigned tid;
+  size_t count;
+  size_t failed;
+};
+
+// Aggregated counters, indexed [op][CplxStatsDimIndex(dim)][path].
+struct CplxStatsSnapshot {
+  uint64_t calls[CPLX_OP_COUNT][CPLX_STATS_DIMS][CPLX_PATH_COUNT];
+  uint64_t ticks[CPLX_OP_COUNT][CPLX_STATS_DIMS][CPLX_PATH_COUNT];
+  uint64_t failures[CPLX_OP_COUNT][CPLX_STATS_DIMS];
+  uint64_t illConditioned[CPLX_OP_COUNT][CPLX_STATS_DIMS];
+
+  CplxStatsSnapshot() { memset(this, 0, sizeof(*this)); }
+
+  void Add(const CplxStatsSnapshot& s, int sign) {
+    for (int o = 0; o < CPLX_OP_COUNT; o++)
+      for (int d = 0; d < CPLX_STATS_DIMS; d++) {
+        for (int p = 0; p < CPLX_PATH_COUNT; p++) {
+          calls[o][d][p] += sign * s.calls[o][d][p];
+          ticks[o][d][p] += sign * s.ticks[o][d][p];
+        }
+        failures[o][d] += sign * s.failures[o][d];
+        illConditioned[o][d] += sign * s.illConditioned[o][d];
+      }
+  }
+};
+
+struct CplxStatsTable {
+  CplxStatsEntry e[CPLX_OP_COUNT][CPLX_STATS_DIMS];
+  std::vector<CplxTraceEvent> trace;
+  unsigned tid;
+
+  void AddTo(CplxStatsSnapshot& s) const {
+    for (int o = 0; o < CPLX_OP_COUNT; o++)
+      for (int d = 0; d < CPLX_STATS_DIMS; d++) {
+        const CplxStatsEntry& x = e[o][d];
+        for (int p = 0; p < CPLX_PATH_COUNT; p++) {
+          s.calls[o][d][p] += x.calls[p].Get();
+          s.ticks[o][d][p] += x.ticks[p].Get();
+        }
+        s.failures[o][d] += x.failures.Get();
+        s.illConditioned[o][d] += x.illConditioned.Get();
+      }
+  }
+};
+
+typedef void (*CplxStatsHook)(void* ctx, int op, int dim, int path, size_t count, uint64_t ticks, size_t failed);
+
+struct CplxStatsRegistry {
+  std::mutex mtx;
+  std::vector<CplxStatsTable*> live;
+  CplxStatsSnapshot retired;   // counters of exited threads
+  CplxStatsSnapshot baseline;  // subtracted by CplxStatsSnapshot(), set by CplxStatsReset()
+  std::vector<CplxTraceEvent> retiredTrace;
+  unsigned nextTid;
+  std::atomic<bool> tracing;
+  size_t traceCapacity;
+  std::atomic<CplxStatsHook> hook;
+  std::atomic<void*> hookCtx;
+
+  CplxStatsRegistry() : nextTid(0), tracing(false), traceCapacity(0), hook(0), hookCtx(0) {}
+};
+
+inline CplxStatsRegistry& CplxStatsGlobal() {
+  static CplxStatsRegistry r;
+  return r;
+}
+
+// Registers the thread's table on first use and folds it into the totals when the thread exits.
+struct CplxStatsThread {
+  CplxStatsTable* table;
+
+  CplxStatsThread() : table(new CplxStatsTable) {
+    CplxStatsRegistry& r = CplxStatsGlobal();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    table->tid = r.nextTid++;
+    r.live.push_back(table);
+  }
+
+  ~CplxStatsThread() {
+    CplxStatsRegistry& r = CplxStatsGlobal();
+    std::lock_guard<std::mutex> lock(r.mtx);
+    table->AddTo(r.retired);
+    r.retiredTrace.insert(r.retiredTrace.end(), table->trace.begin(), table->trace.end());
+    for (size_t i = 0; i < r.live.size(); i++)
+      if (r.live[i] == table) {
+        r.live.erase(r.live.begin() + i);
+        break;
+      }
+    delete table;
+  }
+};
+
+inline CplxStatsTable& CplxStatsLocal() {
+  static thread_local CplxStatsThread t;
+  return *t.table;
+}
+
+// RAII probe placed at the top of an instrumented call; count > 1 for batches.
+class CplxStatsProbe {
+public:
+  CplxStatsProbe(int op_, int dim_, int path_, size_t count_ = 1)
+    : op(op_), dim(dim_), path(path_), count(count_), failed(0), ill(0), traceStart(-1.0)
+  {
+    if (CplxStatsGlobal().tracing.load(std::memory_order_relaxed))
+      traceStart = CplxStatsMicros();
+    start = CplxStatsNow();
+  }
+
+  ~CplxStatsProbe() {
+    const uint64_t ticks = CplxStatsNow() - start;
+    CplxStatsTable& t = CplxStatsLocal();
+    CplxStatsEntry& e = t.e[op][CplxStatsDimIndex(dim)];
+    e.calls[path].Add(count);
+    e.ticks[path].Add(ticks);
+    if (failed)
+      e.failures.Add(failed);
+    if (ill)
+      e.illConditioned.Add(ill);
+
+    CplxStatsRegistry& r = CplxStatsGlobal();
+    if (traceStart >= 0.0 && t.trace.size() < r.traceCapacity) {
+      CplxTraceEvent ev;
+      ev.ts = traceStart;
+      ev.dur = CplxStatsMicros() - traceStart;
+      ev.op = op;
+      ev.path = path;
+      ev.dim = dim;
+      ev.tid = t.tid;
+      ev.count = count;
+      ev.failed = failed;
+      t.trace.push_back(ev);
+    }
+    const CplxStatsHook fn = r.hook.load(std::memory_order_acquire);
+    if (fn)
+      fn(r.hookCtx.load(std::memory_order_relaxed), op, dim, path, count, ticks, failed);
+  }
+
+  void Fail(size_t n = 1) { failed += n; }
+  void IllConditioned(size_t n = 1) { ill += n; }
+
+private:
+  int op, dim, path;
+  size_t count;
+  size_t failed, ill;
+  double traceStart;
+  uint64_t start;
+};
+
+// Totals over all threads since the last CplxStatsReset().
+inline CplxStatsSnapshot CplxStatsTotals() {
+  CplxStatsRegistry& r = CplxStatsGlobal();
+  std::lock_guard<std::mutex> lock(r.mtx);
+  CplxStatsSnapshot s = r.retired;
+  for (size_t i = 0; i < r.live.size(); i++)
+    r.live[i]->AddTo(s);
+  s.Add(r.baseline, -1);
+  return s;
+}
+
+// Restarts the totals; threads keep counting undisturbed (the current totals become the baseline).
+inline void CplxStatsReset() {
+  CplxStatsRegistry& r = CplxStatsGlobal();
+  std::lock_guard<std::mutex> lock(r.mtx);
+  CplxStatsSnapshot s = r.retired;
+  for (size_t i = 0; i < r.live.size(); i++)
+    r.live[i]->AddTo(s);
+  r.baseline = s;
+}
+
+/*
+Starts / stops buffering one trace event per instrumented call, at most maxEventsPerThread per thread.
+Set it while the instrumented threads are idle; events are collected by CplxStatsWriteChromeTrace().
+*/
+inline void CplxStatsSetTracing(bool on, size_t maxEventsPerThread = (size_t)1 << 20) {
+  CplxStatsRegistry& r = CplxStatsGlobal();
+  std::lock_guard<std::mutex> lock(r.mtx);
+  r.traceCapacity = maxEventsPerThread;
+  r.tracing.store(on, std::memory_order_relaxed);
+}
+
+// fn(ctx, ...) is called after every instrumented call, from the calling thread. 0 removes the hook.
+inline void CplxStatsSetHook(CplxStatsHook fn, void* ctx) {
+  CplxStatsRegistry& r = CplxStatsGlobal();
+  r.hookCtx.store(ctx, std::memory_order_relaxed);
+  r.hook.store(fn, std::memory_order_release);
+}
+
+// Human-readable table of the non-zero entries.
+inline void CplxStatsPrint(FILE* f, const CplxStatsSnapshot& s) {
+  fprintf(f, "%-18s %5s %-7s %12s %14s %10s %8s %8s\n", "op", "dim", "path", "calls",
+    CplxStatsTickUnit(), "per call", "failed", "illcond");
+  for (int o = 0; o < CPLX_OP_COUNT; o++)
+    for (int d = 0; d < CPLX_STATS_DIMS; d++)
+      for (int p = 0; p < CPLX_PATH_COUNT; p++) {
+        const uint64_t calls = s.calls[o][d][p];
+        if (!calls)
+          continue;
+        fprintf(f, "%-18s %4d%s %-7s %12llu %14llu %10.1f %8llu %8llu\n", CplxStatsOpName(o),
+          d > CPLX_STATS_MAX_DIM ? CPLX_STATS_MAX_DIM : d, d > CPLX_STATS_MAX_DIM ? "+" : " ",
+          CplxStatsPathName(p), (unsigned long long)calls, (unsigned long long)s.ticks[o][d][p],
+          (double)s.ticks[o][d][p] / calls, (unsigned long long)s.failures[o][d],
+          (unsigned long long)s.illConditioned[o][d]);
+      }
+}
+
+// Non-zero entries as JSON, for dashboards and regression tracking.
+inline void CplxStatsWriteJson(FILE* f, const CplxStatsSnapshot& s) {
+  fprintf(f, "{\"tick_unit\": \"%s\", \"entries\": [", CplxStatsTickUnit());
+  bool first = true;
+  for (int o = 0; o < CPLX_OP_COUNT; o++)
+    for (int d = 0; d < CPLX_STATS_DIMS; d++)
+      for (int p = 0; p < CPLX_PATH_COUNT; p++) {
+        if (!s.calls[o][d][p])
+          continue;
+        fprintf(f, "%s\n  {\"op\": \"%s\", \"dim\": %d, \"dim_above_max\": %s, \"path\": \"%s\", \"calls\": %llu, "
+          "\"ticks\": %llu, \"failures\": %llu, \"ill_conditioned\": %llu}", first ? "" : ",",
+          CplxStatsOpName(o), d > CPLX_STATS_MAX_DIM ? CPLX_STATS_MAX_DIM : d,
+          d > CPLX_STATS_MAX_DIM ? "true" : "false", CplxStatsPathName(p),
+          (unsigned long long)s.calls[o][d][p], (unsigned long long)s.ticks[o][d][p],
+          (unsigned long long)s.failures[o][d], (unsigned long long)s.illConditioned[o][d]);
+        first = false;
+      }
+  fprintf(f, "\n]}\n");
+}
+
+/*
+Writes the buffered trace events in Chrome trace event format (complete "X" events, one track
+per thread) and clears the buffers. Call while the instrumented threads are idle.
+Returns the number of events written.
+*/
+inline size_t CplxStatsWriteChromeTrace(FILE* f) {
+  CplxStatsRegistry& r = CplxStatsGlobal();
+  std::lock_guard<std::mutex> lock(r.mtx);
+  std::vector<CplxTraceEvent> events;
+  events.swap(r.retiredTrace);
+  for (size_t i = 0; i < r.live.size(); i++) {
+    events.insert(events.end(), r.live[i]->trace.begin(), r.live[i]->trace.end());
+    r.live[i]->trace.clear();
+  }
+
+  fprintf(f, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  for (size_t i = 0; i < events.size(); i++) {
+    const CplxTraceEvent& e = events[i];
+    fprintf(f, "%s\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+      "\"pid\": 0, \"tid\": %u, \"args\": {\"dim\": %d, \"count\": %zu, \"failed\": %zu}}",
+      i ? "," : "", CplxStatsOpName(e.op), CplxStatsPathName(e.path), e.ts, e.dur, e.tid, e.dim, e.count, e.failed);
+  }
+  fprintf(f, "\n]}\n");
+  return events.size();
+}
+
+#endif
@@ -0,0 +1,227 @@
+#ifndef _H_INVERSION_CPLX_STREAM_
+#define _H_INVERSION_CPLX_STREAM_
+/*
+Fused per-frame beamforming stage.
+
+For every frequency bin, one STFT frame x (bins x channels, bin-major) updates the smoothed
+covariance R = alpha R + (1 - alpha) x x^H, then R w = d is solved against the steering vector d
+of that bin (SolveHermCplx, SolveCplx if R is not positive definite) and the weights are written
+out. All of this happens while R, x and d of the bin are still in L1, so a frame costs one pass
+over the bins x N x N state instead of three.
+
+Process() runs a frame synchronously. Submit() hands frames to a worker thread through two input
+buffers, so the next frame can be filled while the current one is processed, and Wait() / Weights()
+collect the results. Use one mode or the other. Submit() expects a single producer thread.
+*/
+#include "inversion.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum CplxWeightMode {
+  CPLX_WEIGHTS_SOLVE,  // w = inv(R) d
+  CPLX_WEIGHTS_MVDR    // w = inv(R) d / (d^H inv(R) d)
+};
+
+class CplxCovarianceStream {
+public:
+  /*
+  steering : bins x channels, copied. loading > 0 adds loading * trace(R) / channels to the diagonal
+  before solving (R itself is not modified). With loading = 0, R must reach full rank (channels
+  frames, or Reset() with init > 0) before the solves succeed.
+  */
+  CplxCovarianceStream(int bins_, int channels_, double alpha_, const std::complex<double>* steering,
+    CplxWeightMode mode_ = CPLX_WEIGHTS_MVDR, double loading_ = 0.0)
+    : bins(bins_), n(channels_), alpha(alpha_), loading(loading_), mode(mode_),
+    R((size_t)bins_ * channels_ * channels_), d(steering, steering + (size_t)bins_ * channels_),
+    scratch((size_t)channels_ * channels_), y(channels_),
+    queued(0), head(0), latest(0), submitted(0), completed(0), latestFailed(0), quit(false)
+  {
+    for (int s = 0; s < 2; s++) {
+      frames[s].resize((size_t)bins * n);
+      weights[s].resize((size_t)bins * n);
+    }
+    ws.Reserve(n);
+    ws.ReserveRhs(n, 1);
+  }
+
+  ~CplxCovarianceStream() {
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      quit = true;
+    }
+    wake.notify_all();
+    if (worker.joinable())
+      worker.join();
+  }
+
+  int Bins() const { return bins; }
+  int Channels() const { return n; }
+
+  // R = init * I for every bin.
+  void Reset(double init = 0.0) {
+    std::fill(R.begin(), R.end(), std::complex<double>(0.0));
+    for (int b = 0; b < bins; b++)
+      for (int i = 0; i < n; i++)
+        R[((size_t)b * n + i) * n + i] = init;
+  }
+
+  // Replaces the steering vectors (bins x channels). In async mode, only between Wait() and Submit().
+  void SetSteering(const std::complex<double>* steering) {
+    std::copy(steering, steering + (size_t)bins * n, d.begin());
+  }
+
+  /*
+  One fused pass : frame in, weights (bins x channels) out. Returns the number of bins whose
+  solve failed; their weights are set to zero.
+  */
+  size_t Process(const std::complex<double>* frame, std::complex<double>* w) {
+    size_t failed = 0;
+    for (int b = 0; b < bins; b++)
+      if (!ProcessBin(b, frame + (size_t)b * n, w + (size_t)b * n))
+        failed++;
+    return failed;
+  }
+
+  // Copies the frame into a free input buffer, blocking only while two frames are queued. Returns its index.
+  size_t Submit(const std::complex<double>* frame) {
+    int slot;
+    {
+      std::unique_lock<std::mutex> lock(mtx);
+      if (!worker.joinable())
+        worker = std::thread(&CplxCovarianceStream::WorkerLoop, this);
+      done.wait(lock, [this] { return queued < 2; });
+      slot = (head + queued) % 2;
+    }
+    // the worker does not touch a slot before it is queued
+    std::copy(frame, frame + (size_t)bins * n, frames[slot].begin());
+    size_t index;
+    {
+      std::lock_guard<std::mutex> lock(mtx);
+      queued++;
+      index = submitted++;
+    }
+    wake.notify_one();
+    return index;
+  }
+
+  // Blocks until every submitted frame is processed.
+  void Wait() {
+    std::unique_lock<std::mutex> lock(mtx);
+    done.wait(lock, [this] { return queued == 0; });
+  }
+
+  /*
+  Copies the weights of the most recently completed frame to w and returns the number of completed
+  frames (0 : nothing completed yet, w untouched). failedBins receives Process()'s result for that frame.
+  */
+  size_t Weights(std::complex<double>* w, size_t* failedBins = 0) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (completed == 0)
+      return 0;
+    std::copy(weights[latest].begin(), weights[latest].end(), w);
+    if (failedBins)
+      *failedBins = latestFailed;
+    return completed;
+  }
+
+private:
+  bool ProcessBin(int b, const std::complex<double>* x, std::complex<double>* w) {
+    std::complex<double>* Rb = &R[(size_t)b * n * n];
+    const std::complex<double>* db = &d[(size_t)b * n];
+    const double beta = 1.0 - alpha;
+
+    for (int i = 0; i < n; i++) {
+      const std::complex<double> xi = beta * x[i];
+      for (int j = 0; j < n; j++)
+        Rb[i * n + j] = alpha * Rb[i * n + j] + xi * std::conj(x[j]);
+    }
+
+    const std::complex<double>* A = Rb;
+    if (loading > 0.0) {
+      double trace = 0.0;
+      for (int i = 0; i < n; i++)
+        trace += Rb[i * n + i].real();
+      std::copy(Rb, Rb + (size_t)n * n, scratch.begin());
+      for (int i = 0; i < n; i++)
+        scratch[i * n + i] += loading * trace / n;
+      A = &scratch[0];
+    }
+
+    const CplxRowMajorPtr<const std::complex<double> > Ap(A, n);
+    int info = SolveHermCplx(Ap, db, &y[0], n, 1, ws);
+    if (info)
+      info = SolveCplx(Ap, db, &y[0], n, 1, ws);
+
+    std::complex<double> scale(1.0);
+    if (!info && mode == CPLX_WEIGHTS_MVDR) {
+      std::complex<double> s(0.0);
+      for (int i = 0; i < n; i++)
+        s += std::conj(db[i]) * y[i];
+      if (s == 0.0 || !std::isfinite(s.real()) || !std::isfinite(s.imag()))
+        info = 1;
+      else
+        scale = 1.0 / s;
+    }
+    if (info) {
+      std::fill(w, w + n, std::complex<double>(0.0));
+      return false;
+    }
+    for (int i = 0; i < n; i++)
+      w[i] = y[i] * scale;
+    return true;
+  }
+
+  void WorkerLoop() {
+    for (;;) {
+      int slot;
+      {
+        std::unique_lock<std::mutex> lock(mtx);
+        wake.wait(lock, [this] { return quit || queued > 0; });
+        if (queued == 0)
+          return;
+        slot = head;
+      }
+      // weights[latest] stays readable through Weights() while the other buffer is written
+      const int out = 1 - latest;
+      const size_t failed = Process(&frames[slot][0], &weights[out][0]);
+      {
+        std::lock_guard<std::mutex> lock(mtx);
+        latest = out;
+        latestFailed = failed;
+        completed++;
+        head = 1 - head;
+        queued--;
+      }
+      done.notify_all();
+    }
+  }
+
+  int bins;
+  int n;
+  double alpha;
+  double loading;
+  CplxWeightMode mode;
+  std::vector<std::complex<double> > R;
+  std::vector<std::complex<double> > d;
+  std::vector<std::complex<double> > scratch;
+  std::vector<std::complex<double> > y;
+  CplxInvWorkspace ws;
+
+  std::vector<std::complex<double> > frames[2];
+  std::vector<std::complex<double> > weights[2];
+  std::thread worker;
+  std::mutex mtx;
+  std::condition_variable wake;
+  std::condition_variable done;
+  int queued;
+  int head;
+  int latest;
+  size_t submitted;
+  size_t completed;
+  size_t latestFailed;
+  bool quit;
+};
+
+#endif
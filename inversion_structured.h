@@ -0,0 +1,262 @@
+#ifndef _H_INVERSION_CPLX_STRUCTURED_
+#define _H_INVERSION_CPLX_STRUCTURED_
+/*
+Inverses and determinants of structured matrices, without a full N x N factorization.
+
+Block-diagonal : A = diag(A_0, ..., A_{m-1}), blocks[k] is the size of A_k and the sizes add up
+to A.rows. Each block is inverted through the size dispatch of InvertCplx on a view of A, so
+blocks up to 8 x 8 run the inlined fixed-size kernels; det(A) is the product of the block
+determinants. Entries of A outside the blocks are not read, those of B are set to zero.
+
+Kronecker : A = P (x) Q with P p x p and Q q x q, i.e. A(i q + k, j q + l) = P(i, j) Q(k, l).
+inv(A) = inv(P) (x) inv(Q) and det(A) = det(P)^q det(Q)^p, so only P and Q are inverted.
+*/
+#include "inversion.h"
+
+// Sets the entries of B outside the diagonal blocks to zero.
+template <typename MT, typename ET>
+inline void ZeroCplxOffBlocks(MT B, const int* blocks, int nblocks, ET zero) {
+  int r0 = 0, n = 0;
+  for (int b = 0; b < nblocks; b++)
+    n += blocks[b];
+  for (int b = 0; b < nblocks; b++) {
+    const int r1 = r0 + blocks[b];
+    for (int i = r0; i < r1; i++) {
+      for (int j = 0; j < r0; j++)
+        B[i][j] = zero;
+      for (int j = r1; j < n; j++)
+        B[i][j] = zero;
+    }
+    r0 = r1;
+  }
+}
+
+/*
+B = inv(A) for a block-diagonal A. B may be A itself; otherwise A and B must not overlap.
+A singular block leaves that block of B as InvertCplx does.
+*/
+template <typename ET1, typename ET2>
+inline void InvertCplxBlockDiag(CplxMatrixViewT<ET1> A, CplxMatrixViewT<ET2> B, const int* blocks, int nblocks,
+  CplxInvWorkspaceT<typename CplxRealOf<ET2>::Type>& ws) {
+  ZeroCplxOffBlocks(B, blocks, nblocks, ET2(0));
+  int r0 = 0;
+  for (int b = 0; b < nblocks; b++) {
+    const int m = blocks[b];
+    InvertCplx(A.Block(r0, r0, m, m), B.Block(r0, r0, m, m), ws);
+    r0 += m;
+  }
+}
+
+template <typename ET1, typename ET2>
+inline void InvertCplxBlockDiag(CplxMatrixViewT<ET1> A, CplxMatrixViewT<ET2> B, const int* blocks, int nblocks) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET2>::Type> ws;
+  InvertCplxBlockDiag(A, B, blocks, nblocks, ws);
+}
+
+template <typename ET>
+inline std::complex<typename CplxRealOf<ET>::Type> DetCplxBlockDiag(CplxMatrixViewT<ET> A, const int* blocks,
+  int nblocks, CplxInvWorkspaceT<typename CplxRealOf<ET>::Type>& ws) {
+  std::complex<typename CplxRealOf<ET>::Type> det(1);
+  int r0 = 0;
+  for (int b = 0; b < nblocks; b++) {
+    const int m = blocks[b];
+    det *= DetCplx(A.Block(r0, r0, m, m), ws);
+    r0 += m;
+  }
+  return det;
+}
+
+template <typename ET>
+inline std::complex<typename CplxRealOf<ET>::Type> DetCplxBlockDiag(CplxMatrixViewT<ET> A, const int* blocks,
+  int nblocks) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET>::Type> ws;
+  return DetCplxBlockDiag(A, blocks, nblocks, ws);
+}
+
+// Block of size N at offset r0 of count matrices, stride elements apart, each dim x dim row-major.
+template <int N, typename T>
+inline void InvertCplxBlockBatch(const std::complex<T>* A, std::complex<T>* B, int dim, int r0, size_t count,
+  size_t stride) {
+  typedef CplxRowMajorPtr<const std::complex<T> > In;
+  typedef CplxRowMajorPtr<std::complex<T> > Out;
+  const size_t off = (size_t)r0 * dim + r0;
+  for (size_t k = 0; k < count; k++)
+    InvertCplx<N>(In(A + k * stride + off, dim), Out(B + k * stride + off, dim));
+}
+
+template <int N, typename T>
+inline void DetCplxBlockBatch(const std::complex<T>* A, std::complex<T>* det, int dim, int r0, size_t count,
+  size_t stride) {
+  typedef CplxRowMajorPtr<const std::complex<T> > In;
+  const size_t off = (size_t)r0 * dim + r0;
+  for (size_t k = 0; k < count; k++)
+    det[k] *= DetCplx<N>(In(A + k * stride + off, dim));
+}
+
+/*
+InvertCplxBlockDiag over count matrices with the same block structure, layout as InvertCplxBatch
+(dim x dim row-major, stride elements apart). The loop runs block by block, so the size dispatch
+is done once per block rather than once per block and matrix. B may be A itself.
+*/
+template <typename T>
+inline void InvertCplxBlockDiagBatch(const std::complex<T>* A, std::complex<T>* B, int dim, const int* blocks,
+  int nblocks, size_t count, size_t stride, CplxInvWorkspaceT<T>& ws) {
+  for (size_t k = 0; k < count; k++)
+    ZeroCplxOffBlocks(CplxRowMajorPtr<std::complex<T> >(B + k * stride, dim), blocks, nblocks, std::complex<T>(0));
+
+  int r0 = 0;
+  for (int b = 0; b < nblocks; b++) {
+    const int m = blocks[b];
+    switch (m) {
+    case 1: InvertCplxBlockBatch<1>(A, B, dim, r0, count, stride);
+      break;
+    case 2: InvertCplxBlockBatch<2>(A, B, dim, r0, count, stride);
+      break;
+    case 3: InvertCplxBlockBatch<3>(A, B, dim, r0, count, stride);
+      break;
+    case 4: InvertCplxBlockBatch<4>(A, B, dim, r0, count, stride);
+      break;
+    case 5: InvertCplxBlockBatch<5>(A, B, dim, r0, count, stride);
+      break;
+    case 6: InvertCplxBlockBatch<6>(A, B, dim, r0, count, stride);
+      break;
+    case 7: InvertCplxBlockBatch<7>(A, B, dim, r0, count, stride);
+      break;
+    case 8: InvertCplxBlockBatch<8>(A, B, dim, r0, count, stride);
+      break;
+    default:
+      for (size_t k = 0; k < count; k++)
+        InvertCplx(CplxMatrixViewT<const std::complex<T> >(A + k * stride, dim).Block(r0, r0, m, m),
+          CplxMatrixViewT<std::complex<T> >(B + k * stride, dim).Block(r0, r0, m, m), ws);
+      break;
+    }
+    r0 += m;
+  }
+}
+
+template <typename T>
+inline void InvertCplxBlockDiagBatch(const std::complex<T>* A, std::complex<T>* B, int dim, const int* blocks,
+  int nblocks, size_t count, size_t stride) {
+  CplxInvWorkspaceT<T> ws;
+  InvertCplxBlockDiagBatch(A, B, dim, blocks, nblocks, count, stride, ws);
+}
+
+// det[k] = DetCplxBlockDiag of matrix k, layout as InvertCplxBlockDiagBatch.
+template <typename T>
+inline void DetCplxBlockDiagBatch(const std::complex<T>* A, std::complex<T>* det, int dim, const int* blocks,
+  int nblocks, size_t count, size_t stride, CplxInvWorkspaceT<T>& ws) {
+  for (size_t k = 0; k < count; k++)
+    det[k] = 1;
+
+  int r0 = 0;
+  for (int b = 0; b < nblocks; b++) {
+    const int m = blocks[b];
+    switch (m) {
+    case 1: DetCplxBlockBatch<1>(A, det, dim, r0, count, stride);
+      break;
+    case 2: DetCplxBlockBatch<2>(A, det, dim, r0, count, stride);
+      break;
+    case 3: DetCplxBlockBatch<3>(A, det, dim, r0, count, stride);
+      break;
+    case 4: DetCplxBlockBatch<4>(A, det, dim, r0, count, stride);
+      break;
+    case 5: DetCplxBlockBatch<5>(A, det, dim, r0, count, stride);
+      break;
+    case 6: DetCplxBlockBatch<6>(A, det, dim, r0, count, stride);
+      break;
+    case 7: DetCplxBlockBatch<7>(A, det, dim, r0, count, stride);
+      break;
+    case 8: DetCplxBlockBatch<8>(A, det, dim, r0, count, stride);
+      break;
+    default:
+      for (size_t k = 0; k < count; k++)
+        det[k] *= DetCplxNxN(CplxMatrixViewT<const std::complex<T> >(A + k * stride, dim).Block(r0, r0, m, m), ws);
+      break;
+    }
+    r0 += m;
+  }
+}
+
+template <typename T>
+inline void DetCplxBlockDiagBatch(const std::complex<T>* A, std::complex<T>* det, int dim, const int* blocks,
+  int nblocks, size_t count, size_t stride) {
+  CplxInvWorkspaceT<T> ws;
+  DetCplxBlockDiagBatch(A, det, dim, blocks, nblocks, count, stride, ws);
+}
+
+// z^e for e >= 0 by repeated squaring.
+template <typename T>
+inline std::complex<T> CplxPowInt(std::complex<T> z, int e) {
+  std::complex<T> r(1);
+  for (; e > 0; e >>= 1) {
+    if (e & 1)
+      r *= z;
+    z *= z;
+  }
+  return r;
+}
+
+/*
+B = inv(P (x) Q), a pq x pq matrix. inv(P) and inv(Q) are formed in the workspace's right-hand-side
+buffer and expanded into B, which must not overlap P or Q. Callers that keep the factored form can
+invert P and Q themselves : inv(P) (x) inv(Q) is the inverse.
+*/
+template <typename ET1, typename ET2, typename ET3>
+inline void InvertCplxKron(CplxMatrixViewT<ET1> P, CplxMatrixViewT<ET2> Q, CplxMatrixViewT<ET3> B,
+  CplxInvWorkspaceT<typename CplxRealOf<ET3>::Type>& ws) {
+  typedef std::complex<typename CplxRealOf<ET3>::Type> C;
+  const int p = P.rows, q = Q.rows;
+  ws.ReserveRhs(p * p + q * q, 1);
+  const CplxMatrixViewT<C> Pi(ws.Rhs(), p), Qi(ws.Rhs() + (size_t)p * p, q);
+  InvertCplx(P, Pi, ws);
+  InvertCplx(Q, Qi, ws);
+
+  for (int i = 0; i < p; i++)
+    for (int j = 0; j < p; j++) {
+      const C pij = Pi(i, j);
+      for (int k = 0; k < q; k++)
+        for (int l = 0; l < q; l++)
+          B(i * q + k, j * q + l) = pij * Qi(k, l);
+    }
+}
+
+template <typename ET1, typename ET2, typename ET3>
+inline void InvertCplxKron(CplxMatrixViewT<ET1> P, CplxMatrixViewT<ET2> Q, CplxMatrixViewT<ET3> B) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET3>::Type> ws;
+  InvertCplxKron(P, Q, B, ws);
+}
+
+// det(P (x) Q) = det(P)^q det(Q)^p. Overflows much sooner than the factors' determinants do.
+template <typename ET1, typename ET2>
+inline std::complex<typename CplxRealOf<ET1>::Type> DetCplxKron(CplxMatrixViewT<ET1> P, CplxMatrixViewT<ET2> Q,
+  CplxInvWorkspaceT<typename CplxRealOf<ET1>::Type>& ws) {
+  return CplxPowInt(DetCplx(P, ws), Q.rows) * CplxPowInt(DetCplx(Q, ws), P.rows);
+}
+
+template <typename ET1, typename ET2>
+inline std::complex<typename CplxRealOf<ET1>::Type> DetCplxKron(CplxMatrixViewT<ET1> P, CplxMatrixViewT<ET2> Q) {
+  CplxInvWorkspaceT<typename CplxRealOf<ET1>::Type> ws;
+  return DetCplxKron(P, Q, ws);
+}
+
+/*
+InvertCplxKron over count (P, Q) pairs : P matrices p x p and Q matrices q x q back to back,
+results pq x pq back to back in B, all row-major.
+*/
+template <typename T>
+inline void InvertCplxKronBatch(const std::complex<T>* P, const std::complex<T>* Q, std::complex<T>* B, int p, int q,
+  size_t count, CplxInvWorkspaceT<T>& ws) {
+  const size_t pp = (size_t)p * p, qq = (size_t)q * q, n = (size_t)p * q;
+  for (size_t k = 0; k < count; k++)
+    InvertCplxKron(CplxMatrixViewT<const std::complex<T> >(P + k * pp, p),
+      CplxMatrixViewT<const std::complex<T> >(Q + k * qq, q), CplxMatrixViewT<std::complex<T> >(B + k * n * n, (int)n), ws);
+}
+
+template <typename T>
+inline void InvertCplxKronBatch(const std::complex<T>* P, const std::complex<T>* Q, std::complex<T>* B, int p, int q,
+  size_t count) {
+  CplxInvWorkspaceT<T> ws;
+  InvertCplxKronBatch(P, Q, B, p, q, count, ws);
+}
+
+#endif
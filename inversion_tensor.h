@@ -0,0 +1,220 @@
+#ifndef _H_INVERSION_CPLX_TENSOR_
+#define _H_INVERSION_CPLX_TENSOR_
+/*
+Memory-mapped batch tensor files (POSIX).
+
+A file is a 64-byte CplxTensorHeader, zero padding up to offset (a page multiple, 4096 by
+default) and the payload : count complex matrices of rows x cols in native byte order, either
+  CPLX_TENSOR_AOS : matrix k row-major at element k * stride (stride >= rows * cols), the layout
+                    of InvertCplxBatch and the CplxBatchExecutor calls,
+  CPLX_TENSOR_SOA : a real plane of rows * cols rows of stride (>= count) doubles or floats, then
+                    the imaginary plane, element (i, j) of matrix k at (i * cols + j) * stride + k,
+                    the layout of InvertCplxBatchSoA.
+precision is CPLX_TENSOR_C128 (std::complex<double>) or CPLX_TENSOR_C64 (std::complex<float>).
+
+CplxTensorFile maps a whole file, read-only or read-write, so a batch call reads its input from
+and writes its output to the page cache without a copy. Release() drops already processed
+pages from the mapping (flushing written ones first), so archives larger than RAM can be walked
+in windows with a bounded resident set.
+*/
+#include "inversion.h"
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+enum CplxTensorLayout {
+  CPLX_TENSOR_AOS = 0,
+  CPLX_TENSOR_SOA = 1
+};
+
+enum CplxTensorPrecision {
+  CPLX_TENSOR_C128 = 0,
+  CPLX_TENSOR_C64 = 1
+};
+
+#define INVERSION_CPLX_TENSOR_MAGIC "CPLXTNSR"
+#define INVERSION_CPLX_TENSOR_VERSION 1
+
+struct CplxTensorHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t precision;
+  uint32_t layout;
+  uint32_t rows;
+  uint32_t cols;
+  uint32_t reserved;
+  uint64_t count;
+  uint64_t stride;
+  uint64_t offset;
+  uint64_t reserved2;
+
+  // Dense tensor (stride rows * cols for AoS, count for SoA) with the payload at 4096.
+  static CplxTensorHeader Make(int rows_, int cols_, uint64_t count_, CplxTensorLayout layout_ = CPLX_TENSOR_AOS,
+    CplxTensorPrecision precision_ = CPLX_TENSOR_C128, uint64_t stride_ = 0) {
+    CplxTensorHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, INVERSION_CPLX_TENSOR_MAGIC, 8);
+    h.version = INVERSION_CPLX_TENSOR_VERSION;
+    h.precision = precision_;
+    h.layout = layout_;
+    h.rows = rows_;
+    h.cols = cols_;
+    h.count = count_;
+    h.stride = stride_ ? stride_ : (layout_ == CPLX_TENSOR_SOA ? count_ : (uint64_t)rows_ * cols_);
+    h.offset = 4096;
+    return h;
+  }
+
+  // Bytes of one complex element.
+  size_t ElementBytes() const { return precision == CPLX_TENSOR_C64 ? 8 : 16; }
+
+  // Bytes from offset to the end of the payload.
+  uint64_t PayloadBytes() const {
+    if (!count)
+      return 0;
+    if (layout == CPLX_TENSOR_SOA)
+      return (uint64_t)rows * cols * stride * ElementBytes();
+    return ((count - 1) * stride + (uint64_t)rows * cols) * ElementBytes();
+  }
+
+  // 0 if the header is consistent, else what is wrong with it.
+  const char* Check() const {
+    if (memcmp(magic, INVERSION_CPLX_TENSOR_MAGIC, 8))
+      return "not a tensor file";
+    if (version != INVERSION_CPLX_TENSOR_VERSION)
+      return "unsupported version";
+    if (precision > CPLX_TENSOR_C64 || layout > CPLX_TENSOR_SOA)
+      return "unknown precision or layout";
+    if (!rows || !cols)
+      return "empty matrices";
+    if (layout == CPLX_TENSOR_SOA ? stride < count : stride < (uint64_t)rows * cols)
+      return "stride too small";
+    if (offset < sizeof(CplxTensorHeader) || offset % 4096)
+      return "payload offset not page aligned";
+    return 0;
+  }
+};
+
+static_assert(sizeof(CplxTensorHeader) == 64, "the tensor header is 64 bytes");
+
+class CplxTensorFile {
+public:
+  CplxTensorFile() : fd(-1), base(0), size(0), writable(false), error(0) {}
+  ~CplxTensorFile() { Close(); }
+
+  // Maps an existing file. Returns false, with Error() set, if it cannot be opened or is not a tensor.
+  bool Open(const char* path, bool writable_ = false) {
+    Close();
+    writable = writable_;
+    fd = open(path, writable ? O_RDWR : O_RDONLY);
+    if (fd < 0)
+      return Fail("cannot open file");
+    struct stat st;
+    if (fstat(fd, &st) || (uint64_t)st.st_size < sizeof(CplxTensorHeader))
+      return Fail("file too short");
+    size = st.st_size;
+    if (!Map())
+      return false;
+    const char* bad = Header().Check();
+    if (bad)
+      return Fail(bad);
+    if (Header().offset + Header().PayloadBytes() > size)
+      return Fail("payload truncated");
+    return true;
+  }
+
+  // Creates (or truncates) path, sized for h, and maps it read-write with the header written.
+  bool Create(const char* path, const CplxTensorHeader& h) {
+    Close();
+    writable = true;
+    const char* bad = h.Check();
+    if (bad)
+      return Fail(bad);
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      return Fail("cannot create file");
+    size = h.offset + h.PayloadBytes();
+    if (ftruncate(fd, size))
+      return Fail("cannot size file");
+    if (!Map())
+      return false;
+    memcpy(base, &h, sizeof(h));
+    return true;
+  }
+
+  void Close() {
+    if (base) {
+      if (writable)
+        msync(base, size, MS_SYNC);
+      munmap(base, size);
+    }
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+    base = 0;
+    size = 0;
+    error = 0;
+  }
+
+  const CplxTensorHeader& Header() const { return *(const CplxTensorHeader*)base; }
+  const char* Error() const { return error; }
+
+  // Start of the payload; AoS matrix k at Data<T>() + k * stride.
+  template <typename T>
+  std::complex<T>* Data() const { return (std::complex<T>*)(base + Header().offset); }
+
+  // Real and imaginary planes of a SoA payload.
+  template <typename T>
+  T* Re() const { return (T*)(base + Header().offset); }
+  template <typename T>
+  T* Im() const { return Re<T>() + (size_t)Header().rows * Header().cols * Header().stride; }
+
+  // Tells the kernel the payload is read front to back, so it reads ahead.
+  void AdviseSequential() const {
+    madvise(base, size, MADV_SEQUENTIAL);
+  }
+
+  /*
+  Drops the whole pages of payload bytes [begin, end) from the mapping, writing modified ones back
+  first. The data stays in the file; touching it again faults it back in.
+  */
+  void Release(uint64_t begin, uint64_t end) const {
+    const uint64_t page = (uint64_t)sysconf(_SC_PAGESIZE);
+    begin = (Header().offset + begin + page - 1) / page * page;
+    end = (Header().offset + end) / page * page;
+    if (end <= begin)
+      return;
+    if (writable)
+      msync(base + begin, end - begin, MS_SYNC);
+    madvise(base + begin, end - begin, MADV_DONTNEED);
+  }
+
+private:
+  CplxTensorFile(const CplxTensorFile&);
+  CplxTensorFile& operator=(const CplxTensorFile&);
+
+  bool Map() {
+    void* p = mmap(0, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED)
+      return Fail("cannot map file");
+    base = (char*)p;
+    return true;
+  }
+
+  bool Fail(const char* what) {
+    Close();
+    error = what;
+    return false;
+  }
+
+  int fd;
+  char* base;
+  uint64_t size;
+  bool writable;
+  const char* error;
+};
+
+#endif
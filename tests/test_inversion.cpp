@@ -0,0 +1,916 @@
+/*
+Correctness checks for the inversion paths : A inv(A) ~ I over dim 1 - 32 for the scalar
+(InvertCplx), fixed-size (InvertCplxFast<N>), SoA (every SIMD level the CPU has), float and
+batch calls, on well-conditioned random matrices, on the same matrices scaled to large
+magnitudes, and on singular matrices, which must be reported rather than returned as an
+inverse. Every other public API has at least a residual or identity check of its own, tagged
+with the request that added it. Prints every failed check and exits 1 if there was one.
+*/
+#include "inversion.h"
+#include "inversion_arena.h"
+#include "inversion_async.h"
+#include "inversion_eig.h"
+#include "inversion_parallel.h"
+#include "inversion_simd.h"
+#include "inversion_stream.h"
+#include "inversion_structured.h"
+#include "inversion_tensor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+typedef std::complex<double> Cplx;
+typedef std::complex<float> CplxF;
+
+static int g_failed = 0;
+static int g_checks = 0;
+
+static void Check(bool ok, const char* what, int dim, double value = 0.0) {
+  g_checks++;
+  if (!ok) {
+    g_failed++;
+    printf("FAILED %s, dim %d (%g)\n", what, dim, value);
+  }
+}
+
+/*
+Random dim x dim matrix, entries in the unit square plus dim on the diagonal, so it is
+well-conditioned at every size; times scale.
+*/
+template <typename T>
+static void RandomMatrix(std::complex<T>* A, int dim, double scale, std::mt19937& rng) {
+  std::uniform_real_distribution<double> u(-1.0, 1.0);
+  for (int i = 0; i < dim; i++)
+    for (int j = 0; j < dim; j++)
+      A[i * dim + j] = std::complex<T>(T(scale * (u(rng) + (i == j ? dim : 0.0))), T(scale * u(rng)));
+}
+
+// Same, with the last row zero : singular, and det is exactly 0 in every expansion.
+template <typename T>
+static void SingularMatrix(std::complex<T>* A, int dim, std::mt19937& rng) {
+  RandomMatrix(A, dim, 1.0, rng);
+  for (int j = 0; j < dim; j++)
+    A[(dim - 1) * dim + j] = 0.0;
+}
+
+// Same, with the first column zero : the elimination paths meet the zero pivot at their first step.
+template <typename T>
+static void ZeroColumnMatrix(std::complex<T>* A, int dim, std::mt19937& rng) {
+  RandomMatrix(A, dim, 1.0, rng);
+  for (int i = 0; i < dim; i++)
+    A[i * dim] = 0.0;
+}
+
+// max |(A B - I)_ij|, accumulated in double; NaN / inf results give inf.
+template <typename T>
+static double Residual(const std::complex<T>* A, const std::complex<T>* B, int dim) {
+  double r = 0.0;
+  for (int i = 0; i < dim; i++)
+    for (int j = 0; j < dim; j++) {
+      Cplx s = i == j ? -1.0 : 0.0;
+      for (int k = 0; k < dim; k++)
+        s += Cplx(A[i * dim + k]) * Cplx(B[k * dim + j]);
+      const double e = std::abs(s);
+      if (!(e <= r))
+        r = std::isfinite(e) ? e : HUGE_VAL;
+    }
+  return r;
+}
+
+// M M^H + dim I for a random M : Hermitian positive definite, with an exactly Hermitian result.
+static void HermMatrix(Cplx* A, int dim, std::mt19937& rng) {
+  std::vector<Cplx> M(dim * dim);
+  RandomMatrix(&M[0], dim, 1.0 / dim, rng);
+  for (int i = 0; i < dim; i++)
+    for (int j = 0; j < dim; j++) {
+      Cplx s = i == j ? dim : 0.0;
+      for (int k = 0; k < dim; k++)
+        s += M[i * dim + k] * std::conj(M[j * dim + k]);
+      A[i * dim + j] = s;
+    }
+}
+
+// max |A x - b| over dim x nrhs row-major b and x.
+static double SolveResidual(const Cplx* A, const Cplx* b, const Cplx* x, int dim, int nrhs) {
+  double r = 0.0;
+  for (int i = 0; i < dim; i++)
+    for (int c = 0; c < nrhs; c++) {
+      Cplx s = -b[i * nrhs + c];
+      for (int k = 0; k < dim; k++)
+        s += A[i * dim + k] * x[k * nrhs + c];
+      const double e = std::abs(s);
+      if (!(e <= r))
+        r = std::isfinite(e) ? e : HUGE_VAL;
+    }
+  return r;
+}
+
+static void TestScalar(std::mt19937& rng) {
+  CplxInvWorkspace ws;
+  for (int dim = 1; dim <= 32; dim++) {
+    std::vector<Cplx> A(dim * dim), B(dim * dim);
+    RandomMatrix(&A[0], dim, 1.0, rng);
+    InvertCplx(CplxConstMatrixView(&A[0], dim), CplxMatrixView(&B[0], dim), ws);
+    Check(Residual(&A[0], &B[0], dim) < 1e-10, "InvertCplx", dim, Residual(&A[0], &B[0], dim));
+
+    // det grows as scale^dim, so the scale is kept where it stays representable
+    RandomMatrix(&A[0], dim, dim <= 6 ? 1e40 : 1e8, rng);
+    InvertCplx(CplxConstMatrixView(&A[0], dim), CplxMatrixView(&B[0], dim), ws);
+    Check(Residual(&A[0], &B[0], dim) < 1e-10, "InvertCplx large magnitude", dim, Residual(&A[0], &B[0], dim));
+
+    SingularMatrix(&A[0], dim, rng);
+    const int flags = InvertCplxChecked(CplxConstMatrixView(&A[0], dim), CplxMatrixView(&B[0], dim),
+      CplxInvOptions(), ws);
+    Check((flags & CPLX_INV_FAILED) != 0, "InvertCplxChecked singular", dim, flags);
+
+    // user-005 : a zero pivot column gives det 0, not NaN, and an inverse flagged as failed
+    ZeroColumnMatrix(&A[0], dim, rng);
+    const Cplx det = DetCplx(CplxConstMatrixView(&A[0], dim), ws);
+    const Cplx det2 = InvertAndDetCplx(CplxConstMatrixView(&A[0], dim), CplxMatrixView(&B[0], dim), ws);
+    Check(det == 0.0 && det2 == 0.0, "DetCplx / InvertAndDetCplx zero column", dim, std::abs(det) + std::abs(det2));
+    const int flags2 = InvertCplxChecked(CplxConstMatrixView(&A[0], dim), CplxMatrixView(&B[0], dim),
+      CplxInvOptions(), ws);
+    Check((flags2 & CPLX_INV_FAILED) != 0, "InvertCplxChecked zero column", dim, flags2);
+  }
+}
+
+template <int N, typename T>
+static void TestFastN(std::mt19937& rng, double large, double tol) {
+  typedef std::complex<T> ET;
+  typedef CplxRowMajorPtr<const ET> In;
+  typedef CplxRowMajorPtr<ET> Out;
+  ET A[N * N], B[N * N];
+  const char* name = sizeof(T) == 8 ? "InvertCplxFast" : "InvertCplxFast float";
+
+  RandomMatrix(A, N, 1.0, rng);
+  InvertCplxFast<N>(In(A, N), Out(B, N));
+  Check(Residual(A, B, N) < tol, name, N, Residual(A, B, N));
+
+  // the packed kernels must not lose the inverse when |det|^2 overflows
+  RandomMatrix(A, N, large, rng);
+  InvertCplxFast<N>(In(A, N), Out(B, N));
+  Check(Residual(A, B, N) < tol, name, N, Residual(A, B, N));
+
+  SingularMatrix(A, N, rng);
+  const ET det = InvertAndDetCplxFast<N>(In(A, N), Out(B, N));
+  Check(det == ET(0), "InvertAndDetCplxFast singular det", N, std::abs(det));
+}
+
+template <typename T>
+static void TestFast(std::mt19937& rng, double large, double tol) {
+  TestFastN<1, T>(rng, large, tol);
+  TestFastN<2, T>(rng, large, tol);
+  TestFastN<3, T>(rng, large, tol);
+  TestFastN<4, T>(rng, large, tol);
+  TestFastN<5, T>(rng, large, tol);
+  TestFastN<6, T>(rng, large, tol);
+}
+
+static void TestSoA(std::mt19937& rng) {
+  // not a multiple of any vector width, so the scalar tail is exercised too
+  const size_t count = 13;
+  const CplxSimdLevel detected = CplxSimdLevelSelected();
+  for (int level = CPLX_SIMD_SCALAR; level <= detected; level++) {
+    SetCplxSimdLevel((CplxSimdLevel)level);
+    for (int dim = 1; dim <= 32; dim++) {
+      const size_t nn = (size_t)dim * dim;
+      std::vector<Cplx> A(nn * count), B(nn * count);
+      std::vector<double> Are(nn * count), Aim(nn * count), Bre(nn * count), Bim(nn * count);
+      // matrix 3 is large, 5 and 11 are singular
+      for (size_t m = 0; m < count; m++) {
+        if (m == 5 || m == 11)
+          SingularMatrix(&A[m * nn], dim, rng);
+        else
+          RandomMatrix(&A[m * nn], dim, m != 3 ? 1.0 : (dim <= 6 ? 1e40 : 1e8), rng);
+      }
+      CplxBatchToSoA(&A[0], dim, count, nn, &Are[0], &Aim[0], count);
+      const size_t failed = InvertCplxBatchSoA(&Are[0], &Aim[0], &Bre[0], &Bim[0], dim, count, count);
+      CplxBatchFromSoA(&Bre[0], &Bim[0], count, &B[0], dim, count, nn);
+
+      Check(failed == 2, "InvertCplxBatchSoA failure count", dim, (double)failed);
+      double r = 0.0;
+      for (size_t m = 0; m < count; m++)
+        if (m != 5 && m != 11)
+          r = std::max(r, Residual(&A[m * nn], &B[m * nn], dim));
+      Check(r < 1e-10, level == CPLX_SIMD_SCALAR ? "InvertCplxBatchSoA scalar" : "InvertCplxBatchSoA simd", dim, r);
+    }
+
+    /*
+    user-016 in place, with a lane the packed kernel cannot do : det of diag(1e-155, 1e-155, 1)
+    is subnormal, its packed reciprocal inf, so the lane is redone after B has overwritten A.
+    */
+    const int dim = 3;
+    const size_t nn = dim * dim;
+    std::vector<Cplx> A(nn * count), B(nn * count);
+    std::vector<double> re(nn * count), im(nn * count);
+    for (size_t m = 0; m < count; m++)
+      RandomMatrix(&A[m * nn], dim, 1.0, rng);
+    for (size_t e = 0; e < nn; e++)
+      A[2 * nn + e] = 0.0;
+    A[2 * nn] = A[2 * nn + 4] = 1e-155;
+    A[2 * nn + 8] = 1.0;
+    CplxBatchToSoA(&A[0], dim, count, nn, &re[0], &im[0], count);
+    const size_t failed = InvertCplxBatchSoA(&re[0], &im[0], &re[0], &im[0], dim, count, count);
+    CplxBatchFromSoA(&re[0], &im[0], count, &B[0], dim, count, nn);
+    Check(failed == 0 && std::abs(B[2 * nn] / 1e155 - 1.0) < 1e-12, "InvertCplxBatchSoA in place redo", dim,
+      (double)failed);
+    double r = 0.0;
+    for (size_t m = 0; m < count; m++)
+      r = std::max(r, Residual(&A[m * nn], &B[m * nn], dim));
+    Check(r < 1e-10, "InvertCplxBatchSoA in place", dim, r);
+  }
+  SetCplxSimdLevel(detected);
+}
+
+static void TestFloatBatch(std::mt19937& rng) {
+  const size_t count = 5;
+  CplxInvWorkspaceF ws;
+  for (int dim = 1; dim <= 32; dim++) {
+    const size_t nn = (size_t)dim * dim;
+    std::vector<CplxF> A(nn * count), B(nn * count);
+    for (size_t m = 0; m < count; m++)
+      RandomMatrix(&A[m * nn], dim, m != 2 ? 1.0 : (dim <= 6 ? 1e5 : 1e3), rng);
+    InvertCplxBatch(&A[0], &B[0], dim, count, nn, ws);
+    double r = 0.0;
+    for (size_t m = 0; m < count; m++)
+      r = std::max(r, Residual(&A[m * nn], &B[m * nn], dim));
+    Check(r < 1e-3, "InvertCplxBatch float", dim, r);
+  }
+}
+
+static void TestBatch(std::mt19937& rng) {
+  const size_t count = 6;
+  CplxInvWorkspace ws;
+  CplxBatchExecutor pool(2);
+  // 40 : past INVERSION_CPLX_NATIVE_MAX, the LAPACK branch
+  for (int dim = 1; dim <= 40; dim = dim < 32 ? dim + 1 : dim + 8) {
+    const size_t nn = (size_t)dim * dim;
+    std::vector<Cplx> A(nn * count), B(nn * count);
+    for (size_t m = 0; m < count; m++)
+      RandomMatrix(&A[m * nn], dim, m != 1 ? 1.0 : (dim <= 6 ? 1e40 : 1e8), rng);
+    InvertCplxBatch(&A[0], &B[0], dim, count, nn, ws);
+    double r = 0.0;
+    for (size_t m = 0; m < count; m++)
+      r = std::max(r, Residual(&A[m * nn], &B[m * nn], dim));
+    Check(r < 1e-10, "InvertCplxBatch", dim, r);
+
+    // matrix 4 singular : counted by the checked batch, serial and on the pool
+    SingularMatrix(&A[4 * nn], dim, rng);
+    std::vector<int> flags(count);
+    size_t failed = InvertCplxBatchChecked(&A[0], &B[0], dim, count, nn, CplxInvOptions(), &flags[0], 0, ws);
+    Check(failed == 1 && (flags[4] & CPLX_INV_FAILED), "InvertCplxBatchChecked singular", dim, (double)failed);
+    r = 0.0;
+    for (size_t m = 0; m < count; m++)
+      if (m != 4)
+        r = std::max(r, Residual(&A[m * nn], &B[m * nn], dim));
+    Check(r < 1e-10, "InvertCplxBatchChecked", dim, r);
+
+    failed = pool.InvertBatchChecked(&A[0], &B[0], dim, count, nn);
+    Check(failed == 1, "CplxBatchExecutor::InvertBatchChecked singular", dim, (double)failed);
+  }
+}
+
+// user-006 : Hermitian positive definite inverse and determinant, reading the lower triangle only.
+static void TestHerm(std::mt19937& rng) {
+  typedef CplxRowMajorPtr<const Cplx> In;
+  typedef CplxRowMajorPtr<Cplx> Out;
+  CplxInvWorkspace ws;
+  for (int dim = 1; dim <= 32; dim++) {
+    std::vector<Cplx> A(dim * dim), L(dim * dim), B(dim * dim);
+    HermMatrix(&A[0], dim, rng);
+    L = A;
+    for (int i = 0; i < dim; i++)
+      for (int j = i + 1; j < dim; j++)
+        L[i * dim + j] = Cplx(1e3, -1e3);
+    const int info = InvertHermCplx(In(&L[0], dim), Out(&B[0], dim), dim, CPLX_FULL, ws);
+    Check(info == 0 && Residual(&A[0], &B[0], dim) < 1e-10, "InvertHermCplx", dim, Residual(&A[0], &B[0], dim));
+
+    const double det = DetHermCplx(In(&L[0], dim), dim, ws);
+    const Cplx ref = DetCplx(CplxConstMatrixView(&A[0], dim), ws);
+    Check(std::abs(det - ref) <= 1e-10 * std::abs(ref), "DetHermCplx", dim, std::abs(det - ref));
+
+    // a negative diagonal entry : not positive definite, reported, B untouched
+    L[0] = -1.0;
+    std::fill(B.begin(), B.end(), Cplx(7.0));
+    const int info2 = InvertHermCplx(In(&L[0], dim), Out(&B[0], dim), dim, CPLX_FULL, ws);
+    Check(info2 > 0 && B[0] == 7.0 && B[dim * dim - 1] == 7.0, "InvertHermCplx not positive definite", dim, info2);
+    Check(DetHermCplx(In(&L[0], dim), dim, ws) == 0.0, "DetHermCplx not positive definite", dim);
+  }
+}
+
+// user-007 : SolveCplx / SolveHermCplx with several right-hand sides, out of place and in place.
+static void TestSolve(std::mt19937& rng) {
+  typedef CplxRowMajorPtr<const Cplx> In;
+  CplxInvWorkspace ws;
+  const int nrhs = 3;
+  for (int dim = 1; dim <= 32; dim++) {
+    std::vector<Cplx> A(dim * dim), H(dim * dim), b(dim * nrhs), x(dim * nrhs), y(dim * nrhs);
+    RandomMatrix(&A[0], dim, 1.0, rng);
+    HermMatrix(&H[0], dim, rng);
+    for (int i = 0; i < dim * nrhs; i++)
+      b[i] = Cplx(i % 7 - 3.0, i % 5 - 2.0);
+
+    int info = SolveCplx(In(&A[0], dim), &b[0], &x[0], dim, nrhs, ws);
+    double r = SolveResidual(&A[0], &b[0], &x[0], dim, nrhs);
+    Check(info == 0 && r < 1e-10, "SolveCplx", dim, r);
+    y = b;
+    info = SolveCplx(In(&A[0], dim), &y[0], &y[0], dim, nrhs, ws);
+    r = SolveResidual(&A[0], &b[0], &y[0], dim, nrhs);
+    Check(info == 0 && r < 1e-10, "SolveCplx in place", dim, r);
+
+    info = SolveHermCplx(In(&H[0], dim), &b[0], &x[0], dim, nrhs, ws);
+    r = SolveResidual(&H[0], &b[0], &x[0], dim, nrhs);
+    Check(info == 0 && r < 1e-10, "SolveHermCplx", dim, r);
+    y = b;
+    info = SolveHermCplx(In(&H[0], dim), &y[0], &y[0], dim, nrhs, ws);
+    r = SolveResidual(&H[0], &b[0], &y[0], dim, nrhs);
+    Check(info == 0 && r < 1e-10, "SolveHermCplx in place", dim, r);
+
+    ZeroColumnMatrix(&A[0], dim, rng);
+    info = SolveCplx(In(&A[0], dim), &b[0], &x[0], dim, nrhs, ws);
+    Check(info > 0, "SolveCplx zero column", dim, info);
+  }
+}
+
+// user-008 : CplxLUFactorization reused for det, log-det, solves and the inverse.
+static void TestLUFactorization(std::mt19937& rng) {
+  CplxLUFactorization unfactored;
+  Cplx x0[1];
+  Check(unfactored.Det() == 1.0 && unfactored.LogDet() == 0.0 && unfactored.Solve(x0, x0) == -1 &&
+    unfactored.Inverse(CplxMatrixView(x0, 1)) == -1, "CplxLUFactorization before Factor", 0);
+
+  CplxLUFactorization lu;
+  for (int dim = 1; dim <= 32; dim++) {
+    const int nrhs = 3;
+    std::vector<Cplx> A(dim * dim), B(dim * dim), b(dim * nrhs), x(dim * nrhs);
+    RandomMatrix(&A[0], dim, 1.0, rng);
+    for (int i = 0; i < dim * nrhs; i++)
+      b[i] = Cplx(i % 7 - 3.0, i % 5 - 2.0);
+    Check(lu.Factor(CplxConstMatrixView(&A[0], dim), dim) == 0, "CplxLUFactorization::Factor", dim);
+
+    const Cplx det = DetCplx(CplxConstMatrixView(&A[0], dim));
+    Check(std::abs(lu.Det() - det) <= 1e-10 * std::abs(det), "CplxLUFactorization::Det", dim,
+      std::abs(lu.Det() - det));
+    Check(std::abs(std::exp(lu.LogDet()) - det) <= 1e-10 * std::abs(det), "CplxLUFactorization::LogDet", dim);
+
+    lu.Solve(&b[0], &x[0], nrhs);
+    const double r = SolveResidual(&A[0], &b[0], &x[0], dim, nrhs);
+    Check(r < 1e-10, "CplxLUFactorization::Solve", dim, r);
+
+    lu.Inverse(CplxMatrixView(&B[0], dim));
+    Check(Residual(&A[0], &B[0], dim) < 1e-10, "CplxLUFactorization::Inverse", dim, Residual(&A[0], &B[0], dim));
+  }
+}
+
+/*
+user-010 : CplxBatchExecutor calls from several threads are serialized. Two callers at different
+dims, each with 8 singular matrices out of 64, must each get back their own failure count.
+*/
+struct ConcurrentCaller {
+  CplxBatchExecutor* pool;
+  int dim;
+  int calls;
+  int wrong;
+  void operator()() {
+    const size_t count = 64, nn = (size_t)dim * dim;
+    std::mt19937 rng(dim);
+    std::vector<Cplx> A(nn * count), B(nn * count);
+    for (size_t m = 0; m < count; m++) {
+      if (m % 8 == 3)
+        SingularMatrix(&A[m * nn], dim, rng);
+      else
+        RandomMatrix(&A[m * nn], dim, 1.0, rng);
+    }
+    wrong = 0;
+    for (int c = 0; c < calls; c++)
+      if (pool->InvertBatchChecked(&A[0], &B[0], dim, count, nn) != 8)
+        wrong++;
+  }
+};
+
+static void TestConcurrentCallers() {
+  CplxBatchExecutor pool(2);
+  ConcurrentCaller a = { &pool, 9, 200, 0 }, b = { &pool, 16, 200, 0 };
+  std::thread ta(std::ref(a)), tb(std::ref(b));
+  ta.join();
+  tb.join();
+  Check(a.wrong == 0 && b.wrong == 0, "CplxBatchExecutor concurrent callers", 9, a.wrong + b.wrong);
+}
+
+// user-009 : rank-1 / rank-k inverse updates against the inverse of the updated matrix, and CplxRecursiveInverse.
+static void TestUpdate(std::mt19937& rng) {
+  typedef CplxRowMajorPtr<Cplx> Out;
+  CplxInvWorkspace ws;
+  const Cplx alpha(0.9, 0.1), beta(0.5, -0.2);
+  const int k = 3;
+  for (int dim = 1; dim <= 20; dim++) {
+    std::vector<Cplx> A(dim * dim), Ainv(dim * dim), A2(dim * dim), U(dim * k), V(dim * k);
+    RandomMatrix(&A[0], dim, 1.0, rng);
+    for (int i = 0; i < dim * k; i++) {
+      U[i] = Cplx(std::sin(1.0 + i), std::cos(2.0 * i)) * 0.5;
+      V[i] = Cplx(std::cos(3.0 + i), std::sin(0.5 * i)) * 0.5;
+    }
+
+    // rank 1 : column 0 of U and V
+    std::vector<Cplx> u(dim), v(dim);
+    for (int i = 0; i < dim; i++) {
+      u[i] = U[i * k];
+      v[i] = V[i * k];
+    }
+    for (int i = 0; i < dim; i++)
+      for (int j = 0; j < dim; j++)
+        A2[i * dim + j] = alpha * A[i * dim + j] + beta * u[i] * std::conj(v[j]);
+    InvertCplx(CplxConstMatrixView(&A[0], dim), CplxMatrixView(&Ainv[0], dim), ws);
+    int info = UpdateInvCplxRank1(Out(&Ainv[0], dim), dim, alpha, beta, &u[0], &v[0], ws);
+    Check(info == 0 && Residual(&A2[0], &Ainv[0], dim) < 1e-10, "UpdateInvCplxRank1", dim,
+      Residual(&A2[0], &Ainv[0], dim));
+
+    const std::vector<Cplx> kept = Ainv;
+    info = UpdateInvCplxRank1(Out(&Ainv[0], dim), dim, 0.0, beta, &u[0], &v[0], ws);
+    Check(info == 1 && Ainv == kept, "UpdateInvCplxRank1 alpha 0", dim, info);
+
+    for (int i = 0; i < dim; i++)
+      for (int j = 0; j < dim; j++) {
+        Cplx s = alpha * A[i * dim + j];
+        for (int r = 0; r < k; r++)
+          s += beta * U[i * k + r] * std::conj(V[j * k + r]);
+        A2[i * dim + j] = s;
+      }
+    InvertCplx(CplxConstMatrixView(&A[0], dim), CplxMatrixView(&Ainv[0], dim), ws);
+    info = UpdateInvCplxRankK(Out(&Ainv[0], dim), dim, alpha, beta, &U[0], &V[0], k, ws);
+    Check(info == 0 && Residual(&A2[0], &Ainv[0], dim) < 1e-10, "UpdateInvCplxRankK", dim,
+      Residual(&A2[0], &Ainv[0], dim));
+
+    // R = I, then 12 snapshots, re-inverted every 5th update
+    CplxRecursiveInverse rec(dim, 5);
+    std::vector<Cplx> R0(dim * dim, 0.0), x(dim);
+    for (int i = 0; i < dim; i++)
+      R0[i * dim + i] = 1.0;
+    info = rec.Reset(&R0[0]);
+    double r = Residual(rec.Matrix(), rec.Inverse(), dim);
+    for (int t = 0; t < 12; t++) {
+      for (int i = 0; i < dim; i++)
+        x[i] = Cplx(std::cos(0.7 * i * t + 0.3), std::sin(1.3 * i + t));
+      info |= rec.Update(0.9, &x[0]);
+      r = std::max(r, Residual(rec.Matrix(), rec.Inverse(), dim));
+    }
+    Check(info == 0 && r < 1e-10, "CplxRecursiveInverse", dim, r);
+  }
+}
+
+// user-011 : CplxMixedLU reaches double accuracy from the single-precision factorization.
+static void TestMixedLU(std::mt19937& rng) {
+  CplxMixedLU unfactored;
+  Cplx x0[1];
+  Check(unfactored.Solve(x0, x0) == -1 && unfactored.Inverse(CplxMatrixView(x0, 1)) == -1,
+    "CplxMixedLU before Factor", 0);
+
+  CplxMixedLU lu;
+  const int nrhs = 2;
+  for (int dim = 1; dim <= 32; dim++) {
+    std::vector<Cplx> A(dim * dim), B(dim * dim), b(dim * nrhs), x(dim * nrhs);
+    RandomMatrix(&A[0], dim, 1.0, rng);
+    for (int i = 0; i < dim * nrhs; i++)
+      b[i] = Cplx(i % 7 - 3.0, i % 5 - 2.0);
+    Check(lu.Factor(CplxConstMatrixView(&A[0], dim), dim) == 0 && !lu.DoublePrecision(), "CplxMixedLU::Factor", dim);
+
+    const int info = lu.Solve(&b[0], &x[0], nrhs);
+    const double r = SolveResidual(&A[0], &b[0], &x[0], dim, nrhs);
+    Check(info == 0 && r < 1e-10, "CplxMixedLU::Solve", dim, r);
+
+    Check(lu.Inverse(CplxMatrixView(&B[0], dim)) == 0 && Residual(&A[0], &B[0], dim) < 1e-10, "CplxMixedLU::Inverse",
+      dim, Residual(&A[0], &B[0], dim));
+
+    ZeroColumnMatrix(&A[0], dim, rng);
+    Check(lu.Factor(CplxConstMatrixView(&A[0], dim), dim) > 0 && lu.Solve(&b[0], &x[0], nrhs) > 0,
+      "CplxMixedLU zero column", dim);
+  }
+}
+
+// user-014 : LogDetCplx against log(DetCplx), on singular matrices, and past the range of det itself.
+static void TestLogDet(std::mt19937& rng) {
+  CplxInvWorkspace ws;
+  for (int dim = 1; dim <= 32; dim++) {
+    std::vector<Cplx> A(dim * dim), S(dim * dim);
+    RandomMatrix(&A[0], dim, 1.0, rng);
+    const Cplx det = DetCplx(CplxConstMatrixView(&A[0], dim), ws);
+    const Cplx ld = LogDetCplx(CplxConstMatrixView(&A[0], dim), ws);
+    const double e = std::abs(ld.real() - std::log(std::abs(det))) +
+      std::abs(std::polar(1.0, ld.imag()) - det / std::abs(det));
+    Check(e < 1e-10, "LogDetCplx", dim, e);
+
+    ZeroColumnMatrix(&S[0], dim, rng);
+    const Cplx ls = LogDetCplx(CplxRowMajorPtr<const Cplx>(&S[0], dim), dim, ws);
+    Check(ls.real() == -HUGE_VAL, "LogDetCplx singular", dim, ls.real());
+
+    // det(1e20 A) = 1e(20 dim) det(A) overflows from dim 16 on; the log-det does not
+    for (int i = 0; i < dim * dim; i++)
+      S[i] = A[i] * 1e20;
+    const Cplx ll = LogDetCplx(CplxConstMatrixView(&S[0], dim), ws);
+    const double el = std::abs(ll.real() - ld.real() - dim * std::log(1e20)) +
+      std::abs(std::polar(1.0, ll.imag()) - std::polar(1.0, ld.imag()));
+    Check(el < 1e-9 * dim, "LogDetCplx large magnitude", dim, el);
+  }
+
+  Cplx A[3 * 3];
+  RandomMatrix(A, 3, 1.0, rng);
+  const Cplx l3 = LogDetCplx<3>(CplxRowMajorPtr<const Cplx>(A, 3)), ln = LogDetCplx(CplxConstMatrixView(A, 3));
+  Check(std::abs(l3 - ln) < 1e-12, "LogDetCplx<3>", 3, std::abs(l3 - ln));
+}
+
+// user-015 : MVDR weights of the fused stream against a reference covariance tracked here, sync and async.
+static void TestStream(std::mt19937& rng) {
+  const int bins = 3, n = 4, frames = 6;
+  const double alpha = 0.8;
+  std::vector<Cplx> d(bins * n), x(frames * bins * n), w(bins * n), wa(bins * n), R(bins * n * n, 0.0), y(n);
+  for (size_t i = 0; i < d.size(); i++)
+    d[i] = std::polar(1.0, 0.9 * i);
+  for (size_t i = 0; i < x.size(); i++)
+    x[i] = Cplx(std::sin(1.7 * i), std::cos(0.3 * i * i));
+  for (int b = 0; b < bins; b++)
+    for (int i = 0; i < n; i++)
+      R[(b * n + i) * n + i] = 1.0;
+
+  CplxCovarianceStream stream(bins, n, alpha, &d[0]), async(bins, n, alpha, &d[0]);
+  stream.Reset(1.0);
+  async.Reset(1.0);
+  double e = 0.0;
+  size_t failed = 0;
+  for (int f = 0; f < frames; f++) {
+    const Cplx* xf = &x[f * bins * n];
+    failed += stream.Process(xf, &w[0]);
+    async.Submit(xf);
+    for (int b = 0; b < bins; b++) {
+      Cplx* Rb = &R[b * n * n];
+      for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+          Rb[i * n + j] = alpha * Rb[i * n + j] + (1.0 - alpha) * xf[b * n + i] * std::conj(xf[b * n + j]);
+      SolveCplx(CplxRowMajorPtr<const Cplx>(Rb, n), &d[b * n], &y[0], n);
+      Cplx s = 0.0;
+      for (int i = 0; i < n; i++)
+        s += std::conj(d[b * n + i]) * y[i];
+      for (int i = 0; i < n; i++)
+        e = std::max(e, std::abs(w[b * n + i] - y[i] / s));
+    }
+  }
+  Check(failed == 0 && e < 1e-10, "CplxCovarianceStream::Process", n, e);
+
+  async.Wait();
+  size_t failedBins = 1;
+  const size_t done = async.Weights(&wa[0], &failedBins);
+  e = 0.0;
+  for (size_t i = 0; i < w.size(); i++)
+    e = std::max(e, std::abs(wa[i] - w[i]));
+  Check(done == (size_t)frames && failedBins == 0 && e < 1e-12, "CplxCovarianceStream::Submit", n, e);
+}
+
+// user-016 : B == A on every path that allows it.
+static void TestInPlace(std::mt19937& rng) {
+  CplxInvWorkspace ws;
+  CplxInvWorkspaceT<float> wsf;
+  for (int dim = 1; dim <= 40; dim = dim < 32 ? dim + 1 : dim + 8) {
+    const size_t nn = (size_t)dim * dim, count = 3;
+    std::vector<Cplx> A(nn * count), C(nn * count);
+    std::vector<Cplx*> rows(dim);
+    for (size_t m = 0; m < count; m++)
+      RandomMatrix(&A[m * nn], dim, 1.0, rng);
+
+    C = A;
+    InvertCplx(CplxConstMatrixView(&C[0], dim), CplxMatrixView(&C[0], dim), ws);
+    Check(Residual(&A[0], &C[0], dim) < 1e-10, "InvertCplx view in place", dim, Residual(&A[0], &C[0], dim));
+
+    C = A;
+    InvertCplxInPlace(CplxMatrixView(&C[0], dim), ws);
+    Check(Residual(&A[0], &C[0], dim) < 1e-10, "InvertCplxInPlace", dim, Residual(&A[0], &C[0], dim));
+
+    C = A;
+    for (int i = 0; i < dim; i++)
+      rows[i] = &C[i * dim];
+    InvertCplx(&rows[0], &rows[0], dim, ws);
+    Check(Residual(&A[0], &C[0], dim) < 1e-10, "InvertCplx rows in place", dim, Residual(&A[0], &C[0], dim));
+
+    C = A;
+    const int flags = InvertCplxChecked(CplxConstMatrixView(&C[0], dim), CplxMatrixView(&C[0], dim),
+      CplxInvOptions(), ws);
+    Check(!(flags & CPLX_INV_FAILED) && Residual(&A[0], &C[0], dim) < 1e-10, "InvertCplxChecked in place", dim,
+      Residual(&A[0], &C[0], dim));
+
+    C = A;
+    InvertCplxBatch(&C[0], &C[0], dim, count, nn, ws);
+    double r = 0.0;
+    for (size_t m = 0; m < count; m++)
+      r = std::max(r, Residual(&A[m * nn], &C[m * nn], dim));
+    Check(r < 1e-10, "InvertCplxBatch in place", dim, r);
+
+    std::vector<CplxF> Af(A.begin(), A.end()), Cf(Af);
+    InvertCplxBatch(&Cf[0], &Cf[0], dim, count, nn, wsf);
+    r = 0.0;
+    for (size_t m = 0; m < count; m++)
+      r = std::max(r, Residual(&Af[m * nn], &Cf[m * nn], dim));
+    Check(r < 1e-3, "InvertCplxBatch float in place", dim, r);
+
+    HermMatrix(&A[0], dim, rng);
+    C = A;
+    const int info = InvertHermCplx(CplxRowMajorPtr<const Cplx>(&C[0], dim), CplxRowMajorPtr<Cplx>(&C[0], dim), dim,
+      CPLX_FULL, ws);
+    Check(info == 0 && Residual(&A[0], &C[0], dim) < 1e-10, "InvertHermCplx in place", dim,
+      Residual(&A[0], &C[0], dim));
+  }
+}
+
+// user-020 : block-diagonal and Kronecker inverses / determinants against the assembled full matrix.
+static void TestStructured(std::mt19937& rng) {
+  CplxInvWorkspace ws;
+  const int blocks[] = { 2, 3, 1, 4, 7 }, nblocks = 5, dim = 17;
+  const size_t nn = (size_t)dim * dim, count = 2;
+  std::vector<Cplx> A(nn * count, 0.0), B(nn * count), C(nn);
+  for (size_t m = 0; m < count; m++)
+    for (int b = 0, r0 = 0; b < nblocks; r0 += blocks[b++]) {
+      std::vector<Cplx> blk(blocks[b] * blocks[b]);
+      RandomMatrix(&blk[0], blocks[b], 1.0, rng);
+      for (int i = 0; i < blocks[b]; i++)
+        for (int j = 0; j < blocks[b]; j++)
+          A[m * nn + (r0 + i) * dim + r0 + j] = blk[i * blocks[b] + j];
+    }
+  std::fill(B.begin(), B.end(), Cplx(7.0));
+  InvertCplxBlockDiag(CplxConstMatrixView(&A[0], dim), CplxMatrixView(&B[0], dim), blocks, nblocks, ws);
+  Check(Residual(&A[0], &B[0], dim) < 1e-10, "InvertCplxBlockDiag", dim, Residual(&A[0], &B[0], dim));
+  const Cplx det = DetCplxBlockDiag(CplxConstMatrixView(&A[0], dim), blocks, nblocks, ws);
+  const Cplx ref = DetCplx(CplxConstMatrixView(&A[0], dim), ws);
+  Check(std::abs(det - ref) <= 1e-10 * std::abs(ref), "DetCplxBlockDiag", dim, std::abs(det - ref));
+  std::copy(A.begin(), A.begin() + nn, C.begin());
+  InvertCplxBlockDiag(CplxConstMatrixView(&C[0], dim), CplxMatrixView(&C[0], dim), blocks, nblocks, ws);
+  Check(Residual(&A[0], &C[0], dim) < 1e-10, "InvertCplxBlockDiag in place", dim, Residual(&A[0], &C[0], dim));
+
+  std::fill(B.begin(), B.end(), Cplx(7.0));
+  InvertCplxBlockDiagBatch(&A[0], &B[0], dim, blocks, nblocks, count, nn, ws);
+  double r = 0.0;
+  for (size_t m = 0; m < count; m++)
+    r = std::max(r, Residual(&A[m * nn], &B[m * nn], dim));
+  Check(r < 1e-10, "InvertCplxBlockDiagBatch", dim, r);
+
+  // Kronecker : 3 (x) 4 on the fixed kernels, 5 (x) 7 with Q on the native path
+  const int ps[] = { 3, 5 }, qs[] = { 4, 7 };
+  for (int t = 0; t < 2; t++) {
+    const int p = ps[t], q = qs[t], n = p * q;
+    std::vector<Cplx> P(p * p * count), Q(q * q * count), K(n * n), Bk(n * n * count);
+    for (size_t m = 0; m < count; m++) {
+      RandomMatrix(&P[m * p * p], p, 1.0, rng);
+      RandomMatrix(&Q[m * q * q], q, 1.0, rng);
+    }
+    for (int i = 0; i < p; i++)
+      for (int j = 0; j < p; j++)
+        for (int k = 0; k < q; k++)
+          for (int l = 0; l < q; l++)
+            K[(i * q + k) * n + j * q + l] = P[i * p + j] * Q[k * q + l];
+    InvertCplxKron(CplxConstMatrixView(&P[0], p), CplxConstMatrixView(&Q[0], q), CplxMatrixView(&Bk[0], n), ws);
+    Check(Residual(&K[0], &Bk[0], n) < 1e-10, "InvertCplxKron", n, Residual(&K[0], &Bk[0], n));
+    const Cplx dk = DetCplxKron(CplxConstMatrixView(&P[0], p), CplxConstMatrixView(&Q[0], q), ws);
+    const Cplx dr = DetCplx(CplxConstMatrixView(&K[0], n), ws);
+    Check(std::abs(dk - dr) <= 1e-9 * std::abs(dr), "DetCplxKron", n, std::abs(dk - dr));
+
+    InvertCplxKronBatch(&P[0], &Q[0], &Bk[0], p, q, count, ws);
+    for (int i = 0; i < p; i++)
+      for (int j = 0; j < p; j++)
+        for (int k = 0; k < q; k++)
+          for (int l = 0; l < q; l++)
+            K[(i * q + k) * n + j * q + l] = P[p * p + i * p + j] * Q[q * q + k * q + l];
+    Check(Residual(&K[0], &Bk[n * n], n) < 1e-10, "InvertCplxKronBatch", n, Residual(&K[0], &Bk[n * n], n));
+  }
+}
+
+/*
+max |A V - V diag(w)| + max |V^H M V - I| (M = I, or Rn for the generalized problem, which is then
+solved for Rs V = Rn V diag(w)), and a penalty if w is not ascending.
+*/
+static double EigError(const Cplx* A, const Cplx* M, const double* w, const Cplx* V, int dim) {
+  double ev = 0.0, orth = 0.0;
+  for (int i = 0; i < dim; i++)
+    for (int j = 0; j < dim; j++) {
+      Cplx av = 0.0, mv = 0.0, vmv = i == j ? -1.0 : 0.0;
+      for (int k = 0; k < dim; k++) {
+        av += A[i * dim + k] * V[k * dim + j];
+        mv += (M ? M[i * dim + k] : Cplx(i == k ? 1.0 : 0.0)) * V[k * dim + j];
+      }
+      ev = std::max(ev, std::abs(av - mv * w[j]));
+      for (int k = 0; k < dim; k++)
+        for (int l = 0; l < dim; l++)
+          vmv += std::conj(V[k * dim + i]) * (M ? M[k * dim + l] : Cplx(k == l ? 1.0 : 0.0)) * V[l * dim + j];
+      orth = std::max(orth, std::abs(vmv));
+    }
+  for (int i = 0; i + 1 < dim; i++)
+    if (!(w[i] <= w[i + 1]))
+      return HUGE_VAL;
+  return std::isfinite(ev + orth) ? ev + orth : HUGE_VAL;
+}
+
+// user-022 : Hermitian and generalized Hermitian eigenproblems, single, batched and SoA.
+static void TestEig(std::mt19937& rng) {
+  typedef CplxRowMajorPtr<const Cplx> In;
+  typedef CplxRowMajorPtr<Cplx> Out;
+  CplxInvWorkspace ws;
+  for (int dim = 1; dim <= 12; dim++) {
+    const size_t nn = (size_t)dim * dim, count = 3;
+    std::vector<Cplx> A(nn * count), Rn(nn), V(nn * count);
+    std::vector<double> w(dim * count);
+    for (size_t m = 0; m < count; m++)
+      HermMatrix(&A[m * nn], dim, rng);
+    HermMatrix(&Rn[0], dim, rng);
+
+    int info = EigHermCplx(In(&A[0], dim), &w[0], Out(&V[0], dim), dim, ws);
+    double e = EigError(&A[0], 0, &w[0], &V[0], dim);
+    Check(info == 0 && e < 1e-10 * dim, "EigHermCplx", dim, e);
+
+    info = EigGenHermCplx(In(&A[0], dim), In(&Rn[0], dim), &w[0], Out(&V[0], dim), dim, ws);
+    e = EigError(&A[0], &Rn[0], &w[0], &V[0], dim);
+    Check(info == 0 && e < 1e-10 * dim, "EigGenHermCplx", dim, e);
+    Rn[0] = -1.0;
+    info = EigGenHermCplx(In(&A[0], dim), In(&Rn[0], dim), &w[0], Out(&V[0], dim), dim, ws);
+    Check(info > 0, "EigGenHermCplx Rn not positive definite", dim, info);
+
+    const size_t failed = EigHermCplxBatch(&A[0], &w[0], &V[0], dim, count, nn, 0, ws);
+    e = 0.0;
+    for (size_t m = 0; m < count; m++)
+      e = std::max(e, EigError(&A[m * nn], 0, &w[m * dim], &V[m * nn], dim));
+    Check(failed == 0 && e < 1e-10 * dim, "EigHermCplxBatch", dim, e);
+
+    // SoA : element (i,j) of matrix m at (i * dim + j) * ld + m
+    const size_t ld = count + 1;
+    std::vector<double> Are(nn * ld), Aim(nn * ld), Vre(nn * ld), Vim(nn * ld), ws2(dim * ld);
+    for (size_t m = 0; m < count; m++)
+      for (size_t i = 0; i < nn; i++) {
+        Are[i * ld + m] = A[m * nn + i].real();
+        Aim[i * ld + m] = A[m * nn + i].imag();
+      }
+    const size_t failedSoA = EigHermCplxBatchSoA(&Are[0], &Aim[0], &ws2[0], &Vre[0], &Vim[0], dim, count, ld);
+    e = 0.0;
+    for (size_t m = 0; m < count; m++) {
+      std::vector<Cplx> Vm(nn);
+      std::vector<double> wm(dim);
+      for (size_t i = 0; i < nn; i++)
+        Vm[i] = Cplx(Vre[i * ld + m], Vim[i * ld + m]);
+      for (int i = 0; i < dim; i++)
+        wm[i] = ws2[i * ld + m];
+      e = std::max(e, EigError(&A[m * nn], 0, &wm[0], &Vm[0], dim));
+    }
+    Check(failedSoA == 0 && e < 1e-10 * dim, "EigHermCplxBatchSoA", dim, e);
+  }
+}
+
+// user-023 : arena alignment, marks and exhaustion; a matrix arena's tensors, row tables, workspaces and frame area.
+static void TestArena(std::mt19937& rng) {
+  CplxArena arena(1000);
+  void* p = arena.Alloc(10);
+  const size_t mark = arena.Mark();
+  arena.Alloc<Cplx>(20);
+  const size_t used = arena.Used();
+  arena.Rewind(mark);
+  Check(p && (size_t)p % CplxArena::Align == 0 && mark == 64 && used == 64 + 320 && arena.Used() == 64 &&
+    arena.Capacity() >= 1000, "CplxArena::Alloc / Rewind", 0, (double)used);
+  Check(arena.Alloc(arena.Capacity()) == 0 && arena.Used() == 64, "CplxArena exhausted", 0);
+  arena.Reset();
+  Check(arena.Used() == 0 && arena.Alloc(arena.Capacity()) != 0, "CplxArena::Reset", 0);
+
+  const int dim = 5;
+  const size_t count = 4;
+  CplxMatrixArena ma(dim, count, 2, 1, 1, 256);
+  Check(ma.Valid() && ma.Stride() >= (size_t)dim * dim && ma.Stride() * sizeof(Cplx) % CplxArena::Align == 0 &&
+    (size_t)ma.Data(1) % CplxArena::Align == 0 && ma.Rows(1, 2)[3] == ma.Matrix(1, 2) + 3 * dim,
+    "CplxMatrixArena layout", dim, (double)ma.Stride());
+  double r = 0.0;
+  for (size_t k = 0; k < count; k++) {
+    RandomMatrix(ma.Matrix(0, k), dim, 1.0, rng);
+    InvertCplx(ma.Rows(0, k), ma.Rows(1, k), dim, ma.Workspace(0));
+    r = std::max(r, Residual(ma.Matrix(0, k), ma.Matrix(1, k), dim));
+  }
+  Check(r < 1e-10, "CplxMatrixArena inversion", dim, r);
+
+  void* f1 = ma.FrameAlloc(200);
+  void* f2 = ma.FrameAlloc(200);
+  ma.ResetFrame();
+  Check(f1 && !f2 && ma.FrameAlloc(200) == f1, "CplxMatrixArena frame area", dim);
+}
+
+// user-024 : tensor files survive a Create / Close / Open round trip; bad headers are rejected.
+static void TestTensor(std::mt19937& rng) {
+  const char* path = "test_inversion_tensor.bin";
+  const int dim = 3;
+  const size_t count = 5, nn = (size_t)dim * dim;
+  std::vector<Cplx> A(nn * count), B(nn * count);
+  for (size_t m = 0; m < count; m++)
+    RandomMatrix(&A[m * nn], dim, 1.0, rng);
+
+  CplxTensorFile file;
+  bool ok = file.Create(path, CplxTensorHeader::Make(dim, dim, count));
+  if (ok)
+    std::copy(A.begin(), A.end(), file.Data<double>());
+  file.Close();
+  ok = ok && file.Open(path) && file.Header().rows == (uint32_t)dim && file.Header().count == count &&
+    std::equal(A.begin(), A.end(), file.Data<double>());
+  if (ok)
+    InvertCplxBatch(file.Data<double>(), &B[0], dim, count, nn);
+  file.Close();
+  double r = 0.0;
+  for (size_t m = 0; m < count; m++)
+    r = std::max(r, Residual(&A[m * nn], &B[m * nn], dim));
+  Check(ok && r < 1e-10, "CplxTensorFile AoS round trip", dim, r);
+
+  // SoA : imaginary plane after rows * cols * stride reals
+  ok = file.Create(path, CplxTensorHeader::Make(dim, dim, count, CPLX_TENSOR_SOA, CPLX_TENSOR_C64));
+  if (ok)
+    for (size_t i = 0; i < nn * count; i++) {
+      file.Re<float>()[i] = float(i);
+      file.Im<float>()[i] = -float(i);
+    }
+  file.Close();
+  ok = ok && file.Open(path) && file.Header().layout == CPLX_TENSOR_SOA &&
+    file.Im<float>() == file.Re<float>() + nn * count;
+  for (size_t i = 0; ok && i < nn * count; i++)
+    ok = file.Re<float>()[i] == float(i) && file.Im<float>()[i] == -float(i);
+  file.Close();
+  Check(ok, "CplxTensorFile SoA round trip", dim);
+  remove(path);
+
+  CplxTensorHeader h = CplxTensorHeader::Make(dim, dim, count);
+  h.stride = nn - 1;
+  Check(h.Check() != 0 && !file.Create(path, h) && file.Error() != 0, "CplxTensorHeader stride too small", dim);
+  h = CplxTensorHeader::Make(dim, dim, count);
+  h.magic[0] = 'X';
+  Check(h.Check() != 0 && !file.Open(path), "CplxTensorHeader bad magic", dim);
+}
+
+// user-025 : CplxAsyncInverter frames in invert and solve mode, with one singular matrix in the first.
+static void TestAsync(std::mt19937& rng) {
+  const int dim = 5, nrhs = 2;
+  const size_t count = 4, nn = (size_t)dim * dim;
+  const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+
+  CplxAsyncInverter inv(dim, count);
+  std::vector<Cplx> A(nn * count), b(dim * nrhs * count);
+  for (int frame = 1; frame <= 2; frame++) {
+    const int s = inv.Acquire();
+    for (size_t m = 0; m < count; m++) {
+      if (frame == 1 && m == 2)
+        SingularMatrix(&A[m * nn], dim, rng);
+      else
+        RandomMatrix(&A[m * nn], dim, 1.0, rng);
+    }
+    std::copy(A.begin(), A.end(), inv.Input(s));
+    const uint64_t submitted = inv.Submit(s);
+    uint64_t done = 0;
+    size_t failed = 0;
+    const Cplx* B = inv.Wait(s, deadline, &done, &failed);
+    double r = 0.0;
+    for (size_t m = 0; B && m < count; m++)
+      if (frame != 1 || m != 2)
+        r = std::max(r, Residual(&A[m * nn], B + m * nn, dim));
+    Check(B && submitted == (uint64_t)frame && done == submitted && failed == (frame == 1 ? 1u : 0u) && r < 1e-10,
+      "CplxAsyncInverter invert", dim, r);
+  }
+
+  CplxAsyncInverter sol(dim, count, nrhs);
+  const int s = sol.Acquire();
+  for (size_t m = 0; m < count; m++)
+    RandomMatrix(&A[m * nn], dim, 1.0, rng);
+  for (size_t i = 0; i < b.size(); i++)
+    b[i] = Cplx(i % 7 - 3.0, i % 5 - 2.0);
+  std::copy(A.begin(), A.end(), sol.Input(s));
+  std::copy(b.begin(), b.end(), sol.Rhs(s));
+  const uint64_t submitted = sol.Submit(s);
+  uint64_t done = 0;
+  size_t failed = 1;
+  const Cplx* X = sol.Wait(s, deadline, &done, &failed);
+  double r = 0.0;
+  for (size_t m = 0; X && m < count; m++)
+    r = std::max(r, SolveResidual(&A[m * nn], &b[m * dim * nrhs], X + m * dim * nrhs, dim, nrhs));
+  Check(X && done == submitted && failed == 0 && r < 1e-10, "CplxAsyncInverter solve", dim, r);
+}
+
+int main() {
+  std::mt19937 rng(12345);
+  TestScalar(rng);
+  TestFast<double>(rng, 1e40, 1e-10);
+  TestFast<float>(rng, 1e5, 1e-3);
+  TestSoA(rng);
+  TestFloatBatch(rng);
+  TestBatch(rng);
+  TestHerm(rng);
+  TestSolve(rng);
+  TestLUFactorization(rng);
+  TestUpdate(rng);
+  TestConcurrentCallers();
+  TestMixedLU(rng);
+  TestLogDet(rng);
+  TestStream(rng);
+  TestInPlace(rng);
+  TestStructured(rng);
+  TestEig(rng);
+  TestArena(rng);
+  TestTensor(rng);
+  TestAsync(rng);
+  printf("%d of %d checks failed\n", g_failed, g_checks);
+  return g_failed ? 1 : 0;
+}
@@ -0,0 +1,336 @@
+/*
+Offline bulk processing of tensor files (inversion_tensor.h).
+
+The input is mapped read-only and the output is created at its final size and mapped read-write,
+so the CplxBatchExecutor calls read matrices from the input mapping and write results straight
+into the output mapping. The batch is walked in windows of --window MB of input; after each
+window its pages are released from both mappings (the output written back first), so files
+larger than RAM stream through a bounded resident set.
+
+  invert : A tensor, AoS c128 or c64, or SoA c128 -> inverses, same layout and stride
+  det    : A tensor, AoS c128 or c64, or SoA c128 -> 1 x 1 determinants (SoA planes for a SoA input)
+  logdet : A tensor, AoS c128 -> 1 x 1 log-determinants
+  solve  : A tensor and a dim x nrhs right-hand-side tensor, AoS c128 -> X, laid out as the rhs
+The SoA kernels are double precision only, so c64 SoA tensors are rejected.
+
+Usage : cplx_tensor info file
+        cplx_tensor invert|det|logdet in out [--threads n] [--window mb]
+        cplx_tensor solve in rhs out [--herm] [--threads n] [--window mb]
+Exit status 0, 1 on usage or I/O errors, 2 if some matrices failed : could not be inverted
+(singular or non-finite inverse) or solved, or gave a non-finite determinant or log-determinant.
+*/
+#include "inversion.h"
+#include "inversion_parallel.h"
+#include "inversion_simd.h"
+#include "inversion_tensor.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+typedef std::complex<double> Cplx;
+typedef std::complex<float> CplxF;
+
+struct ToolOptions {
+  std::string op;
+  std::vector<std::string> files;
+  int threads;
+  double windowMB;
+  bool herm;
+
+  ToolOptions() : threads(0), windowMB(256.0), herm(false) {}
+};
+
+static void Usage(const char* prog) {
+  fprintf(stderr,
+    "usage : %s info file\n"
+    "        %s invert|det|logdet in out [--threads n] [--window mb]\n"
+    "        %s solve in rhs out [--herm] [--threads n] [--window mb]\n",
+    prog, prog, prog);
+}
+
+static void PrintInfo(const char* path, const CplxTensorHeader& h) {
+  printf("%s : %llu x %u x %u %s %s, stride %llu, payload %.1f MB at %llu\n", path, (unsigned long long)h.count,
+    h.rows, h.cols, h.precision == CPLX_TENSOR_C64 ? "c64" : "c128", h.layout == CPLX_TENSOR_SOA ? "SoA" : "AoS",
+    (unsigned long long)h.stride, h.PayloadBytes() / 1048576.0, (unsigned long long)h.offset);
+}
+
+// Payload bytes of matrices [begin, end) of a tensor, for Release().
+static void ReleaseRange(const CplxTensorFile& f, size_t begin, size_t end) {
+  const CplxTensorHeader& h = f.Header();
+  const size_t e = h.ElementBytes();
+  if (h.layout == CPLX_TENSOR_AOS) {
+    f.Release(begin * h.stride * e, end * h.stride * e);
+    return;
+  }
+  // SoA : the window is a column range of every plane row
+  const size_t scalar = e / 2;
+  for (size_t r = 0; r < 2 * (size_t)h.rows * h.cols; r++)
+    f.Release((r * h.stride + begin) * scalar, (r * h.stride + end) * scalar);
+}
+
+/*
+Runs fn(begin, end) over windows of the batch, releasing each window of every file once done.
+Returns the sum of what fn returned.
+*/
+template <typename F>
+static size_t RunWindows(const std::vector<const CplxTensorFile*>& files, double windowMB, F fn) {
+  const CplxTensorHeader& h = files[0]->Header();
+  const size_t count = h.count;
+  const double bytes = (double)h.rows * h.cols * h.ElementBytes();
+  const size_t window = std::max((size_t)1, (size_t)(windowMB * 1048576.0 / bytes));
+  size_t failed = 0;
+
+  for (size_t b = 0; b < count; b += window) {
+    const size_t e = std::min(count, b + window);
+    failed += fn(b, e);
+    for (size_t i = 0; i < files.size(); i++)
+      ReleaseRange(*files[i], b, e);
+  }
+  return failed;
+}
+
+// Number of the count elements x[0], x[stride], ... with an inf or NaN part.
+template <typename T>
+static size_t CountNonFinite(const std::complex<T>* x, size_t count, size_t stride) {
+  size_t n = 0;
+  for (size_t k = 0; k < count; k++)
+    if (!std::isfinite(x[k * stride].real()) || !std::isfinite(x[k * stride].imag()))
+      n++;
+  return n;
+}
+
+/*
+c64 batches go through ParallelFor with one float workspace per worker. A matrix counts as
+failed if its determinant is zero or its determinant or inverse is not finite.
+*/
+struct InvertTaskF {
+  const CplxF* A;
+  CplxF* B;
+  int dim;
+  size_t stride;
+  std::vector<CplxInvWorkspaceF>* ws;
+  std::atomic<size_t>* failed;
+  void operator()(size_t b, size_t e, int w) {
+    const size_t nn = (size_t)dim * dim;
+    size_t bad = 0;
+    for (size_t k = b; k < e; k++) {
+      CplxF* Bk = B + k * stride;
+      const CplxF det = InvertAndDetCplx(CplxMatrixViewT<const CplxF>(A + k * stride, dim),
+        CplxMatrixViewT<CplxF>(Bk, dim), (*ws)[w]);
+      if (det == 0.0f || CountNonFinite(&det, 1, 1) || CountNonFinite(Bk, nn, 1))
+        bad++;
+    }
+    failed->fetch_add(bad, std::memory_order_relaxed);
+  }
+};
+
+struct DetTaskF {
+  const CplxF* A;
+  CplxF* det;
+  int dim;
+  size_t stride;
+  std::vector<CplxInvWorkspaceF>* ws;
+  std::atomic<size_t>* failed;
+  void operator()(size_t b, size_t e, int w) {
+    DetCplxBatch(A + b * stride, det + b, dim, e - b, stride, (*ws)[w]);
+    failed->fetch_add(CountNonFinite(det + b, e - b, 1), std::memory_order_relaxed);
+  }
+};
+
+// SoA batches are split into lane ranges; every range keeps the full plane stride.
+struct InvertTaskSoA {
+  const double *Are, *Aim;
+  double *Bre, *Bim;
+  int dim;
+  size_t ld;
+  std::atomic<size_t>* failed;
+  void operator()(size_t b, size_t e, int) {
+    failed->fetch_add(InvertCplxBatchSoA(Are + b, Aim + b, Bre + b, Bim + b, dim, e - b, ld),
+      std::memory_order_relaxed);
+  }
+};
+
+struct DetTaskSoA {
+  const double *Are, *Aim;
+  double *detRe, *detIm;
+  int dim;
+  size_t ld;
+  std::atomic<size_t>* failed;
+  void operator()(size_t b, size_t e, int) {
+    failed->fetch_add(DetCplxBatchSoA(Are + b, Aim + b, detRe + b, detIm + b, dim, e - b, ld),
+      std::memory_order_relaxed);
+  }
+};
+
+static int Run(const ToolOptions& opt) {
+  const bool solve = opt.op == "solve";
+  CplxTensorFile in, rhs, out;
+  if (!in.Open(opt.files[0].c_str())) {
+    fprintf(stderr, "%s : %s\n", opt.files[0].c_str(), in.Error());
+    return 1;
+  }
+  const CplxTensorHeader& h = in.Header();
+  if (h.rows != h.cols) {
+    fprintf(stderr, "%s : matrices are %u x %u, not square\n", opt.files[0].c_str(), h.rows, h.cols);
+    return 1;
+  }
+  const int dim = h.rows;
+  const bool soa = h.layout == CPLX_TENSOR_SOA, c64 = h.precision == CPLX_TENSOR_C64;
+  if (soa && c64) {
+    fprintf(stderr, "%s : SoA tensors must be c128\n", opt.files[0].c_str());
+    return 1;
+  }
+  if ((opt.op == "logdet" || solve) && (soa || c64)) {
+    fprintf(stderr, "%s : %s needs a c128 AoS tensor\n", opt.files[0].c_str(), opt.op.c_str());
+    return 1;
+  }
+
+  CplxTensorHeader oh = h;
+  if (solve) {
+    if (!rhs.Open(opt.files[1].c_str())) {
+      fprintf(stderr, "%s : %s\n", opt.files[1].c_str(), rhs.Error());
+      return 1;
+    }
+    oh = rhs.Header();
+    if (oh.rows != h.rows || oh.count != h.count || oh.layout != CPLX_TENSOR_AOS || oh.precision != h.precision) {
+      fprintf(stderr, "%s : expected %llu AoS c128 right-hand sides of %d rows\n", opt.files[1].c_str(),
+        (unsigned long long)h.count, dim);
+      return 1;
+    }
+  }
+  else if (opt.op != "invert")
+    oh = CplxTensorHeader::Make(1, 1, h.count, soa ? CPLX_TENSOR_SOA : CPLX_TENSOR_AOS,
+      c64 ? CPLX_TENSOR_C64 : CPLX_TENSOR_C128);
+
+  const std::string& outPath = opt.files.back();
+  if (!out.Create(outPath.c_str(), oh)) {
+    fprintf(stderr, "%s : %s\n", outPath.c_str(), out.Error());
+    return 1;
+  }
+  in.AdviseSequential();
+  std::vector<const CplxTensorFile*> files;
+  files.push_back(&in);
+  if (solve) {
+    rhs.AdviseSequential();
+    files.push_back(&rhs);
+  }
+  files.push_back(&out);
+
+  CplxBatchExecutor pool(opt.threads);
+  std::vector<CplxInvWorkspaceF> wsf(c64 ? pool.Threads() : 0, CplxInvWorkspaceF(c64 && dim > 8 ? dim : 0));
+  const size_t stride = h.stride;
+  size_t failed = 0;
+  // failures summed by the ParallelFor tasks of the current window
+  std::atomic<size_t> taskFailed(0);
+
+  if (opt.op == "invert") {
+    if (soa) {
+      failed = RunWindows(files, opt.windowMB, [&](size_t b, size_t e) -> size_t {
+        InvertTaskSoA t = { in.Re<double>() + b, in.Im<double>() + b, out.Re<double>() + b, out.Im<double>() + b,
+          dim, stride, &taskFailed };
+        pool.ParallelFor(e - b, 256, t);
+        return taskFailed.exchange(0);
+      });
+    }
+    else if (c64) {
+      failed = RunWindows(files, opt.windowMB, [&](size_t b, size_t e) -> size_t {
+        InvertTaskF t = { in.Data<float>() + b * stride, out.Data<float>() + b * stride, dim, stride, &wsf,
+          &taskFailed };
+        pool.ParallelFor(e - b, dim <= 8 ? 64 : 1, t);
+        return taskFailed.exchange(0);
+      });
+    }
+    else {
+      failed = RunWindows(files, opt.windowMB, [&](size_t b, size_t e) {
+        return pool.InvertBatchChecked(in.Data<double>() + b * stride, out.Data<double>() + b * stride, dim, e - b,
+          stride);
+      });
+    }
+  }
+  else if (opt.op == "det") {
+    if (soa) {
+      failed = RunWindows(files, opt.windowMB, [&](size_t b, size_t e) -> size_t {
+        DetTaskSoA t = { in.Re<double>() + b, in.Im<double>() + b, out.Re<double>() + b, out.Im<double>() + b,
+          dim, stride, &taskFailed };
+        pool.ParallelFor(e - b, 256, t);
+        return taskFailed.exchange(0);
+      });
+    }
+    else if (c64) {
+      failed = RunWindows(files, opt.windowMB, [&](size_t b, size_t e) -> size_t {
+        DetTaskF t = { in.Data<float>() + b * stride, out.Data<float>() + b, dim, stride, &wsf, &taskFailed };
+        pool.ParallelFor(e - b, dim <= 8 ? 64 : 1, t);
+        return taskFailed.exchange(0);
+      });
+    }
+    else {
+      failed = RunWindows(files, opt.windowMB, [&](size_t b, size_t e) -> size_t {
+        pool.DetBatch(in.Data<double>() + b * stride, out.Data<double>() + b, dim, e - b, stride);
+        return CountNonFinite(out.Data<double>() + b, e - b, 1);
+      });
+    }
+  }
+  else if (opt.op == "logdet") {
+    failed = RunWindows(files, opt.windowMB, [&](size_t b, size_t e) -> size_t {
+      pool.LogDetBatch(in.Data<double>() + b * stride, out.Data<double>() + b, dim, e - b, stride);
+      return CountNonFinite(out.Data<double>() + b, e - b, 1);
+    });
+  }
+  else {
+    const size_t rhsStride = oh.stride;
+    failed = RunWindows(files, opt.windowMB, [&](size_t b, size_t e) {
+      return pool.SolveBatch(in.Data<double>() + b * stride, rhs.Data<double>() + b * rhsStride,
+        out.Data<double>() + b * rhsStride, dim, oh.cols, e - b, stride, rhsStride, opt.herm);
+    });
+  }
+
+  out.Close();
+  if (failed) {
+    fprintf(stderr, "%zu of %llu matrices failed\n", failed, (unsigned long long)h.count);
+    return 2;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  ToolOptions opt;
+  for (int i = 1; i < argc; i++) {
+    const std::string arg = argv[i];
+    const bool hasValue = i + 1 < argc;
+    if (arg == "--threads" && hasValue)
+      opt.threads = atoi(argv[++i]);
+    else if (arg == "--window" && hasValue)
+      opt.windowMB = atof(argv[++i]);
+    else if (arg == "--herm")
+      opt.herm = true;
+    else if (arg.compare(0, 2, "--") == 0) {
+      Usage(argv[0]);
+      return 1;
+    }
+    else if (opt.op.empty())
+      opt.op = arg;
+    else
+      opt.files.push_back(arg);
+  }
+
+  if (opt.op == "info" && opt.files.size() == 1) {
+    CplxTensorFile f;
+    if (!f.Open(opt.files[0].c_str())) {
+      fprintf(stderr, "%s : %s\n", opt.files[0].c_str(), f.Error());
+      return 1;
+    }
+    PrintInfo(opt.files[0].c_str(), f.Header());
+    return 0;
+  }
+  const bool known = opt.op == "invert" || opt.op == "det" || opt.op == "logdet";
+  if (!(known && opt.files.size() == 2) && !(opt.op == "solve" && opt.files.size() == 3)) {
+    Usage(argv[0]);
+    return 1;
+  }
+  if (opt.windowMB <= 0.0)
+    opt.windowMB = 256.0;
+  return Run(opt);
+}